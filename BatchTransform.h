@@ -0,0 +1,359 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <cmath>
+
+// Builds the world and WVP matrices of many objects at once. The input is a
+// structure of arrays (one array per component, as Pipeline::Scale/WorldPos/Rotate
+// take them), the output is a contiguous array of matrices stored row by row like
+// the ones Pipeline returns. The kernel is picked at runtime: AVX (8 objects per
+// step), SSE2 (4 objects) or plain scalar code.
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BATCH_TRANSFORM_SSE 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define BATCH_TRANSFORM_TARGET_AVX
+#else
+#define BATCH_TRANSFORM_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+struct TransformBatch
+{
+	const float* ScaleX;
+	const float* ScaleY;
+	const float* ScaleZ;
+	const float* PosX;
+	const float* PosY;
+	const float* PosZ;
+	const float* RotateX; // degrees
+	const float* RotateY;
+	const float* RotateZ;
+	unsigned int Count;
+};
+
+enum BATCH_TRANSFORM_KERNEL
+{
+	BATCH_TRANSFORM_SCALAR,
+	BATCH_TRANSFORM_SSE2,
+	BATCH_TRANSFORM_AVX
+};
+
+namespace BatchTransformDetail
+{
+	// one object, the same expressions as Pipeline::InitWorldTransform followed by the
+	// WVP multiply; the last world row is (0, 0, 0, 1) so only 3 rows take part in it
+	inline void TransformOne(const TransformBatch& b, unsigned int i, const float* vp, float* pWorld, float* pWVP)
+	{
+		float x = glm::radians(b.RotateX[i]);
+		float y = glm::radians(b.RotateY[i]);
+		float z = glm::radians(b.RotateZ[i]);
+		float sx = sinf(x), cx = cosf(x);
+		float sy = sinf(y), cy = cosf(y);
+		float sz = sinf(z), cz = cosf(z);
+
+		float w[12] =
+		{
+			cz * cy * b.ScaleX[i], (-cz * sy * sx - sz * cx) * b.ScaleY[i], (-cz * sy * cx + sz * sx) * b.ScaleZ[i], b.PosX[i],
+			sz * cy * b.ScaleX[i], (-sz * sy * sx + cz * cx) * b.ScaleY[i], (-sz * sy * cx - cz * sx) * b.ScaleZ[i], b.PosY[i],
+			sy * b.ScaleX[i],      cy * sx * b.ScaleY[i],                   cy * cx * b.ScaleZ[i],                   b.PosZ[i]
+		};
+
+		if (pWorld)
+		{
+			for (int k = 0; k < 12; k++) pWorld[k] = w[k];
+			pWorld[12] = 0.0f; pWorld[13] = 0.0f; pWorld[14] = 0.0f; pWorld[15] = 1.0f;
+		}
+
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				pWVP[r * 4 + c] = vp[r * 4 + 0] * w[c] + vp[r * 4 + 1] * w[4 + c] + vp[r * 4 + 2] * w[8 + c] + (c == 3 ? vp[r * 4 + 3] : 0.0f);
+			}
+		}
+	}
+
+	inline void TransformScalar(const TransformBatch& b, unsigned int First, const float* vp, float* pWorld, float* pWVP)
+	{
+		for (unsigned int i = First; i < b.Count; i++)
+		{
+			TransformOne(b, i, vp, pWorld ? pWorld + i * 16 : nullptr, pWVP + i * 16);
+		}
+	}
+
+#ifdef BATCH_TRANSFORM_SSE
+	// Cody-Waite reduction by pi/2 and the single precision minimax polynomials of Cephes,
+	// accurate to a few ulp for the angles Pipeline is fed with
+	const float SINCOS_DP1 = 1.5703125f;
+	const float SINCOS_DP2 = 4.837512969970703125e-4f;
+	const float SINCOS_DP3 = 7.54978995489188216e-8f;
+	const float SINCOS_S1 = -1.6666654611e-1f;
+	const float SINCOS_S2 = 8.3321608736e-3f;
+	const float SINCOS_S3 = -1.9515295891e-4f;
+	const float SINCOS_C1 = 4.166664568298827e-2f;
+	const float SINCOS_C2 = -1.388731625493765e-3f;
+	const float SINCOS_C3 = 2.443315711809948e-5f;
+
+	inline void SinCos4(__m128 x, __m128& s, __m128& c)
+	{
+		__m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.63661977236f))); // round(x / (pi/2))
+		__m128 qf = _mm_cvtepi32_ps(q);
+
+		__m128 r = _mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(SINCOS_DP1)));
+		r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(SINCOS_DP2)));
+		r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(SINCOS_DP3)));
+		__m128 z = _mm_mul_ps(r, r);
+
+		__m128 ps = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SINCOS_S3), z), _mm_set1_ps(SINCOS_S2));
+		ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(SINCOS_S1));
+		ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, z), r), r);
+
+		__m128 pc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SINCOS_C3), z), _mm_set1_ps(SINCOS_C2));
+		pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(SINCOS_C1));
+		pc = _mm_mul_ps(_mm_mul_ps(pc, z), z);
+		pc = _mm_add_ps(_mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+		// quadrant q: odd quadrants swap sin and cos, 2 and 3 negate sin, 1 and 2 negate cos
+		__m128 Swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+		__m128 SinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+		__m128 CosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+		s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(Swap, pc), _mm_andnot_ps(Swap, ps)), SinSign);
+		c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(Swap, ps), _mm_andnot_ps(Swap, pc)), CosSign);
+	}
+
+	// rows a, b, c, d hold one matrix entry of 4 objects each, writes
+	// four consecutive floats (one matrix row) of every object
+	inline void StoreRow4(__m128 a, __m128 b, __m128 c, __m128 d, float* pOut)
+	{
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+		_mm_storeu_ps(pOut, a);
+		_mm_storeu_ps(pOut + 16, b);
+		_mm_storeu_ps(pOut + 32, c);
+		_mm_storeu_ps(pOut + 48, d);
+	}
+
+	inline void TransformSSE2(const TransformBatch& b, const float* vp, float* pWorld, float* pWVP)
+	{
+		const __m128 ToRadians = _mm_set1_ps(0.017453292519943295f);
+		unsigned int i = 0;
+
+		for (; i + 4 <= b.Count; i += 4)
+		{
+			__m128 sx, cx, sy, cy, sz, cz;
+			SinCos4(_mm_mul_ps(_mm_loadu_ps(b.RotateX + i), ToRadians), sx, cx);
+			SinCos4(_mm_mul_ps(_mm_loadu_ps(b.RotateY + i), ToRadians), sy, cy);
+			SinCos4(_mm_mul_ps(_mm_loadu_ps(b.RotateZ + i), ToRadians), sz, cz);
+
+			__m128 Sx = _mm_loadu_ps(b.ScaleX + i), Sy = _mm_loadu_ps(b.ScaleY + i), Sz = _mm_loadu_ps(b.ScaleZ + i);
+			__m128 czsy = _mm_mul_ps(cz, sy), szsy = _mm_mul_ps(sz, sy);
+
+			__m128 w[12];
+			w[0] = _mm_mul_ps(_mm_mul_ps(cz, cy), Sx);
+			w[1] = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(_mm_mul_ps(czsy, sx), _mm_mul_ps(sz, cx))), Sy);
+			w[2] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sz, sx), _mm_mul_ps(czsy, cx)), Sz);
+			w[3] = _mm_loadu_ps(b.PosX + i);
+			w[4] = _mm_mul_ps(_mm_mul_ps(sz, cy), Sx);
+			w[5] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(cz, cx), _mm_mul_ps(szsy, sx)), Sy);
+			w[6] = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(_mm_mul_ps(szsy, cx), _mm_mul_ps(cz, sx))), Sz);
+			w[7] = _mm_loadu_ps(b.PosY + i);
+			w[8] = _mm_mul_ps(sy, Sx);
+			w[9] = _mm_mul_ps(_mm_mul_ps(cy, sx), Sy);
+			w[10] = _mm_mul_ps(_mm_mul_ps(cy, cx), Sz);
+			w[11] = _mm_loadu_ps(b.PosZ + i);
+
+			if (pWorld)
+			{
+				float* pOut = pWorld + i * 16;
+				StoreRow4(w[0], w[1], w[2], w[3], pOut);
+				StoreRow4(w[4], w[5], w[6], w[7], pOut + 4);
+				StoreRow4(w[8], w[9], w[10], w[11], pOut + 8);
+				StoreRow4(_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_set1_ps(1.0f), pOut + 12);
+			}
+
+			float* pOut = pWVP + i * 16;
+			for (int r = 0; r < 4; r++)
+			{
+				__m128 v0 = _mm_set1_ps(vp[r * 4 + 0]), v1 = _mm_set1_ps(vp[r * 4 + 1]), v2 = _mm_set1_ps(vp[r * 4 + 2]);
+				__m128 e[4];
+				for (int c = 0; c < 4; c++)
+				{
+					e[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v0, w[c]), _mm_mul_ps(v1, w[4 + c])), _mm_mul_ps(v2, w[8 + c]));
+				}
+				e[3] = _mm_add_ps(e[3], _mm_set1_ps(vp[r * 4 + 3]));
+				StoreRow4(e[0], e[1], e[2], e[3], pOut + r * 4);
+			}
+		}
+
+		TransformScalar(b, i, vp, pWorld, pWVP);
+	}
+
+	BATCH_TRANSFORM_TARGET_AVX inline void SinCos8(__m256 x, __m256& s, __m256& c)
+	{
+		// AVX has no 256-bit integer ops, the quadrant bits are tested on floats
+		__m256 qf = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.63661977236f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256 Quadrant = _mm256_sub_ps(qf, _mm256_mul_ps(_mm256_floor_ps(_mm256_mul_ps(qf, _mm256_set1_ps(0.25f))), _mm256_set1_ps(4.0f)));
+
+		__m256 r = _mm256_sub_ps(x, _mm256_mul_ps(qf, _mm256_set1_ps(SINCOS_DP1)));
+		r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(SINCOS_DP2)));
+		r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(SINCOS_DP3)));
+		__m256 z = _mm256_mul_ps(r, r);
+
+		__m256 ps = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SINCOS_S3), z), _mm256_set1_ps(SINCOS_S2));
+		ps = _mm256_add_ps(_mm256_mul_ps(ps, z), _mm256_set1_ps(SINCOS_S1));
+		ps = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(ps, z), r), r);
+
+		__m256 pc = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SINCOS_C3), z), _mm256_set1_ps(SINCOS_C2));
+		pc = _mm256_add_ps(_mm256_mul_ps(pc, z), _mm256_set1_ps(SINCOS_C1));
+		pc = _mm256_mul_ps(_mm256_mul_ps(pc, z), z);
+		pc = _mm256_add_ps(_mm256_sub_ps(pc, _mm256_mul_ps(z, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.0f));
+
+		__m256 One = _mm256_set1_ps(1.0f), Two = _mm256_set1_ps(2.0f), Three = _mm256_set1_ps(3.0f);
+		__m256 SignBit = _mm256_set1_ps(-0.0f);
+		__m256 Swap = _mm256_or_ps(_mm256_cmp_ps(Quadrant, One, _CMP_EQ_OQ), _mm256_cmp_ps(Quadrant, Three, _CMP_EQ_OQ));
+		__m256 SinSign = _mm256_and_ps(_mm256_cmp_ps(Quadrant, Two, _CMP_GE_OQ), SignBit);
+		__m256 CosSign = _mm256_and_ps(_mm256_or_ps(_mm256_cmp_ps(Quadrant, One, _CMP_EQ_OQ), _mm256_cmp_ps(Quadrant, Two, _CMP_EQ_OQ)), SignBit);
+
+		s = _mm256_xor_ps(_mm256_or_ps(_mm256_and_ps(Swap, pc), _mm256_andnot_ps(Swap, ps)), SinSign);
+		c = _mm256_xor_ps(_mm256_or_ps(_mm256_and_ps(Swap, ps), _mm256_andnot_ps(Swap, pc)), CosSign);
+	}
+
+	BATCH_TRANSFORM_TARGET_AVX inline void StoreRow8(__m256 a, __m256 b, __m256 c, __m256 d, float* pOut)
+	{
+		__m128 a0 = _mm256_castps256_ps128(a), b0 = _mm256_castps256_ps128(b), c0 = _mm256_castps256_ps128(c), d0 = _mm256_castps256_ps128(d);
+		__m128 a1 = _mm256_extractf128_ps(a, 1), b1 = _mm256_extractf128_ps(b, 1), c1 = _mm256_extractf128_ps(c, 1), d1 = _mm256_extractf128_ps(d, 1);
+		_MM_TRANSPOSE4_PS(a0, b0, c0, d0);
+		_MM_TRANSPOSE4_PS(a1, b1, c1, d1);
+		_mm_storeu_ps(pOut, a0);
+		_mm_storeu_ps(pOut + 16, b0);
+		_mm_storeu_ps(pOut + 32, c0);
+		_mm_storeu_ps(pOut + 48, d0);
+		_mm_storeu_ps(pOut + 64, a1);
+		_mm_storeu_ps(pOut + 80, b1);
+		_mm_storeu_ps(pOut + 96, c1);
+		_mm_storeu_ps(pOut + 112, d1);
+	}
+
+	BATCH_TRANSFORM_TARGET_AVX inline void TransformAVX(const TransformBatch& b, const float* vp, float* pWorld, float* pWVP)
+	{
+		const __m256 ToRadians = _mm256_set1_ps(0.017453292519943295f);
+		unsigned int i = 0;
+
+		for (; i + 8 <= b.Count; i += 8)
+		{
+			__m256 sx, cx, sy, cy, sz, cz;
+			SinCos8(_mm256_mul_ps(_mm256_loadu_ps(b.RotateX + i), ToRadians), sx, cx);
+			SinCos8(_mm256_mul_ps(_mm256_loadu_ps(b.RotateY + i), ToRadians), sy, cy);
+			SinCos8(_mm256_mul_ps(_mm256_loadu_ps(b.RotateZ + i), ToRadians), sz, cz);
+
+			__m256 Sx = _mm256_loadu_ps(b.ScaleX + i), Sy = _mm256_loadu_ps(b.ScaleY + i), Sz = _mm256_loadu_ps(b.ScaleZ + i);
+			__m256 czsy = _mm256_mul_ps(cz, sy), szsy = _mm256_mul_ps(sz, sy);
+			__m256 Zero = _mm256_setzero_ps();
+
+			__m256 w[12];
+			w[0] = _mm256_mul_ps(_mm256_mul_ps(cz, cy), Sx);
+			w[1] = _mm256_mul_ps(_mm256_sub_ps(Zero, _mm256_add_ps(_mm256_mul_ps(czsy, sx), _mm256_mul_ps(sz, cx))), Sy);
+			w[2] = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(sz, sx), _mm256_mul_ps(czsy, cx)), Sz);
+			w[3] = _mm256_loadu_ps(b.PosX + i);
+			w[4] = _mm256_mul_ps(_mm256_mul_ps(sz, cy), Sx);
+			w[5] = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(cz, cx), _mm256_mul_ps(szsy, sx)), Sy);
+			w[6] = _mm256_mul_ps(_mm256_sub_ps(Zero, _mm256_add_ps(_mm256_mul_ps(szsy, cx), _mm256_mul_ps(cz, sx))), Sz);
+			w[7] = _mm256_loadu_ps(b.PosY + i);
+			w[8] = _mm256_mul_ps(sy, Sx);
+			w[9] = _mm256_mul_ps(_mm256_mul_ps(cy, sx), Sy);
+			w[10] = _mm256_mul_ps(_mm256_mul_ps(cy, cx), Sz);
+			w[11] = _mm256_loadu_ps(b.PosZ + i);
+
+			if (pWorld)
+			{
+				float* pOut = pWorld + i * 16;
+				StoreRow8(w[0], w[1], w[2], w[3], pOut);
+				StoreRow8(w[4], w[5], w[6], w[7], pOut + 4);
+				StoreRow8(w[8], w[9], w[10], w[11], pOut + 8);
+				StoreRow8(Zero, Zero, Zero, _mm256_set1_ps(1.0f), pOut + 12);
+			}
+
+			float* pOut = pWVP + i * 16;
+			for (int r = 0; r < 4; r++)
+			{
+				__m256 v0 = _mm256_set1_ps(vp[r * 4 + 0]), v1 = _mm256_set1_ps(vp[r * 4 + 1]), v2 = _mm256_set1_ps(vp[r * 4 + 2]);
+				__m256 e[4];
+				for (int c = 0; c < 4; c++)
+				{
+					e[c] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(v0, w[c]), _mm256_mul_ps(v1, w[4 + c])), _mm256_mul_ps(v2, w[8 + c]));
+				}
+				e[3] = _mm256_add_ps(e[3], _mm256_set1_ps(vp[r * 4 + 3]));
+				StoreRow8(e[0], e[1], e[2], e[3], pOut + r * 4);
+			}
+		}
+
+		// at most 7 objects left, finish them 4 at a time where possible
+		TransformBatch Rest = b;
+		Rest.Count = b.Count - i;
+		Rest.ScaleX += i; Rest.ScaleY += i; Rest.ScaleZ += i;
+		Rest.PosX += i; Rest.PosY += i; Rest.PosZ += i;
+		Rest.RotateX += i; Rest.RotateY += i; Rest.RotateZ += i;
+		TransformSSE2(Rest, vp, pWorld ? pWorld + i * 16 : nullptr, pWVP + i * 16);
+	}
+
+	inline bool CpuHasAVX()
+	{
+#if defined(_MSC_VER)
+		int Info[4];
+		__cpuid(Info, 1);
+		bool OsSaves = (Info[2] & (1 << 27)) != 0; // OSXSAVE
+		bool Avx = (Info[2] & (1 << 28)) != 0;
+		return OsSaves && Avx && (_xgetbv(0) & 6) == 6; // XMM and YMM state enabled
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx") != 0;
+#endif
+	}
+#endif
+}
+
+// the fastest kernel this CPU runs, detected once
+inline BATCH_TRANSFORM_KERNEL GetBatchTransformKernel()
+{
+#ifdef BATCH_TRANSFORM_SSE
+	static const BATCH_TRANSFORM_KERNEL Kernel = BatchTransformDetail::CpuHasAVX() ? BATCH_TRANSFORM_AVX : BATCH_TRANSFORM_SSE2;
+	return Kernel;
+#else
+	return BATCH_TRANSFORM_SCALAR;
+#endif
+}
+
+// writes Batch.Count world (if pWorldTrans is not null) and WVP matrices,
+// ViewProj is Pipeline::GetViewProjTrans() of the camera the objects are seen from
+inline void BatchTransform(const TransformBatch& Batch, const glm::mat4& ViewProj, glm::mat4* pWorldTrans, glm::mat4* pWVPTrans,
+	BATCH_TRANSFORM_KERNEL Kernel = GetBatchTransformKernel())
+{
+	float vp[16];
+	for (int r = 0; r < 4; r++)
+	{
+		for (int c = 0; c < 4; c++) vp[r * 4 + c] = ViewProj[r][c];
+	}
+
+	float* pWorld = (float*)pWorldTrans;
+	float* pWVP = (float*)pWVPTrans;
+
+	switch (Kernel)
+	{
+#ifdef BATCH_TRANSFORM_SSE
+	case BATCH_TRANSFORM_AVX:
+		BatchTransformDetail::TransformAVX(Batch, vp, pWorld, pWVP);
+		break;
+	case BATCH_TRANSFORM_SSE2:
+		BatchTransformDetail::TransformSSE2(Batch, vp, pWorld, pWVP);
+		break;
+#endif
+	default:
+		BatchTransformDetail::TransformScalar(Batch, 0, vp, pWorld, pWVP);
+		break;
+	}
+}
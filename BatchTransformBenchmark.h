@@ -0,0 +1,83 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+#include "Pipeline.h"
+
+// Times Count objects going through Pipeline one at a time (Scale/WorldPos/Rotate +
+// GetWorldTrans/GetWVPTrans, every object changes all three) against every batch
+// kernel this CPU runs, prints the best of Repeats runs and the largest difference
+// from the per-object matrices.
+inline void BenchmarkBatchTransform(unsigned int Count, int Repeats)
+{
+	std::vector<float> Data[9];
+	for (int k = 0; k < 9; k++) Data[k].resize(Count);
+
+	srand(1);
+	for (unsigned int i = 0; i < Count; i++)
+	{
+		for (int k = 0; k < 3; k++) Data[k][i] = 0.5f + (rand() % 100) / 50.0f;
+		for (int k = 3; k < 6; k++) Data[k][i] = (rand() % 2000) / 10.0f - 100.0f;
+		for (int k = 6; k < 9; k++) Data[k][i] = (rand() % 3600) / 10.0f - 180.0f;
+	}
+
+	TransformBatch Batch = { Data[0].data(), Data[1].data(), Data[2].data(), Data[3].data(), Data[4].data(), Data[5].data(),
+		Data[6].data(), Data[7].data(), Data[8].data(), Count };
+
+	Pipeline p;
+	p.SetCamera(glm::vec3(0.0f, 0.0f, -3.0f), glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	p.SetPerspectiveProj(60.0f, 1980, 1250, 1.0f, 100.0f);
+
+	std::vector<glm::mat4> RefWorld(Count), RefWVP(Count), World(Count), WVP(Count);
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double Best = 1e30;
+	for (int r = 0; r < Repeats; r++)
+	{
+		Clock::time_point Start = Clock::now();
+		for (unsigned int i = 0; i < Count; i++)
+		{
+			p.Scale(Data[0][i], Data[1][i], Data[2][i]);
+			p.WorldPos(Data[3][i], Data[4][i], Data[5][i]);
+			p.Rotate(Data[6][i], Data[7][i], Data[8][i]);
+			RefWorld[i] = *p.GetWorldTrans();
+			RefWVP[i] = *p.GetWVPTrans();
+		}
+		Best = std::min(Best, std::chrono::duration<double, std::micro>(Clock::now() - Start).count());
+	}
+	std::cout << "Transforms of " << Count << " objects, best of " << Repeats << "\n";
+	std::cout << "  pipeline: " << Best << " us\n";
+	double Reference = Best;
+
+	const char* Names[] = { "scalar", "sse2", "avx" };
+	for (int Kernel = BATCH_TRANSFORM_SCALAR; Kernel <= GetBatchTransformKernel(); Kernel++)
+	{
+		Best = 1e30;
+		for (int r = 0; r < Repeats; r++)
+		{
+			Clock::time_point Start = Clock::now();
+			BatchTransform(Batch, p.GetViewProjTrans(), World.data(), WVP.data(), (BATCH_TRANSFORM_KERNEL)Kernel);
+			Best = std::min(Best, std::chrono::duration<double, std::micro>(Clock::now() - Start).count());
+		}
+
+		float MaxError = 0.0f;
+		for (unsigned int i = 0; i < Count; i++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				for (int col = 0; col < 4; col++)
+				{
+					MaxError = std::max(MaxError, fabsf(World[i][row][col] - RefWorld[i][row][col]));
+					MaxError = std::max(MaxError, fabsf(WVP[i][row][col] - RefWVP[i][row][col]) / (1.0f + fabsf(RefWVP[i][row][col])));
+				}
+			}
+		}
+
+		std::cout << "  " << Names[Kernel] << ": " << Best << " us (x" << Reference / Best << "), max error " << MaxError << "\n";
+	}
+}
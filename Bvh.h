@@ -0,0 +1,289 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+#include "Frustum.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Bounding volume hierarchy over the axis aligned boxes of objects, for frustum culling.
+// Built top down by splitting at the median of the longest axis of the box centers;
+// the items of every subtree are contiguous, so a subtree that is completely inside
+// the frustum is accepted without visiting it. Moving an object refits the boxes of
+// its leaf and their parents only; the tree is not rebuilt, so after objects have
+// moved far from where they were at Build it gets looser (call Build again then).
+const unsigned int BVH_LEAF_SIZE = 8;
+
+struct BvhNode
+{
+	glm::vec3 Min;
+	glm::vec3 Max;
+	unsigned int First; // first item of the subtree
+	unsigned int Count; // items in the subtree
+	unsigned int Left; // children Left and Left + 1, 0 for a leaf
+	unsigned int Parent;
+};
+
+// the six frustum planes as two groups of four, for testing a box against all of them at once
+struct BvhPlanes
+{
+#ifdef BVH_SSE
+	__m128 X[2], Y[2], Z[2], W[2];
+	__m128 AbsX[2], AbsY[2], AbsZ[2];
+#endif
+	Frustum Planes;
+
+	BvhPlanes(const Frustum& View)
+	{
+		Planes = View;
+#ifdef BVH_SSE
+		// the two spare slots always pass: normal 0, distance 1
+		float p[4][8];
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec4 Plane = i < 6 ? View.Planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			p[0][i] = Plane.x; p[1][i] = Plane.y; p[2][i] = Plane.z; p[3][i] = Plane.w;
+		}
+		__m128 SignMask = _mm_set1_ps(-0.0f);
+		for (int g = 0; g < 2; g++)
+		{
+			X[g] = _mm_loadu_ps(&p[0][g * 4]);
+			Y[g] = _mm_loadu_ps(&p[1][g * 4]);
+			Z[g] = _mm_loadu_ps(&p[2][g * 4]);
+			W[g] = _mm_loadu_ps(&p[3][g * 4]);
+			AbsX[g] = _mm_andnot_ps(SignMask, X[g]);
+			AbsY[g] = _mm_andnot_ps(SignMask, Y[g]);
+			AbsZ[g] = _mm_andnot_ps(SignMask, Z[g]);
+		}
+#endif
+	}
+
+	enum RESULT { OUTSIDE, INTERSECTS, INSIDE };
+
+	// the box against every plane: the center distance plus or minus the box radius along the normal
+	RESULT Test(const glm::vec3& Min, const glm::vec3& Max) const
+	{
+		glm::vec3 c = (Min + Max) * 0.5f;
+		glm::vec3 e = (Max - Min) * 0.5f;
+#ifdef BVH_SSE
+		__m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+		__m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+		__m128 Zero = _mm_setzero_ps();
+		int Outside = 0, Inside = 0;
+		for (int g = 0; g < 2; g++)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(X[g], cx), _mm_mul_ps(Y[g], cy)), _mm_add_ps(_mm_mul_ps(Z[g], cz), W[g]));
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(AbsX[g], ex), _mm_mul_ps(AbsY[g], ey)), _mm_mul_ps(AbsZ[g], ez));
+			Outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(d, r), Zero));
+			Inside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(d, r), Zero)) << (g * 4);
+		}
+		if (Outside != 0) return OUTSIDE;
+		return Inside == 0 ? INSIDE : INTERSECTS;
+#else
+		bool Intersects = false;
+		for (int i = 0; i < 6; i++)
+		{
+			const glm::vec4& p = Planes.Planes[i];
+			float d = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+			float r = fabsf(p.x) * e.x + fabsf(p.y) * e.y + fabsf(p.z) * e.z;
+			if (d + r < 0.0f) return OUTSIDE;
+			if (d - r < 0.0f) Intersects = true;
+		}
+		return Intersects ? INTERSECTS : INSIDE;
+#endif
+	}
+};
+
+class BoundingVolumeHierarchy
+{
+private:
+	std::vector<BvhNode> nodes; // nodes[0] is the root, children come after their parent
+	std::vector<unsigned int> items; // object indices, grouped by leaf
+	std::vector<glm::vec3> boundsMin; // per object
+	std::vector<glm::vec3> boundsMax;
+	std::vector<unsigned int> leafOf; // per object
+	std::vector<unsigned int> dirty; // leaves with moved objects
+	std::vector<bool> leafDirty; // per node
+
+public:
+	// Min/Max - Count boxes, one per object
+	void Build(unsigned int Count, const glm::vec3* pMin, const glm::vec3* pMax)
+	{
+		boundsMin.assign(pMin, pMin + Count);
+		boundsMax.assign(pMax, pMax + Count);
+		items.resize(Count);
+		for (unsigned int i = 0; i < Count; i++) items[i] = i;
+		leafOf.assign(Count, 0);
+		dirty.clear();
+		nodes.clear();
+		if (Count == 0) return;
+
+		nodes.reserve(2 * (Count / BVH_LEAF_SIZE + 1));
+		BvhNode Root;
+		Root.First = 0;
+		Root.Count = Count;
+		Root.Left = 0;
+		Root.Parent = 0;
+		nodes.push_back(Root);
+
+		// nodes are appended while splitting, so a plain index walks the tree breadth first
+		for (unsigned int n = 0; n < nodes.size(); n++)
+		{
+			FitNode(n);
+			if (nodes[n].Count <= BVH_LEAF_SIZE) continue;
+
+			glm::vec3 CenterMin(FLT_MAX), CenterMax(-FLT_MAX);
+			for (unsigned int i = nodes[n].First; i < nodes[n].First + nodes[n].Count; i++)
+			{
+				glm::vec3 Center = boundsMin[items[i]] + boundsMax[items[i]];
+				CenterMin = glm::min(CenterMin, Center);
+				CenterMax = glm::max(CenterMax, Center);
+			}
+			glm::vec3 Size = CenterMax - CenterMin;
+			int Axis = Size.x >= Size.y && Size.x >= Size.z ? 0 : (Size.y >= Size.z ? 1 : 2);
+
+			unsigned int First = nodes[n].First, Half = nodes[n].Count / 2;
+			std::nth_element(items.begin() + First, items.begin() + First + Half, items.begin() + First + nodes[n].Count,
+				[this, Axis](unsigned int a, unsigned int b) { return boundsMin[a][Axis] + boundsMax[a][Axis] < boundsMin[b][Axis] + boundsMax[b][Axis]; });
+
+			BvhNode Child;
+			Child.Left = 0;
+			Child.Parent = n;
+			Child.First = First;
+			Child.Count = Half;
+			nodes[n].Left = (unsigned int)nodes.size();
+			nodes.push_back(Child);
+			Child.First = First + Half;
+			Child.Count = nodes[n].Count - Half;
+			nodes.push_back(Child);
+		}
+
+		for (unsigned int n = 0; n < nodes.size(); n++)
+		{
+			if (nodes[n].Left != 0) continue;
+			for (unsigned int i = nodes[n].First; i < nodes[n].First + nodes[n].Count; i++) leafOf[items[i]] = n;
+		}
+		leafDirty.assign(nodes.size(), false);
+	}
+
+	// new box of a moved object; takes effect at the next Refit
+	void SetBounds(unsigned int Object, const glm::vec3& Min, const glm::vec3& Max)
+	{
+		boundsMin[Object] = Min;
+		boundsMax[Object] = Max;
+		unsigned int Leaf = leafOf[Object];
+		if (!leafDirty[Leaf])
+		{
+			leafDirty[Leaf] = true;
+			dirty.push_back(Leaf);
+		}
+	}
+
+	// refits the leaves of the moved objects and their parents up to where nothing changes;
+	// when most of the tree is dirty one pass over all nodes from the bottom is cheaper
+	void Refit()
+	{
+		if (dirty.empty()) return;
+
+		if (dirty.size() * 4 > nodes.size())
+		{
+			for (size_t n = nodes.size(); n-- > 0;)
+			{
+				if (nodes[n].Left == 0) FitNode((unsigned int)n);
+				else FitFromChildren((unsigned int)n);
+			}
+		}
+		else
+		{
+			for (unsigned int Leaf : dirty)
+			{
+				FitNode(Leaf);
+				for (unsigned int n = Leaf; n != 0;)
+				{
+					n = nodes[n].Parent;
+					glm::vec3 OldMin = nodes[n].Min, OldMax = nodes[n].Max;
+					FitFromChildren(n);
+					if (nodes[n].Min == OldMin && nodes[n].Max == OldMax) break;
+				}
+			}
+		}
+
+		for (unsigned int Leaf : dirty) leafDirty[Leaf] = false;
+		dirty.clear();
+	}
+
+	// appends the indices of the objects whose boxes touch the frustum
+	void Cull(const Frustum& View, std::vector<unsigned int>& Visible) const
+	{
+		if (nodes.empty()) return;
+
+		BvhPlanes Planes(View);
+		unsigned int Stack[64];
+		unsigned int Depth = 0;
+		Stack[Depth++] = 0;
+		while (Depth > 0)
+		{
+			const BvhNode& Node = nodes[Stack[--Depth]];
+			BvhPlanes::RESULT Result = Planes.Test(Node.Min, Node.Max);
+			if (Result == BvhPlanes::OUTSIDE) continue;
+
+			if (Result == BvhPlanes::INSIDE)
+			{
+				Visible.insert(Visible.end(), items.begin() + Node.First, items.begin() + Node.First + Node.Count);
+			}
+			else if (Node.Left != 0)
+			{
+				Stack[Depth++] = Node.Left + 1;
+				Stack[Depth++] = Node.Left;
+			}
+			else
+			{
+				for (unsigned int i = Node.First; i < Node.First + Node.Count; i++)
+				{
+					if (Planes.Test(boundsMin[items[i]], boundsMax[items[i]]) != BvhPlanes::OUTSIDE) Visible.push_back(items[i]);
+				}
+			}
+		}
+	}
+
+	// box of all objects as of the last Build/Refit, false for an empty tree
+	bool GetBounds(glm::vec3& Min, glm::vec3& Max) const
+	{
+		if (nodes.empty()) return false;
+		Min = nodes[0].Min;
+		Max = nodes[0].Max;
+		return true;
+	}
+
+	unsigned int GetNodeCount() const
+	{
+		return (unsigned int)nodes.size();
+	}
+
+private:
+	void FitNode(unsigned int n)
+	{
+		BvhNode& Node = nodes[n];
+		Node.Min = glm::vec3(FLT_MAX);
+		Node.Max = glm::vec3(-FLT_MAX);
+		for (unsigned int i = Node.First; i < Node.First + Node.Count; i++)
+		{
+			Node.Min = glm::min(Node.Min, boundsMin[items[i]]);
+			Node.Max = glm::max(Node.Max, boundsMax[items[i]]);
+		}
+	}
+
+	void FitFromChildren(unsigned int n)
+	{
+		BvhNode& Node = nodes[n];
+		Node.Min = glm::min(nodes[Node.Left].Min, nodes[Node.Left + 1].Min);
+		Node.Max = glm::max(nodes[Node.Left].Max, nodes[Node.Left + 1].Max);
+	}
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include <iostream>
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "Bvh.h"
+
+// BoundingVolumeHierarchy::Cull against testing every box on its own, which it has to match
+// exactly: a box outside a plane has all its children outside it too. Random boxes, random
+// slanted frustums, then boxes moved a few at a time (Refit walks up from the leaves) and
+// most at once (Refit redoes every node). Prints what fails, true if nothing did.
+const unsigned int BVH_TEST_BOXES = 20000;
+const unsigned int BVH_TEST_FRUSTUMS = 50;
+
+inline bool TestBoundingVolumeHierarchy()
+{
+	std::mt19937 Random(12345);
+	std::uniform_real_distribution<float> Coord(-50.0f, 50.0f), Extent(0.05f, 2.0f), Unit(-1.0f, 1.0f);
+
+	std::vector<glm::vec3> Min(BVH_TEST_BOXES), Max(BVH_TEST_BOXES);
+	auto RandomBox = [&](unsigned int i)
+	{
+		glm::vec3 Center(Coord(Random), Coord(Random), Coord(Random));
+		glm::vec3 Half(Extent(Random), Extent(Random), Extent(Random));
+		Min[i] = Center - Half;
+		Max[i] = Center + Half;
+	};
+	for (unsigned int i = 0; i < BVH_TEST_BOXES; i++) RandomBox(i);
+
+	BoundingVolumeHierarchy Bvh;
+	Bvh.Build(BVH_TEST_BOXES, Min.data(), Max.data());
+
+	// a random sub-box of the scene with every plane tilted a little
+	auto RandomFrustum = [&]()
+	{
+		Frustum View;
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			float a = Coord(Random), b = Coord(Random);
+			for (int s = 0; s < 2; s++)
+			{
+				glm::vec3 Normal(Unit(Random) * 0.3f, Unit(Random) * 0.3f, Unit(Random) * 0.3f);
+				Normal[Axis] = s == 0 ? 1.0f : -1.0f;
+				Normal = glm::normalize(Normal);
+				glm::vec3 Point(0.0f);
+				Point[Axis] = s == 0 ? std::min(a, b) : std::max(a, b);
+				View.Planes[Axis * 2 + s] = glm::vec4(Normal, -glm::dot(Normal, Point));
+			}
+		}
+		return View;
+	};
+
+	auto Check = [&](const char* pStage)
+	{
+		for (unsigned int f = 0; f < BVH_TEST_FRUSTUMS; f++)
+		{
+			Frustum View = RandomFrustum();
+			std::vector<unsigned int> Visible;
+			Bvh.Cull(View, Visible);
+			std::sort(Visible.begin(), Visible.end());
+
+			BvhPlanes Planes(View);
+			std::vector<unsigned int> Expected;
+			for (unsigned int i = 0; i < BVH_TEST_BOXES; i++)
+			{
+				if (Planes.Test(Min[i], Max[i]) != BvhPlanes::OUTSIDE) Expected.push_back(i);
+			}
+			if (Visible != Expected)
+			{
+				std::cerr << "BVH cull " << pStage << ": " << Visible.size() << " boxes, testing every box gives " << Expected.size() << "\n";
+				return false;
+			}
+		}
+		return true;
+	};
+
+	bool Passed = Check("after Build");
+
+	for (unsigned int Round = 0; Round < 10 && Passed; Round++)
+	{
+		for (unsigned int n = 0; n < 50; n++)
+		{
+			unsigned int i = Random() % BVH_TEST_BOXES;
+			RandomBox(i);
+			Bvh.SetBounds(i, Min[i], Max[i]);
+		}
+		Bvh.Refit();
+		Passed = Check("after moving a few boxes");
+	}
+
+	if (Passed)
+	{
+		for (unsigned int i = 0; i < BVH_TEST_BOXES; i += 2)
+		{
+			RandomBox(i);
+			Bvh.SetBounds(i, Min[i], Max[i]);
+		}
+		Bvh.Refit();
+		Passed = Check("after moving half of the boxes");
+	}
+	return Passed;
+}
@@ -0,0 +1,578 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include "Technique.h"
+#include "LightingTechnique.h"
+#include "Pipeline.h"
+#include "JobSystem.h"
+#include "GLStateCache.h"
+
+// The view frustum is split into CLUSTER_DIM_X x CLUSTER_DIM_Y screen tiles and
+// CLUSTER_DIM_Z depth slices (exponential in view depth), the CPU puts every light
+// into the clusters its sphere of influence touches and the fragment shader only
+// loops over the lights of its own cluster.
+const unsigned int CLUSTER_DIM_X = 16;
+const unsigned int CLUSTER_DIM_Y = 9;
+const unsigned int CLUSTER_DIM_Z = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_DIM_X * CLUSTER_DIM_Y * CLUSTER_DIM_Z;
+
+// texture units of the cluster buffers, unit 0 is taken by the diffuse texture
+const GLuint CLUSTER_LIGHT_DATA_UNIT = 1;
+const GLuint CLUSTER_TABLE_UNIT = 2;
+const GLuint CLUSTER_INDEX_UNIT = 3;
+
+// texels of gLightData per light
+const unsigned int CLUSTER_POINT_LIGHT_TEXELS = 3;
+const unsigned int CLUSTER_SPOT_LIGHT_TEXELS = 4;
+
+// appended to lightingCommon instead of the fixed-size light arrays of "fragment"
+static const char* clusteredFragment = R"(
+	uniform DirectionalLight gDirectionalLight;
+
+	uniform samplerBuffer gLightData;     // point lights first, then spot lights
+	uniform usamplerBuffer gClusterTable; // (offset, point count, spot count, 0) for every cluster
+	uniform usamplerBuffer gLightIndices; // per cluster: point light indices, then spot light indices
+	uniform int gSpotLightBase;           // first texel of the spot lights in gLightData
+	uniform ivec3 gClusterDims;
+	uniform vec2 gTileSize;               // size of a screen tile in pixels
+	uniform float gZNear;
+	uniform float gZFar;
+
+	PointLight FetchPointLight(int Index)
+	{
+		int t = Index * 3;
+		vec4 a = texelFetch(gLightData, t);
+		vec4 b = texelFetch(gLightData, t + 1);
+		vec4 c = texelFetch(gLightData, t + 2);
+
+		PointLight l;
+		l.Base.Color = a.xyz;
+		l.Base.AmbientIntensity = a.w;
+		l.Base.DiffuseIntensity = b.w;
+		l.Position = b.xyz;
+		l.Atten.Constant = c.x;
+		l.Atten.Linear = c.y;
+		l.Atten.Exp = c.z;
+		return l;
+	}
+
+	SpotLight FetchSpotLight(int Index)
+	{
+		int t = gSpotLightBase + Index * 4;
+		vec4 a = texelFetch(gLightData, t);
+		vec4 b = texelFetch(gLightData, t + 1);
+		vec4 c = texelFetch(gLightData, t + 2);
+		vec4 d = texelFetch(gLightData, t + 3);
+
+		SpotLight l;
+		l.Base.Base.Color = a.xyz;
+		l.Base.Base.AmbientIntensity = a.w;
+		l.Base.Base.DiffuseIntensity = b.w;
+		l.Base.Position = b.xyz;
+		l.Base.Atten.Constant = c.x;
+		l.Base.Atten.Linear = c.y;
+		l.Base.Atten.Exp = c.z;
+		l.Direction = d.xyz;
+		l.Cutoff = d.w;
+		return l;
+	}
+
+	int ClusterIndex()
+	{
+		// view depth from the window depth, the inverse of Pipeline::InitPerspectiveProj
+		float Ndc = gl_FragCoord.z * 2.0 - 1.0;
+		float A = (gZNear + gZFar) / (gZFar - gZNear);
+		float B = 2.0 * gZFar * gZNear / (gZNear - gZFar);
+		float ViewZ = B / (Ndc - A);
+
+		int Slice = int(log(ViewZ / gZNear) / log(gZFar / gZNear) * float(gClusterDims.z));
+		ivec2 Tile = ivec2(gl_FragCoord.xy / gTileSize);
+
+		Slice = clamp(Slice, 0, gClusterDims.z - 1);
+		Tile = clamp(Tile, ivec2(0, 0), gClusterDims.xy - 1);
+		return (Slice * gClusterDims.y + Tile.y) * gClusterDims.x + Tile.x;
+	}
+
+	void main()
+	{
+		vec3 Normal = normalize(Normal0);
+		vec4 TotalLight = CalcLightInternal(gDirectionalLight.Base, gDirectionalLight.Direction, Normal);
+
+		uvec4 Cluster = texelFetch(gClusterTable, ClusterIndex());
+		int Offset = int(Cluster.x);
+
+		for (int i = 0 ; i < int(Cluster.y) ; i++)
+		{
+			int Index = int(texelFetch(gLightIndices, Offset + i).r);
+			TotalLight += CalcPointLight(FetchPointLight(Index), Normal);
+		}
+		Offset += int(Cluster.y);
+
+		for (int i = 0 ; i < int(Cluster.z) ; i++)
+		{
+			int Index = int(texelFetch(gLightIndices, Offset + i).r);
+			TotalLight += CalcSpotLight(FetchSpotLight(Index), Normal);
+		}
+
+		FragColor = SampleDiffuse(TexCoord0.xy) * TotalLight;
+	})";
+
+// Bins point and spot lights into the cluster grid and keeps the result in three
+// texture buffers: light data (RGBA32F), cluster table (RGBA32UI) and light indices (R32UI).
+class LightClusterer
+{
+private:
+	enum { LIGHT_DATA, CLUSTER_TABLE, LIGHT_INDICES, NUM_BUFFERS };
+
+	struct LightBounds
+	{
+		glm::vec3 ViewPos;
+		float Radius;
+	};
+
+	struct ClusterAABB
+	{
+		glm::vec3 Min;
+		glm::vec3 Max;
+	};
+
+	GLuint buffers[NUM_BUFFERS];
+	GLuint textures[NUM_BUFFERS];
+
+	unsigned int numPointLights;
+	unsigned int numSpotLights;
+
+	std::vector<glm::vec4> lightData;
+	std::vector<GLuint> clusterTable;
+	std::vector<GLuint> lightIndices;
+
+	std::vector<LightBounds> pointBounds;
+	std::vector<LightBounds> spotBounds;
+	std::vector<std::vector<GLuint> > clusterPointLights; // per cluster, filled by the job owning its slice
+	std::vector<std::vector<GLuint> > clusterSpotLights;
+
+	ClusterAABB clusterBounds[CLUSTER_COUNT];
+	float sliceDepth[CLUSTER_DIM_Z + 1];
+	m_persProj clusterProj; // projection the cluster bounds were built for
+
+public:
+	LightClusterer()
+	{
+		for (unsigned int i = 0; i < NUM_BUFFERS; i++)
+		{
+			buffers[i] = 0;
+			textures[i] = 0;
+		}
+		numPointLights = 0;
+		numSpotLights = 0;
+		clusterProj = m_persProj{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+		clusterPointLights.resize(CLUSTER_COUNT);
+		clusterSpotLights.resize(CLUSTER_COUNT);
+		clusterTable.resize(CLUSTER_COUNT * 4);
+	}
+
+	~LightClusterer()
+	{
+		GLStateCache::Get().DeleteTextures(NUM_BUFFERS, textures);
+		glDeleteBuffers(NUM_BUFFERS, buffers);
+	}
+
+	bool Init()
+	{
+		const GLenum Formats[NUM_BUFFERS] = { GL_RGBA32F, GL_RGBA32UI, GL_R32UI };
+
+		glGenBuffers(NUM_BUFFERS, buffers);
+		glGenTextures(NUM_BUFFERS, textures);
+
+		for (unsigned int i = 0; i < NUM_BUFFERS; i++)
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+			glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+			GLStateCache::Get().BindTexture(GL_TEXTURE_BUFFER, textures[i]);
+			glTexBuffer(GL_TEXTURE_BUFFER, Formats[i], buffers[i]);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		GLStateCache::Get().BindTexture(GL_TEXTURE_BUFFER, 0);
+
+		return glGetError() == GL_NO_ERROR;
+	}
+
+	// assigns the lights to clusters of the frustum seen through View and Proj, touches
+	// no GL state so it can run in a job; Upload sends the result to the buffers
+	void Prepare(const glm::mat4& View, const m_persProj& Proj, unsigned int NumPointLights, const PointLight* pPointLights,
+		unsigned int NumSpotLights, const SpotLight* pSpotLights, JobSystem& Jobs)
+	{
+		numPointLights = NumPointLights;
+		numSpotLights = NumSpotLights;
+
+		if (Proj.FOV != clusterProj.FOV || Proj.Width != clusterProj.Width || Proj.Height != clusterProj.Height ||
+			Proj.zNear != clusterProj.zNear || Proj.zFar != clusterProj.zFar)
+		{
+			BuildClusterBounds(Proj);
+		}
+
+		PackLights(View, pPointLights, pSpotLights);
+
+		// every job owns whole depth slices, so no two threads write the same cluster list
+		JobCounter Binned;
+		Jobs.ParallelFor(Binned, CLUSTER_DIM_Z, 1, [this](unsigned int First, unsigned int Last)
+		{
+			for (unsigned int k = First; k < Last; k++) BinSlice(k);
+		});
+		Jobs.Wait(Binned);
+
+		Compact();
+	}
+
+	void Upload()
+	{
+		UploadBuffer(buffers[LIGHT_DATA], lightData.data(), lightData.size() * sizeof(glm::vec4));
+		UploadBuffer(buffers[CLUSTER_TABLE], clusterTable.data(), clusterTable.size() * sizeof(GLuint));
+		UploadBuffer(buffers[LIGHT_INDICES], lightIndices.data(), lightIndices.size() * sizeof(GLuint));
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	// binds the cluster buffers to CLUSTER_*_UNIT
+	void Bind()
+	{
+		GLStateCache::Get().BindTexture(GL_TEXTURE0 + CLUSTER_LIGHT_DATA_UNIT, GL_TEXTURE_BUFFER, textures[LIGHT_DATA]);
+		GLStateCache::Get().BindTexture(GL_TEXTURE0 + CLUSTER_TABLE_UNIT, GL_TEXTURE_BUFFER, textures[CLUSTER_TABLE]);
+		GLStateCache::Get().BindTexture(GL_TEXTURE0 + CLUSTER_INDEX_UNIT, GL_TEXTURE_BUFFER, textures[LIGHT_INDICES]);
+		GLStateCache::Get().ActiveTexture(GL_TEXTURE0);
+	}
+
+	GLint GetSpotLightBase() const
+	{
+		return numPointLights * CLUSTER_POINT_LIGHT_TEXELS;
+	}
+
+	unsigned int GetNumLightIndices() const
+	{
+		return (unsigned int)lightIndices.size();
+	}
+
+private:
+	static glm::vec3 TransformPoint(const glm::mat4& m, const glm::vec3& v)
+	{
+		// Pipeline matrices are stored row by row
+		return glm::vec3(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z + m[0][3],
+						 m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z + m[1][3],
+						 m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z + m[2][3]);
+	}
+
+	void BuildClusterBounds(const m_persProj& Proj)
+	{
+		clusterProj = Proj;
+
+		float TanHalfFOV = tanf(glm::radians(Proj.FOV / 2.0f));
+		float ar = Proj.Width / Proj.Height;
+
+		for (unsigned int k = 0; k <= CLUSTER_DIM_Z; k++)
+		{
+			sliceDepth[k] = Proj.zNear * powf(Proj.zFar / Proj.zNear, (float)k / CLUSTER_DIM_Z);
+		}
+
+		for (unsigned int k = 0; k < CLUSTER_DIM_Z; k++)
+		{
+			for (unsigned int j = 0; j < CLUSTER_DIM_Y; j++)
+			{
+				for (unsigned int i = 0; i < CLUSTER_DIM_X; i++)
+				{
+					float x0 = (-1.0f + 2.0f * i / CLUSTER_DIM_X) * TanHalfFOV * ar;
+					float x1 = (-1.0f + 2.0f * (i + 1) / CLUSTER_DIM_X) * TanHalfFOV * ar;
+					float y0 = (-1.0f + 2.0f * j / CLUSTER_DIM_Y) * TanHalfFOV;
+					float y1 = (-1.0f + 2.0f * (j + 1) / CLUSTER_DIM_Y) * TanHalfFOV;
+					float zn = sliceDepth[k], zf = sliceDepth[k + 1];
+
+					ClusterAABB& Box = clusterBounds[(k * CLUSTER_DIM_Y + j) * CLUSTER_DIM_X + i];
+					Box.Min = glm::vec3(std::min(x0 * zn, x0 * zf), std::min(y0 * zn, y0 * zf), zn);
+					Box.Max = glm::vec3(std::max(x1 * zn, x1 * zf), std::max(y1 * zn, y1 * zf), zf);
+				}
+			}
+		}
+	}
+
+	void PackLights(const glm::mat4& View, const PointLight* pPointLights, const SpotLight* pSpotLights)
+	{
+		// the camera basis is not necessarily orthonormal, so scale the radii by its longest axis
+		float ViewScale = 0.0f;
+		for (int r = 0; r < 3; r++)
+		{
+			ViewScale = std::max(ViewScale, glm::length(glm::vec3(View[r][0], View[r][1], View[r][2])));
+		}
+
+		lightData.resize(numPointLights * CLUSTER_POINT_LIGHT_TEXELS + numSpotLights * CLUSTER_SPOT_LIGHT_TEXELS);
+		pointBounds.resize(numPointLights);
+		spotBounds.resize(numSpotLights);
+
+		glm::vec4* pData = lightData.data();
+		for (unsigned int i = 0; i < numPointLights; i++)
+		{
+			const PointLight& l = pPointLights[i];
+			*pData++ = glm::vec4(l.Color, l.AmbientIntensity);
+			*pData++ = glm::vec4(l.Position, l.DiffuseIntensity);
+			*pData++ = glm::vec4(l.Attenuation.Constant, l.Attenuation.Linear, l.Attenuation.Exp, 0.0f);
+
+			pointBounds[i].ViewPos = TransformPoint(View, l.Position);
+			pointBounds[i].Radius = ViewRadius(CalcPointLightRadius(l), ViewScale);
+		}
+		for (unsigned int i = 0; i < numSpotLights; i++)
+		{
+			const SpotLight& l = pSpotLights[i];
+			*pData++ = glm::vec4(l.Color, l.AmbientIntensity);
+			*pData++ = glm::vec4(l.Position, l.DiffuseIntensity);
+			*pData++ = glm::vec4(l.Attenuation.Constant, l.Attenuation.Linear, l.Attenuation.Exp, 0.0f);
+			*pData++ = glm::vec4(l.Direction, cosf(glm::radians(l.Cutoff)));
+
+			spotBounds[i].ViewPos = TransformPoint(View, l.Position);
+			spotBounds[i].Radius = ViewRadius(CalcPointLightRadius(l), ViewScale);
+		}
+	}
+
+	// FLT_MAX (not attenuated) stays FLT_MAX, scaled it would be inf and pass the checks for it;
+	// a finite radius that the scale takes past FLT_MAX counts as not attenuated as well
+	static float ViewRadius(float Radius, float ViewScale)
+	{
+		if (Radius == FLT_MAX) return FLT_MAX;
+		return std::min(Radius * ViewScale, FLT_MAX);
+	}
+
+	static bool SphereIntersectsAABB(const LightBounds& Light, const ClusterAABB& Box)
+	{
+		float DistSq = 0.0f;
+		for (int a = 0; a < 3; a++)
+		{
+			float v = Light.ViewPos[a];
+			if (v < Box.Min[a]) DistSq += (Box.Min[a] - v) * (Box.Min[a] - v);
+			else if (v > Box.Max[a]) DistSq += (v - Box.Max[a]) * (v - Box.Max[a]);
+		}
+		return Light.Radius == FLT_MAX || DistSq <= Light.Radius * Light.Radius;
+	}
+
+	// adds the lights touching slice k to the lists of its clusters
+	void BinLights(unsigned int k, const std::vector<LightBounds>& Bounds, std::vector<std::vector<GLuint> >& Lists)
+	{
+		float TanHalfFOV = tanf(glm::radians(clusterProj.FOV / 2.0f));
+		float ar = clusterProj.Width / clusterProj.Height;
+		float zn = sliceDepth[k], zf = sliceDepth[k + 1];
+
+		for (GLuint l = 0; l < (GLuint)Bounds.size(); l++)
+		{
+			const LightBounds& Light = Bounds[l];
+			unsigned int i0 = 0, i1 = CLUSTER_DIM_X - 1, j0 = 0, j1 = CLUSTER_DIM_Y - 1;
+
+			if (Light.Radius != FLT_MAX)
+			{
+				if (Light.ViewPos.z + Light.Radius < zn || Light.ViewPos.z - Light.Radius > zf) continue;
+
+				// screen footprint of the sphere's box over the depth range it shares with the slice;
+				// a / d is monotonic in d, so the extremes are at the ends of the range
+				float d0 = std::max(zn, Light.ViewPos.z - Light.Radius);
+				float d1 = std::min(zf, Light.ViewPos.z + Light.Radius);
+				float xs = 1.0f / (TanHalfFOV * ar), ys = 1.0f / TanHalfFOV;
+				float Left = Light.ViewPos.x - Light.Radius, Right = Light.ViewPos.x + Light.Radius;
+				float Bottom = Light.ViewPos.y - Light.Radius, Top = Light.ViewPos.y + Light.Radius;
+
+				float x0 = std::min(Left / d0, Left / d1) * xs, x1 = std::max(Right / d0, Right / d1) * xs;
+				float y0 = std::min(Bottom / d0, Bottom / d1) * ys, y1 = std::max(Top / d0, Top / d1) * ys;
+				if (x1 < -1.0f || x0 > 1.0f || y1 < -1.0f || y0 > 1.0f) continue;
+
+				i0 = TileIndex(x0, CLUSTER_DIM_X); i1 = TileIndex(x1, CLUSTER_DIM_X);
+				j0 = TileIndex(y0, CLUSTER_DIM_Y); j1 = TileIndex(y1, CLUSTER_DIM_Y);
+			}
+
+			for (unsigned int j = j0; j <= j1; j++)
+			{
+				for (unsigned int i = i0; i <= i1; i++)
+				{
+					unsigned int c = (k * CLUSTER_DIM_Y + j) * CLUSTER_DIM_X + i;
+					if (SphereIntersectsAABB(Light, clusterBounds[c])) Lists[c].push_back(l);
+				}
+			}
+		}
+	}
+
+	static unsigned int TileIndex(float Ndc, unsigned int Dim)
+	{
+		int t = (int)floorf((Ndc * 0.5f + 0.5f) * Dim);
+		return (unsigned int)std::min(std::max(t, 0), (int)Dim - 1);
+	}
+
+	void BinSlice(unsigned int k)
+	{
+		unsigned int First = k * CLUSTER_DIM_X * CLUSTER_DIM_Y;
+		for (unsigned int c = First; c < First + CLUSTER_DIM_X * CLUSTER_DIM_Y; c++)
+		{
+			clusterPointLights[c].clear();
+			clusterSpotLights[c].clear();
+		}
+
+		BinLights(k, pointBounds, clusterPointLights);
+		BinLights(k, spotBounds, clusterSpotLights);
+	}
+
+	void Compact()
+	{
+		GLuint Offset = 0;
+		for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+		{
+			clusterTable[c * 4 + 0] = Offset;
+			clusterTable[c * 4 + 1] = (GLuint)clusterPointLights[c].size();
+			clusterTable[c * 4 + 2] = (GLuint)clusterSpotLights[c].size();
+			clusterTable[c * 4 + 3] = 0;
+			Offset += clusterTable[c * 4 + 1] + clusterTable[c * 4 + 2];
+		}
+
+		lightIndices.resize(Offset);
+		for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+		{
+			GLuint* pDst = lightIndices.data() + clusterTable[c * 4];
+			pDst = std::copy(clusterPointLights[c].begin(), clusterPointLights[c].end(), pDst);
+			std::copy(clusterSpotLights[c].begin(), clusterSpotLights[c].end(), pDst);
+		}
+	}
+
+	static void UploadBuffer(GLuint Buffer, const void* pData, size_t Size)
+	{
+		// an empty texture buffer is not allowed, keep at least one texel
+		glBindBuffer(GL_TEXTURE_BUFFER, Buffer);
+		glBufferData(GL_TEXTURE_BUFFER, std::max(Size, (size_t)16), nullptr, GL_STREAM_DRAW);
+		if (Size > 0) glBufferSubData(GL_TEXTURE_BUFFER, 0, Size, pData);
+	}
+};
+
+// Forward lighting with any number of point and spot lights, reads them
+// from the buffers built by LightClusterer.
+class ClusteredLightingTechnique : public Technique
+{
+private:
+	GLuint gWorldLocation;
+	GLuint gWVPLocation;
+	GLuint gViewProjLocation; // instanced mode only
+	GLuint gSamplerLocation;
+	bool instanced;
+
+	GLuint dirLightColor;
+	GLuint dirLightAmbientIntensity;
+	GLuint dirLightDirection;
+	GLuint dirLightDiffuseIntensity;
+
+	GLuint eyeWorldPosition;
+	GLuint matSpecularIntensityLocation;
+	GLuint matSpecularPowerLocation;
+
+	GLuint spotLightBaseLocation;
+	GLuint clusterDimsLocation;
+	GLuint tileSizeLocation;
+	GLuint zNearLocation;
+	GLuint zFarLocation;
+
+public:
+	// Instanced: world matrices come from the instance buffer instead of gWorld/gWVP
+	ClusteredLightingTechnique(bool Instanced = false)
+	{
+		instanced = Instanced;
+		gWorldLocation = gWVPLocation = gViewProjLocation = 0;
+	}
+
+	virtual bool Init() override
+	{
+		if (!Technique::Init()) return false;
+		const char* FragmentParts[] = { fragmentHeader, lightingCommon, clusteredFragment };
+		if (!createShaders(instanced ? &vertexInstanced : &vertex, 1, FragmentParts, 3)) return false;
+
+		if (instanced)
+		{
+			gViewProjLocation = GetUniformLocation("gViewProj");
+		}
+		else
+		{
+			gWorldLocation = GetUniformLocation("gWorld");
+			gWVPLocation = GetUniformLocation("gWVP");
+		}
+		gSamplerLocation = GetUniformLocation("gSampler");
+
+		dirLightColor = GetUniformLocation("gDirectionalLight.Base.Color");
+		dirLightAmbientIntensity = GetUniformLocation("gDirectionalLight.Base.AmbientIntensity");
+		dirLightDirection = GetUniformLocation("gDirectionalLight.Direction");
+		dirLightDiffuseIntensity = GetUniformLocation("gDirectionalLight.Base.DiffuseIntensity");
+
+		eyeWorldPosition = GetUniformLocation("gEyeWorldPos");
+		matSpecularIntensityLocation = GetUniformLocation("gMatSpecularIntensity");
+		matSpecularPowerLocation = GetUniformLocation("gSpecularPower");
+
+		spotLightBaseLocation = GetUniformLocation("gSpotLightBase");
+		clusterDimsLocation = GetUniformLocation("gClusterDims");
+		tileSizeLocation = GetUniformLocation("gTileSize");
+		zNearLocation = GetUniformLocation("gZNear");
+		zFarLocation = GetUniformLocation("gZFar");
+
+		// the sampler units never change, set them once
+		Enable();
+		glUniform1i(GetUniformLocation("gLightData"), CLUSTER_LIGHT_DATA_UNIT);
+		glUniform1i(GetUniformLocation("gClusterTable"), CLUSTER_TABLE_UNIT);
+		glUniform1i(GetUniformLocation("gLightIndices"), CLUSTER_INDEX_UNIT);
+		glUniform3i(clusterDimsLocation, CLUSTER_DIM_X, CLUSTER_DIM_Y, CLUSTER_DIM_Z);
+
+		return true;
+	}
+
+	void SetWorld(glm::mat4* value)
+	{
+		glUniformMatrix4fv(gWorldLocation, 1, GL_TRUE, (const GLfloat*)value);
+	}
+
+	void SetWVP(glm::mat4* value)
+	{
+		glUniformMatrix4fv(gWVPLocation, 1, GL_TRUE, (const GLfloat*)value);
+	}
+
+	void SetViewProj(const glm::mat4* value)
+	{
+		glUniformMatrix4fv(gViewProjLocation, 1, GL_TRUE, (const GLfloat*)value);
+	}
+
+	void SetTextureUnit(unsigned int TextureUnit)
+	{
+		glUniform1i(gSamplerLocation, TextureUnit);
+	}
+
+	void SetDirectionalLight(DirectionalLight& Light)
+	{
+		glUniform3f(dirLightColor, Light.Color.x, Light.Color.y, Light.Color.z);
+		glUniform1f(dirLightAmbientIntensity, Light.AmbientIntensity);
+		glUniform3f(dirLightDirection, Light.Direction.x, Light.Direction.y, Light.Direction.z);
+		glUniform1f(dirLightDiffuseIntensity, Light.DiffuseIntensity);
+	}
+
+	void SetMatSpecularIntensity(float Intensity)
+	{
+		glUniform1f(matSpecularIntensityLocation, Intensity);
+	}
+
+	void SetMatSpecularPower(float Power)
+	{
+		glUniform1f(matSpecularPowerLocation, Power);
+	}
+
+	void SetEyeWorldPos(const glm::vec3& EyeWorldPos)
+	{
+		glUniform3f(eyeWorldPosition, EyeWorldPos.x, EyeWorldPos.y, EyeWorldPos.z);
+	}
+
+	// grid parameters of the frame, the projection must be the one passed to LightClusterer::Prepare
+	void SetClusters(const LightClusterer& Clusterer, const m_persProj& Proj)
+	{
+		glUniform1i(spotLightBaseLocation, Clusterer.GetSpotLightBase());
+		glUniform2f(tileSizeLocation, Proj.Width / CLUSTER_DIM_X, Proj.Height / CLUSTER_DIM_Y);
+		glUniform1f(zNearLocation, Proj.zNear);
+		glUniform1f(zFarLocation, Proj.zFar);
+	}
+};
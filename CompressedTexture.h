@@ -0,0 +1,237 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// Block compressed images with their whole mip chain, precomputed offline and read
+// from DDS or KTX (version 1) containers: BC1 (DXT1), BC3 (DXT5) and BC7 (BPTC),
+// 2D only, no arrays or cube maps. The levels go to glCompressedTexImage2D as they
+// are in the file, there is no decoding on the CPU.
+struct CompressedImage
+{
+	struct Level
+	{
+		GLsizei Width;
+		GLsizei Height;
+		size_t Offset; // into Data
+		size_t Size;
+	};
+
+	GLenum Format; // internal format
+	std::vector<Level> Levels; // 0 is the full size
+	std::vector<unsigned char> Data;
+
+	CompressedImage() : Format(0) { }
+};
+
+namespace CompressedTextureDetail
+{
+	const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+	const uint32_t DDPF_FOURCC = 0x4;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const GLsizei MAX_SIZE = 1 << 16; // keeps the level size arithmetic in range
+	const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	inline uint32_t FourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)(unsigned char)a | ((uint32_t)(unsigned char)b << 8) | ((uint32_t)(unsigned char)c << 16) | ((uint32_t)(unsigned char)d << 24);
+	}
+
+	inline uint32_t ReadU32(const unsigned char* p)
+	{
+		uint32_t Value;
+		memcpy(&Value, p, sizeof(Value));
+		return Value;
+	}
+
+	// bytes per 4x4 block, 0 for formats that are not supported
+	inline size_t BlockSize(GLenum Format)
+	{
+		switch (Format)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+			return 8;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	inline size_t LevelSize(GLenum Format, GLsizei Width, GLsizei Height)
+	{
+		return (size_t)((Width + 3) / 4) * (size_t)((Height + 3) / 4) * BlockSize(Format);
+	}
+
+	inline GLenum FormatFromDXGI(uint32_t Format)
+	{
+		switch (Format)
+		{
+		case 71: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; // DXGI_FORMAT_BC1_UNORM
+		case 72: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+		case 77: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; // DXGI_FORMAT_BC3_UNORM
+		case 78: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+		case 98: return GL_COMPRESSED_RGBA_BPTC_UNORM; // DXGI_FORMAT_BC7_UNORM
+		case 99: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+		default: return 0;
+		}
+	}
+
+	// levels of a full chain, 1 + log2 of the larger side; more would shift the sizes past zero
+	inline uint32_t MaxLevelCount(GLsizei Width, GLsizei Height)
+	{
+		uint32_t Count = 1;
+		for (GLsizei Size = std::max(Width, Height); Size > 1; Size >>= 1) Count++;
+		return Count;
+	}
+
+	// the level table of a tightly packed chain that starts at Offset
+	inline bool LayoutLevels(CompressedImage& Image, GLsizei Width, GLsizei Height, uint32_t LevelCount, size_t Offset)
+	{
+		Image.Levels.clear();
+		for (uint32_t i = 0; i < LevelCount; i++)
+		{
+			CompressedImage::Level Level;
+			Level.Width = std::max(Width >> i, 1);
+			Level.Height = std::max(Height >> i, 1);
+			Level.Offset = Offset;
+			Level.Size = LevelSize(Image.Format, Level.Width, Level.Height);
+			if (Offset + Level.Size > Image.Data.size()) return false;
+			Image.Levels.push_back(Level);
+			Offset += Level.Size;
+			if (Level.Width == 1 && Level.Height == 1) break;
+		}
+		return !Image.Levels.empty();
+	}
+
+	inline bool ParseDDS(CompressedImage& Image)
+	{
+		const std::vector<unsigned char>& d = Image.Data;
+		if (d.size() < 128 || ReadU32(&d[0]) != DDS_MAGIC || ReadU32(&d[4]) != 124) return false;
+
+		uint32_t Flags = ReadU32(&d[8]);
+		GLsizei Height = (GLsizei)ReadU32(&d[12]);
+		GLsizei Width = (GLsizei)ReadU32(&d[16]);
+		uint32_t LevelCount = (Flags & DDSD_MIPMAPCOUNT) ? std::max(ReadU32(&d[28]), 1u) : 1;
+		uint32_t PixelFlags = ReadU32(&d[80]);
+		uint32_t Code = ReadU32(&d[84]);
+		if (!(PixelFlags & DDPF_FOURCC) || Width <= 0 || Height <= 0 || Width > MAX_SIZE || Height > MAX_SIZE) return false;
+		if (LevelCount > MaxLevelCount(Width, Height)) return false;
+
+		size_t Offset = 128;
+		if (Code == FourCC('D', 'X', 'T', '1')) Image.Format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		else if (Code == FourCC('D', 'X', 'T', '5')) Image.Format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		else if (Code == FourCC('D', 'X', '1', '0'))
+		{
+			// DDS_HEADER_DXT10: dxgiFormat, resourceDimension, miscFlag, arraySize, miscFlags2
+			if (d.size() < 148) return false;
+			Image.Format = FormatFromDXGI(ReadU32(&d[128]));
+			if (ReadU32(&d[132]) != 3 || ReadU32(&d[140]) > 1) return false; // TEXTURE2D, one element
+			Offset = 148;
+		}
+		if (BlockSize(Image.Format) == 0) return false;
+
+		return LayoutLevels(Image, Width, Height, LevelCount, Offset);
+	}
+
+	inline bool ParseKTX(CompressedImage& Image)
+	{
+		const std::vector<unsigned char>& d = Image.Data;
+		if (d.size() < 64 || memcmp(&d[0], KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0) return false;
+		if (ReadU32(&d[12]) != 0x04030201) return false; // written on a big endian machine
+
+		Image.Format = ReadU32(&d[28]); // glInternalFormat
+		GLsizei Width = (GLsizei)ReadU32(&d[36]);
+		GLsizei Height = (GLsizei)ReadU32(&d[40]);
+		uint32_t Depth = ReadU32(&d[44]), Elements = ReadU32(&d[48]), Faces = ReadU32(&d[52]);
+		uint32_t LevelCount = std::max(ReadU32(&d[56]), 1u);
+		uint32_t KeyValueBytes = ReadU32(&d[60]);
+		if (BlockSize(Image.Format) == 0 || Width <= 0 || Height <= 0 || Width > MAX_SIZE || Height > MAX_SIZE || Depth > 1 || Elements > 1 || Faces != 1) return false;
+		if (LevelCount > MaxLevelCount(Width, Height)) return false;
+
+		// every level is preceded by its size and padded to 4 bytes
+		Image.Levels.clear();
+		size_t Offset = 64 + (size_t)KeyValueBytes;
+		for (uint32_t i = 0; i < LevelCount; i++)
+		{
+			if (Offset + 4 > d.size()) return false;
+			CompressedImage::Level Level;
+			Level.Width = std::max(Width >> i, 1);
+			Level.Height = std::max(Height >> i, 1);
+			Level.Size = ReadU32(&d[Offset]);
+			Level.Offset = Offset + 4;
+			if (Level.Size != LevelSize(Image.Format, Level.Width, Level.Height) || Level.Offset + Level.Size > d.size()) return false;
+			Image.Levels.push_back(Level);
+			Offset = (Level.Offset + Level.Size + 3) & ~(size_t)3;
+		}
+		return true;
+	}
+}
+
+// by extension, .dds and .ktx
+inline bool IsCompressedTextureFile(const std::string& FileName)
+{
+	size_t Dot = FileName.find_last_of('.');
+	if (Dot == std::string::npos) return false;
+	std::string Extension = FileName.substr(Dot + 1);
+	for (char& c : Extension) c = (char)tolower((unsigned char)c);
+	return Extension == "dds" || Extension == "ktx";
+}
+
+// reads the whole container, safe to call from any thread
+inline bool LoadCompressedImage(const std::string& FileName, CompressedImage& Image)
+{
+	using namespace CompressedTextureDetail;
+
+	std::ifstream File(FileName, std::ios::binary);
+	if (!File)
+	{
+		std::cerr << "Error opening texture '" << FileName << "'\n";
+		return false;
+	}
+	Image = CompressedImage();
+	Image.Data.assign(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+
+	bool IsDDS = Image.Data.size() >= 4 && ReadU32(&Image.Data[0]) == DDS_MAGIC;
+	if (!(IsDDS ? ParseDDS(Image) : ParseKTX(Image)))
+	{
+		std::cerr << "Unsupported or invalid compressed texture '" << FileName << "' (BC1, BC3 or BC7 2D DDS/KTX expected)\n";
+		Image = CompressedImage();
+		return false;
+	}
+	return true;
+}
+
+// the S3TC and BPTC extensions are optional in GL 3.3
+inline bool IsCompressedFormatSupported(GLenum Format)
+{
+	if (CompressedTextureDetail::BlockSize(Format) == 16 && Format != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT && Format != GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT)
+	{
+		return GLEW_ARB_texture_compression_bptc != 0;
+	}
+	return GLEW_EXT_texture_compression_s3tc != 0;
+}
@@ -0,0 +1,771 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include "Technique.h"
+#include "LightingTechnique.h"
+#include "Pipeline.h"
+#include "GLStateCache.h"
+
+// Deferred shading: the geometry pass writes the surface attributes into the
+// G-buffer, then every light is drawn as a volume (full screen for the
+// directional light, a sphere for a point light, a cone for a spot light) and
+// added to the frame, so lighting costs screen pixels times the lights covering them.
+
+// texture units the G-buffer is bound to during the light pass
+const GLuint GBUFFER_POSITION_UNIT = 0;
+const GLuint GBUFFER_NORMAL_UNIT = 1;
+const GLuint GBUFFER_DIFFUSE_UNIT = 2;
+const GLuint GBUFFER_SPECULAR_UNIT = 3;
+
+static const char* geometryPassFragment = R"(
+	#version 330
+
+	in vec2 TexCoord0;
+	in vec3 Normal0;
+	in vec3 WorldPos0;
+
+	layout (location = 0) out vec3 WorldPosOut;
+	layout (location = 1) out vec3 NormalOut;
+	layout (location = 2) out vec4 DiffuseOut;
+	layout (location = 3) out vec2 SpecularOut;
+
+	uniform sampler2D gSampler;
+	uniform float gMatSpecularIntensity;
+	uniform float gSpecularPower;
+
+	void main()
+	{
+		WorldPosOut = WorldPos0;
+		NormalOut = normalize(Normal0);
+		DiffuseOut = texture2D(gSampler, TexCoord0.xy);
+		SpecularOut = vec2(gMatSpecularIntensity, gSpecularPower);
+	})";
+
+// light volumes only need their position
+static const char* lightPassVertex = R"(
+	#version 330
+
+	layout (location = 0) in vec3 Position;
+
+	uniform mat4 gWVP;
+
+	void main()
+	{
+		gl_Position = gWVP * vec4(Position, 1.0);
+	})";
+
+// reads the G-buffer into the globals lightingCommon expects
+static const char* lightPassHeader = R"(
+	#version 330
+
+	uniform sampler2D gPositionMap;
+	uniform sampler2D gNormalMap;
+	uniform sampler2D gDiffuseMap;
+	uniform sampler2D gSpecularMap;
+	uniform vec2 gScreenSize;
+	uniform vec3 gEyeWorldPos;
+
+	out vec4 FragColor;
+
+	vec3 WorldPos0;
+	float gMatSpecularIntensity;
+	float gSpecularPower;
+	vec4 Diffuse;
+
+	vec3 ReadGBuffer()
+	{
+		vec2 TexCoord = gl_FragCoord.xy / gScreenSize;
+		vec2 Specular = texture(gSpecularMap, TexCoord).xy;
+
+		WorldPos0 = texture(gPositionMap, TexCoord).xyz;
+		Diffuse = texture(gDiffuseMap, TexCoord);
+		gMatSpecularIntensity = Specular.x;
+		gSpecularPower = Specular.y;
+		return normalize(texture(gNormalMap, TexCoord).xyz);
+	}
+)";
+
+static const char* dirLightPassFragment = R"(
+	uniform DirectionalLight gDirectionalLight;
+
+	void main()
+	{
+		vec3 Normal = ReadGBuffer();
+		FragColor = Diffuse * CalcLightInternal(gDirectionalLight.Base, gDirectionalLight.Direction, Normal);
+	})";
+
+static const char* pointLightPassFragment = R"(
+	uniform PointLight gPointLight;
+
+	void main()
+	{
+		vec3 Normal = ReadGBuffer();
+		FragColor = Diffuse * CalcPointLight(gPointLight, Normal);
+	})";
+
+static const char* spotLightPassFragment = R"(
+	uniform SpotLight gSpotLight;
+
+	void main()
+	{
+		vec3 Normal = ReadGBuffer();
+		FragColor = Diffuse * CalcSpotLight(gSpotLight, Normal);
+	})";
+
+class GBuffer
+{
+public:
+	enum GBUFFER_TEXTURE_TYPE
+	{
+		GBUFFER_TEXTURE_TYPE_POSITION,
+		GBUFFER_TEXTURE_TYPE_NORMAL,
+		GBUFFER_TEXTURE_TYPE_DIFFUSE,
+		GBUFFER_TEXTURE_TYPE_SPECULAR,
+		GBUFFER_NUM_TEXTURES
+	};
+
+private:
+	GLuint fbo;
+	GLuint textures[GBUFFER_NUM_TEXTURES];
+	GLuint depthTexture;
+	GLuint output; // where the light pass draws, 0 - the window
+
+public:
+	GBuffer()
+	{
+		fbo = 0;
+		depthTexture = 0;
+		output = 0;
+		for (unsigned int i = 0; i < GBUFFER_NUM_TEXTURES; i++) textures[i] = 0;
+	}
+
+	~GBuffer()
+	{
+		if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+		GLStateCache::Get().DeleteTextures(GBUFFER_NUM_TEXTURES, textures);
+		if (depthTexture != 0) GLStateCache::Get().DeleteTextures(1, &depthTexture);
+	}
+
+	bool Init(unsigned int Width, unsigned int Height)
+	{
+		// position needs the full float range, the rest is fine with less
+		const GLint InternalFormats[GBUFFER_NUM_TEXTURES] = { GL_RGB32F, GL_RGB16F, GL_RGBA8, GL_RG16F };
+		const GLenum Formats[GBUFFER_NUM_TEXTURES] = { GL_RGB, GL_RGB, GL_RGBA, GL_RG };
+
+		GLint Previous = 0; // the caller's framebuffer, bound again at the end
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &Previous);
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+
+		glGenTextures(GBUFFER_NUM_TEXTURES, textures);
+		glGenTextures(1, &depthTexture);
+
+		for (unsigned int i = 0; i < GBUFFER_NUM_TEXTURES; i++)
+		{
+			GLStateCache::Get().BindTexture(GL_TEXTURE_2D, textures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, InternalFormats[i], Width, Height, 0, Formats[i], GL_FLOAT, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures[i], 0);
+		}
+
+		GLStateCache::Get().BindTexture(GL_TEXTURE_2D, depthTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, Width, Height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+		const GLenum DrawBuffers[GBUFFER_NUM_TEXTURES] =
+			{ GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+		glDrawBuffers(GBUFFER_NUM_TEXTURES, DrawBuffers);
+
+		GLenum Status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)Previous);
+		GLStateCache::Get().BindTexture(GL_TEXTURE_2D, 0);
+
+		if (Status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cerr << "G-buffer framebuffer error, status: 0x" << std::hex << Status << std::dec << "\n";
+			return false;
+		}
+		return true;
+	}
+
+	void BindForGeometryPass()
+	{
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+	}
+
+	void SetOutput(GLuint Framebuffer)
+	{
+		output = Framebuffer;
+	}
+
+	// draws into the output framebuffer and exposes the G-buffer at GBUFFER_*_UNIT
+	void BindForLightPass()
+	{
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output);
+
+		for (unsigned int i = 0; i < GBUFFER_NUM_TEXTURES; i++)
+		{
+			GLStateCache::Get().BindTexture(GL_TEXTURE0 + GBUFFER_POSITION_UNIT + i, GL_TEXTURE_2D, textures[i]);
+		}
+		GLStateCache::Get().ActiveTexture(GL_TEXTURE0);
+	}
+};
+
+// position-only mesh drawn as a light volume; sets its attributes on the default vertex
+// array, which it binds itself because the meshes leave theirs bound
+struct LightVolume
+{
+	GLuint VBO;
+	GLuint IBO;
+	GLsizei IndexCount;
+
+	LightVolume()
+	{
+		VBO = 0;
+		IBO = 0;
+		IndexCount = 0;
+	}
+
+	~LightVolume()
+	{
+		if (VBO != 0) glDeleteBuffers(1, &VBO);
+		if (IBO != 0) glDeleteBuffers(1, &IBO);
+	}
+
+	void Create(const std::vector<glm::vec3>& Vertices, const std::vector<GLuint>& Indices)
+	{
+		GLStateCache::Get().BindVertexArray(0);
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(glm::vec3), Vertices.data(), GL_STATIC_DRAW);
+
+		glGenBuffers(1, &IBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(GLuint), Indices.data(), GL_STATIC_DRAW);
+
+		IndexCount = (GLsizei)Indices.size();
+	}
+
+	void Draw()
+	{
+		GLStateCache::Get().BindVertexArray(0);
+		glEnableVertexAttribArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+		glDrawElements(GL_TRIANGLES, IndexCount, GL_UNSIGNED_INT, 0);
+		Profiler::Get().Count(PROFILE_DRAW_CALLS);
+		glDisableVertexAttribArray(0);
+	}
+};
+
+class GeometryPassTechnique : public Technique
+{
+private:
+	GLuint gWorldLocation;
+	GLuint gWVPLocation;
+	GLuint gViewProjLocation; // instanced mode only
+	GLuint gSamplerLocation;
+	bool instanced;
+	GLuint matSpecularIntensityLocation;
+	GLuint matSpecularPowerLocation;
+
+public:
+	// Instanced: world matrices come from the instance buffer instead of gWorld/gWVP
+	GeometryPassTechnique(bool Instanced = false)
+	{
+		instanced = Instanced;
+		gWorldLocation = gWVPLocation = gViewProjLocation = 0;
+	}
+
+	virtual bool Init() override
+	{
+		if (!Technique::Init()) return false;
+		if (!createShaders(instanced ? vertexInstanced : vertex, geometryPassFragment)) return false;
+
+		if (instanced)
+		{
+			gViewProjLocation = GetUniformLocation("gViewProj");
+		}
+		else
+		{
+			gWorldLocation = GetUniformLocation("gWorld");
+			gWVPLocation = GetUniformLocation("gWVP");
+		}
+		gSamplerLocation = GetUniformLocation("gSampler");
+		matSpecularIntensityLocation = GetUniformLocation("gMatSpecularIntensity");
+		matSpecularPowerLocation = GetUniformLocation("gSpecularPower");
+
+		return true;
+	}
+
+	void SetWorld(glm::mat4* value)
+	{
+		glUniformMatrix4fv(gWorldLocation, 1, GL_TRUE, (const GLfloat*)value);
+	}
+
+	void SetWVP(glm::mat4* value)
+	{
+		glUniformMatrix4fv(gWVPLocation, 1, GL_TRUE, (const GLfloat*)value);
+	}
+
+	void SetViewProj(const glm::mat4* value)
+	{
+		glUniformMatrix4fv(gViewProjLocation, 1, GL_TRUE, (const GLfloat*)value);
+	}
+
+	void SetTextureUnit(unsigned int TextureUnit)
+	{
+		glUniform1i(gSamplerLocation, TextureUnit);
+	}
+
+	void SetMatSpecularIntensity(float Intensity)
+	{
+		glUniform1f(matSpecularIntensityLocation, Intensity);
+	}
+
+	void SetMatSpecularPower(float Power)
+	{
+		glUniform1f(matSpecularPowerLocation, Power);
+	}
+};
+
+// common part of the three light pass techniques, the derived
+// classes only supply the main() and set their own light
+class DeferredLightPassTechnique : public Technique
+{
+private:
+	const char* mainPart;
+	GLuint gWVPLocation;
+	GLuint screenSizeLocation;
+	GLuint eyeWorldPosition;
+
+protected:
+	// locations of the members of a BaseLight/PointLight uniform named pName
+	struct PointLightLocation
+	{
+		GLuint Color;
+		GLuint AmbientIntensity;
+		GLuint DiffuseIntensity;
+		GLuint Position;
+		GLuint Constant;
+		GLuint Linear;
+		GLuint Exp;
+	};
+
+	void GetPointLightLocation(const char* pName, PointLightLocation& Location)
+	{
+		char Name[128];
+		snprintf(Name, sizeof(Name), "%s.Base.Color", pName);
+		Location.Color = GetUniformLocation(Name);
+		snprintf(Name, sizeof(Name), "%s.Base.AmbientIntensity", pName);
+		Location.AmbientIntensity = GetUniformLocation(Name);
+		snprintf(Name, sizeof(Name), "%s.Base.DiffuseIntensity", pName);
+		Location.DiffuseIntensity = GetUniformLocation(Name);
+		snprintf(Name, sizeof(Name), "%s.Position", pName);
+		Location.Position = GetUniformLocation(Name);
+		snprintf(Name, sizeof(Name), "%s.Atten.Constant", pName);
+		Location.Constant = GetUniformLocation(Name);
+		snprintf(Name, sizeof(Name), "%s.Atten.Linear", pName);
+		Location.Linear = GetUniformLocation(Name);
+		snprintf(Name, sizeof(Name), "%s.Atten.Exp", pName);
+		Location.Exp = GetUniformLocation(Name);
+	}
+
+	static void SetPointLight(const PointLightLocation& Location, const PointLight& Light)
+	{
+		glUniform3f(Location.Color, Light.Color.x, Light.Color.y, Light.Color.z);
+		glUniform1f(Location.AmbientIntensity, Light.AmbientIntensity);
+		glUniform1f(Location.DiffuseIntensity, Light.DiffuseIntensity);
+		glUniform3f(Location.Position, Light.Position.x, Light.Position.y, Light.Position.z);
+		glUniform1f(Location.Constant, Light.Attenuation.Constant);
+		glUniform1f(Location.Linear, Light.Attenuation.Linear);
+		glUniform1f(Location.Exp, Light.Attenuation.Exp);
+	}
+
+public:
+	DeferredLightPassTechnique(const char* MainPart)
+	{
+		mainPart = MainPart;
+	}
+
+	virtual bool Init() override
+	{
+		if (!Technique::Init()) return false;
+		const char* FragmentParts[] = { lightPassHeader, lightingCommon, mainPart };
+		if (!createShaders(&lightPassVertex, 1, FragmentParts, 3)) return false;
+
+		gWVPLocation = GetUniformLocation("gWVP");
+		screenSizeLocation = GetUniformLocation("gScreenSize");
+		eyeWorldPosition = GetUniformLocation("gEyeWorldPos");
+
+		Enable();
+		glUniform1i(GetUniformLocation("gPositionMap"), GBUFFER_POSITION_UNIT);
+		glUniform1i(GetUniformLocation("gNormalMap"), GBUFFER_NORMAL_UNIT);
+		glUniform1i(GetUniformLocation("gDiffuseMap"), GBUFFER_DIFFUSE_UNIT);
+		glUniform1i(GetUniformLocation("gSpecularMap"), GBUFFER_SPECULAR_UNIT);
+
+		return true;
+	}
+
+	void SetWVP(const glm::mat4* value)
+	{
+		glUniformMatrix4fv(gWVPLocation, 1, GL_TRUE, (const GLfloat*)value);
+	}
+
+	void SetScreenSize(float Width, float Height)
+	{
+		glUniform2f(screenSizeLocation, Width, Height);
+	}
+
+	void SetEyeWorldPos(const glm::vec3& EyeWorldPos)
+	{
+		glUniform3f(eyeWorldPosition, EyeWorldPos.x, EyeWorldPos.y, EyeWorldPos.z);
+	}
+};
+
+class DeferredDirLightPassTechnique : public DeferredLightPassTechnique
+{
+private:
+	GLuint dirLightColor;
+	GLuint dirLightAmbientIntensity;
+	GLuint dirLightDirection;
+	GLuint dirLightDiffuseIntensity;
+
+public:
+	DeferredDirLightPassTechnique() : DeferredLightPassTechnique(dirLightPassFragment) { }
+
+	virtual bool Init() override
+	{
+		if (!DeferredLightPassTechnique::Init()) return false;
+
+		dirLightColor = GetUniformLocation("gDirectionalLight.Base.Color");
+		dirLightAmbientIntensity = GetUniformLocation("gDirectionalLight.Base.AmbientIntensity");
+		dirLightDirection = GetUniformLocation("gDirectionalLight.Direction");
+		dirLightDiffuseIntensity = GetUniformLocation("gDirectionalLight.Base.DiffuseIntensity");
+
+		return true;
+	}
+
+	void SetDirectionalLight(const DirectionalLight& Light)
+	{
+		glUniform3f(dirLightColor, Light.Color.x, Light.Color.y, Light.Color.z);
+		glUniform1f(dirLightAmbientIntensity, Light.AmbientIntensity);
+		glUniform3f(dirLightDirection, Light.Direction.x, Light.Direction.y, Light.Direction.z);
+		glUniform1f(dirLightDiffuseIntensity, Light.DiffuseIntensity);
+	}
+};
+
+class DeferredPointLightPassTechnique : public DeferredLightPassTechnique
+{
+private:
+	PointLightLocation pointLightLocation;
+
+public:
+	DeferredPointLightPassTechnique() : DeferredLightPassTechnique(pointLightPassFragment) { }
+
+	virtual bool Init() override
+	{
+		if (!DeferredLightPassTechnique::Init()) return false;
+		GetPointLightLocation("gPointLight", pointLightLocation);
+		return true;
+	}
+
+	void SetPointLight(const PointLight& Light)
+	{
+		DeferredLightPassTechnique::SetPointLight(pointLightLocation, Light);
+	}
+};
+
+class DeferredSpotLightPassTechnique : public DeferredLightPassTechnique
+{
+private:
+	PointLightLocation pointLightLocation;
+	GLuint directionLocation;
+	GLuint cutoffLocation;
+
+public:
+	DeferredSpotLightPassTechnique() : DeferredLightPassTechnique(spotLightPassFragment) { }
+
+	virtual bool Init() override
+	{
+		if (!DeferredLightPassTechnique::Init()) return false;
+		GetPointLightLocation("gSpotLight.Base", pointLightLocation);
+		directionLocation = GetUniformLocation("gSpotLight.Direction");
+		cutoffLocation = GetUniformLocation("gSpotLight.Cutoff");
+		return true;
+	}
+
+	void SetSpotLight(const SpotLight& Light)
+	{
+		DeferredLightPassTechnique::SetPointLight(pointLightLocation, Light);
+		glUniform3f(directionLocation, Light.Direction.x, Light.Direction.y, Light.Direction.z);
+		glUniform1f(cutoffLocation, cosf(glm::radians(Light.Cutoff)));
+	}
+};
+
+class DeferredRenderer
+{
+private:
+	GBuffer gbuffer;
+	GeometryPassTechnique geometryPass;
+	GeometryPassTechnique geometryPassInstanced;
+	DeferredDirLightPassTechnique dirLightPass;
+	DeferredPointLightPassTechnique pointLightPass;
+	DeferredSpotLightPassTechnique spotLightPass;
+
+	LightVolume sphere;
+	LightVolume cone;
+	LightVolume quad;
+	float sphereScale; // the tessellated sphere is inside the unit sphere, this scales it to enclose it
+	float coneScale;
+
+	float screenWidth;
+	float screenHeight;
+
+	static const unsigned int SPHERE_RINGS = 12;
+	static const unsigned int SPHERE_SECTORS = 16;
+	static const unsigned int CONE_SEGMENTS = 16;
+
+public:
+	DeferredRenderer() : geometryPassInstanced(true)
+	{
+		sphereScale = 1.0f;
+		coneScale = 1.0f;
+		screenWidth = 0.0f;
+		screenHeight = 0.0f;
+	}
+
+	bool Init(unsigned int Width, unsigned int Height)
+	{
+		screenWidth = (float)Width;
+		screenHeight = (float)Height;
+
+		if (!gbuffer.Init(Width, Height)) return false;
+		if (!geometryPass.Init()) return false;
+		if (!geometryPassInstanced.Init()) return false;
+		if (!dirLightPass.Init()) return false;
+		if (!pointLightPass.Init()) return false;
+		if (!spotLightPass.Init()) return false;
+
+		CreateSphere();
+		CreateCone();
+		CreateQuad();
+
+		return true;
+	}
+
+	// the framebuffer the lights are accumulated into, the window by default
+	void SetOutputFramebuffer(GLuint Framebuffer)
+	{
+		gbuffer.SetOutput(Framebuffer);
+	}
+
+	// binds the G-buffer and returns the technique to set the per-object uniforms on,
+	// the instanced one reads the world matrices from an InstanceBuffer
+	GeometryPassTechnique* BeginGeometryPass(bool Instanced = false)
+	{
+		gbuffer.BindForGeometryPass();
+		glDepthMask(GL_TRUE);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glEnable(GL_DEPTH_TEST);
+
+		GeometryPassTechnique* pPass = Instanced ? &geometryPassInstanced : &geometryPass;
+		pPass->Enable();
+		return pPass;
+	}
+
+	// accumulates all lights into the output framebuffer
+	void LightPass(Pipeline& p, const glm::vec3& EyeWorldPos, const DirectionalLight& DirLight,
+		unsigned int NumPointLights, const PointLight* pPointLights,
+		unsigned int NumSpotLights, const SpotLight* pSpotLights)
+	{
+		gbuffer.BindForLightPass();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// the light volumes are not depth tested, every light adds onto the frame
+		glDisable(GL_DEPTH_TEST);
+		glDepthMask(GL_FALSE);
+		glEnable(GL_BLEND);
+		glBlendEquation(GL_FUNC_ADD);
+		glBlendFunc(GL_ONE, GL_ONE);
+
+		glm::mat4 Identity(1.0f);
+		const glm::mat4& ViewProj = p.GetViewProjTrans();
+
+		dirLightPass.Enable();
+		dirLightPass.SetScreenSize(screenWidth, screenHeight);
+		dirLightPass.SetEyeWorldPos(EyeWorldPos);
+		dirLightPass.SetWVP(&Identity);
+		dirLightPass.SetDirectionalLight(DirLight);
+		quad.Draw();
+
+		// back faces only: they still cover the pixels when the camera is inside the volume;
+		// the volumes are clockwise on screen from outside, the front faces under GL_CW
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_FRONT);
+
+		pointLightPass.Enable();
+		pointLightPass.SetScreenSize(screenWidth, screenHeight);
+		pointLightPass.SetEyeWorldPos(EyeWorldPos);
+		for (unsigned int i = 0; i < NumPointLights; i++)
+		{
+			float Radius = CalcPointLightRadius(pPointLights[i]);
+			if (Radius == 0.0f) continue;
+
+			pointLightPass.SetPointLight(pPointLights[i]);
+			DrawPointVolume(pPointLights[i].Position, Radius, ViewProj, pointLightPass);
+		}
+
+		spotLightPass.Enable();
+		spotLightPass.SetScreenSize(screenWidth, screenHeight);
+		spotLightPass.SetEyeWorldPos(EyeWorldPos);
+		for (unsigned int i = 0; i < NumSpotLights; i++)
+		{
+			const SpotLight& Light = pSpotLights[i];
+			float Radius = CalcPointLightRadius(Light);
+			if (Radius == 0.0f) continue;
+
+			spotLightPass.SetSpotLight(Light);
+
+			// a cone only bounds cutoffs below 90 degrees, wider lights use the sphere
+			float DirLength = glm::length(Light.Direction);
+			if (Radius == FLT_MAX || Light.Cutoff >= 89.0f || DirLength < 1e-6f)
+			{
+				DrawPointVolume(Light.Position, Radius, ViewProj, spotLightPass);
+				continue;
+			}
+
+			glm::vec3 Z = Light.Direction / DirLength;
+			glm::vec3 Up = fabsf(Z.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+			glm::vec3 X = glm::normalize(glm::cross(Up, Z));
+			glm::vec3 Y = glm::cross(Z, X);
+			float BaseRadius = Radius * tanf(glm::radians(Light.Cutoff)) * coneScale;
+
+			glm::mat4 WVP = VolumeTransform(Light.Position, X * BaseRadius, Y * BaseRadius, Z * Radius) * ViewProj;
+			spotLightPass.SetWVP(&WVP);
+			cone.Draw();
+		}
+
+		glCullFace(GL_BACK);
+		glDisable(GL_CULL_FACE);
+		glDisable(GL_BLEND);
+		glDepthMask(GL_TRUE);
+		glEnable(GL_DEPTH_TEST);
+	}
+
+private:
+	void DrawPointVolume(const glm::vec3& Position, float Radius, const glm::mat4& ViewProj, DeferredLightPassTechnique& Pass)
+	{
+		if (Radius == FLT_MAX)
+		{
+			// unattenuated light reaches every pixel
+			glm::mat4 Identity(1.0f);
+			Pass.SetWVP(&Identity);
+			glDisable(GL_CULL_FACE);
+			quad.Draw();
+			glEnable(GL_CULL_FACE);
+			return;
+		}
+
+		float r = Radius * sphereScale;
+		glm::mat4 WVP = VolumeTransform(Position, glm::vec3(r, 0.0f, 0.0f), glm::vec3(0.0f, r, 0.0f), glm::vec3(0.0f, 0.0f, r)) * ViewProj;
+		Pass.SetWVP(&WVP);
+		sphere.Draw();
+	}
+
+	// world matrix with the given (scaled) axes, stored row by row like the rest of Pipeline
+	static glm::mat4 VolumeTransform(const glm::vec3& Position, const glm::vec3& X, const glm::vec3& Y, const glm::vec3& Z)
+	{
+		glm::mat4 m;
+
+		m[0][0] = X.x;  m[0][1] = Y.x;  m[0][2] = Z.x;  m[0][3] = Position.x;
+		m[1][0] = X.y;  m[1][1] = Y.y;  m[1][2] = Z.y;  m[1][3] = Position.y;
+		m[2][0] = X.z;  m[2][1] = Y.z;  m[2][2] = Z.z;  m[2][3] = Position.z;
+		m[3][0] = 0.0f; m[3][1] = 0.0f; m[3][2] = 0.0f; m[3][3] = 1.0f;
+
+		return m;
+	}
+
+	// Unit UV sphere. The outside faces are counter-clockwise in its own right-handed
+	// coordinates, but the left-handed view of Pipeline mirrors them, so on screen they are
+	// clockwise: front faces under the glFrontFace(GL_CW) the program sets. LightPass
+	// culls GL_FRONT to draw the inside of the volume and depends on this winding
+	void CreateSphere()
+	{
+		std::vector<glm::vec3> Vertices;
+		std::vector<GLuint> Indices;
+		const float Pi = 3.14159265f;
+
+		for (unsigned int r = 0; r <= SPHERE_RINGS; r++)
+		{
+			float Theta = Pi * r / SPHERE_RINGS;
+			for (unsigned int s = 0; s <= SPHERE_SECTORS; s++)
+			{
+				float Phi = 2.0f * Pi * s / SPHERE_SECTORS;
+				Vertices.push_back(glm::vec3(sinf(Theta) * cosf(Phi), cosf(Theta), sinf(Theta) * sinf(Phi)));
+			}
+		}
+
+		for (unsigned int r = 0; r < SPHERE_RINGS; r++)
+		{
+			for (unsigned int s = 0; s < SPHERE_SECTORS; s++)
+			{
+				GLuint a = r * (SPHERE_SECTORS + 1) + s;
+				GLuint b = a + SPHERE_SECTORS + 1;
+
+				// the triangles touching the poles degenerate to lines, skip them
+				if (r != 0) Indices.insert(Indices.end(), { a, a + 1, b });
+				if (r != SPHERE_RINGS - 1) Indices.insert(Indices.end(), { a + 1, b + 1, b });
+			}
+		}
+
+		sphere.Create(Vertices, Indices);
+		sphereScale = 1.0f / (cosf(Pi / (2.0f * SPHERE_RINGS)) * cosf(Pi / SPHERE_SECTORS));
+	}
+
+	// cone with the apex in the origin and a unit base at z = 1, wound as the sphere
+	void CreateCone()
+	{
+		std::vector<glm::vec3> Vertices;
+		std::vector<GLuint> Indices;
+		const float Pi = 3.14159265f;
+
+		Vertices.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
+		Vertices.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+		for (unsigned int i = 0; i < CONE_SEGMENTS; i++)
+		{
+			float Angle = 2.0f * Pi * i / CONE_SEGMENTS;
+			Vertices.push_back(glm::vec3(cosf(Angle), sinf(Angle), 1.0f));
+		}
+
+		for (GLuint i = 0; i < CONE_SEGMENTS; i++)
+		{
+			GLuint b0 = 2 + i;
+			GLuint b1 = 2 + (i + 1) % CONE_SEGMENTS;
+			Indices.insert(Indices.end(), { 0, b1, b0 });
+			Indices.insert(Indices.end(), { 1, b0, b1 });
+		}
+
+		cone.Create(Vertices, Indices);
+		coneScale = 1.0f / cosf(Pi / CONE_SEGMENTS);
+	}
+
+	void CreateQuad()
+	{
+		std::vector<glm::vec3> Vertices =
+		{
+			glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f),
+			glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(-1.0f, 1.0f, 0.0f)
+		};
+		std::vector<GLuint> Indices = { 0, 1, 2, 0, 2, 3 };
+
+		quad.Create(Vertices, Indices);
+	}
+};
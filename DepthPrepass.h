@@ -0,0 +1,155 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include "Technique.h"
+#include "ShadowMapping.h"
+#include "Profiler.h"
+
+// Position-only versions of vertex and vertexInstanced (LightingTechnique.h). gl_Position is
+// computed by the same expression from the same inputs and declared invariant in both, so the
+// main pass can test against the pre-pass depth with GL_EQUAL.
+static const char* depthVertex = R"(
+	#version 330 core
+
+	layout (location = 0) in vec3 Position;
+
+	uniform mat4 gWVP;
+
+	invariant gl_Position;
+
+	void main()
+	{
+		gl_Position = gWVP * vec4(Position, 1.0);
+	})";
+
+static const char* depthVertexInstanced = R"(
+	#version 330 core
+
+	layout (location = 0) in vec3 Position;
+	layout (location = 3) in mat4 InstanceWorld;
+
+	uniform mat4 gViewProj;
+
+	invariant gl_Position;
+
+	void main()
+	{
+		vec4 WorldPos = vec4(Position, 1.0) * InstanceWorld;
+		gl_Position = gViewProj * WorldPos;
+	})";
+
+// Depth pre-pass: fills the depth buffer with the nearest surface, after which the lighting
+// pass runs with GL_EQUAL and depth writes off and shades every pixel once. Has the setters
+// of LightingTechnique that the draw loop calls, so both passes draw the same list.
+class DepthPrepassTechnique : public Technique
+{
+private:
+	GLuint gWVPLocation;
+	GLuint gViewProjLocation; // instanced mode only
+	bool instanced;
+
+public:
+	DepthPrepassTechnique(bool Instanced = false)
+	{
+		instanced = Instanced;
+		gWVPLocation = gViewProjLocation = 0;
+	}
+
+	virtual bool Init() override
+	{
+		if (!Technique::Init()) return false;
+		if (!createShaders(instanced ? depthVertexInstanced : depthVertex, shadowFragment)) return false;
+
+		if (instanced) gViewProjLocation = GetUniformLocation("gViewProj");
+		else gWVPLocation = GetUniformLocation("gWVP");
+		return true;
+	}
+
+	void SetWVP(glm::mat4* value)
+	{
+		glUniformMatrix4fv(gWVPLocation, 1, GL_TRUE, (const GLfloat*)value);
+	}
+
+	// the position needs only gWVP
+	void SetWorld(glm::mat4*)
+	{
+	}
+
+	void SetViewProj(const glm::mat4* value)
+	{
+		glUniformMatrix4fv(gViewProjLocation, 1, GL_TRUE, (const GLfloat*)value);
+	}
+};
+
+const unsigned int FRAGMENT_COUNTER_LATENCY = 4; // frames between a query and reading its result
+
+// Samples that pass the depth test between Begin and End (GL_SAMPLES_PASSED), i.e. how many
+// fragments the lighting shader ran for. Results are read FRAGMENT_COUNTER_LATENCY frames
+// later so the GL thread never waits for them, and added to PROFILE_SHADED_FRAGMENTS.
+class FragmentCounter
+{
+private:
+	GLuint queries[FRAGMENT_COUNTER_LATENCY];
+	bool issued[FRAGMENT_COUNTER_LATENCY];
+	unsigned int next;
+	bool active;
+	GLuint last;
+
+public:
+	FragmentCounter()
+	{
+		for (unsigned int i = 0; i < FRAGMENT_COUNTER_LATENCY; i++)
+		{
+			queries[i] = 0;
+			issued[i] = false;
+		}
+		next = 0;
+		active = false;
+		last = 0;
+	}
+
+	~FragmentCounter()
+	{
+		if (queries[0] != 0) glDeleteQueries(FRAGMENT_COUNTER_LATENCY, queries);
+	}
+
+	bool Init()
+	{
+		glGenQueries(FRAGMENT_COUNTER_LATENCY, queries);
+		return queries[0] != 0;
+	}
+
+	void Begin()
+	{
+		if (issued[next])
+		{
+			// still not ready after FRAGMENT_COUNTER_LATENCY frames: this frame is not counted
+			GLint Available = 0;
+			glGetQueryObjectiv(queries[next], GL_QUERY_RESULT_AVAILABLE, &Available);
+			if (!Available) return;
+
+			glGetQueryObjectuiv(queries[next], GL_QUERY_RESULT, &last);
+			Profiler::Get().Count(PROFILE_SHADED_FRAGMENTS, last);
+			issued[next] = false;
+		}
+		glBeginQuery(GL_SAMPLES_PASSED, queries[next]);
+		active = true;
+	}
+
+	void End()
+	{
+		if (!active) return;
+		glEndQuery(GL_SAMPLES_PASSED);
+		issued[next] = true;
+		next = (next + 1) % FRAGMENT_COUNTER_LATENCY;
+		active = false;
+	}
+
+	// of the newest frame whose result has arrived
+	GLuint GetLast() const
+	{
+		return last;
+	}
+};
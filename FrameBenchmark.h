@@ -0,0 +1,181 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "Main.h"
+#include "Profiler.h"
+
+const float FRAME_BENCHMARK_STEP = 1.0f / 60.0f; // simulation seconds per benchmark frame
+
+// A key pressed before frame Frame of the run, the same keys the window reacts to
+struct FrameBenchmarkStep
+{
+	unsigned int Frame;
+	unsigned char Key;
+};
+
+struct FrameBenchmarkResult
+{
+	unsigned int Frames;
+	double Min, Average, P50, P90, P99, Max; // frame time in milliseconds
+	double DrawCalls; // per frame
+	double UniformCalls;
+	double ShadedFragments; // fragments the lighting pass shaded, see FragmentCounter
+	double StateChanges; // binds issued through GLStateCache
+	double RedundantState; // binds it skipped
+};
+
+// Every mode in turn, each for a sixth of the run: forward, the crowd of ~100 000
+// pyramids, instanced, texture arrays, clustered and deferred lighting.
+inline std::vector<FrameBenchmarkStep> DefaultFrameBenchmarkScript(unsigned int Frames)
+{
+	const unsigned char Keys[5] = { 'n', 'i', 't', 'c', 'g' };
+	std::vector<FrameBenchmarkStep> Script;
+	for (unsigned int i = 0; i < 5; i++)
+	{
+		FrameBenchmarkStep Step = { Frames * (i + 1) / 6, Keys[i] };
+		Script.push_back(Step);
+	}
+	return Script;
+}
+
+// Renders Frames frames of Script and measures each one up to glFinish, so the GPU
+// time is included. Background loading is finished first and the scene advances one
+// fixed step per frame, which makes two runs draw exactly the same frames.
+inline FrameBenchmarkResult RunFrameBenchmark(Main& Program, unsigned int Frames, const std::vector<FrameBenchmarkStep>& Script)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int MaxWarmupFrames = 1000;
+
+	Profiler::CountUniformCalls();
+	for (unsigned int i = 0; i < MaxWarmupFrames && Program.IsLoading(); i++) Program.RenderFrame();
+	glFinish();
+
+	ICallbacks& Callbacks = Program; // the key handler is the window's
+	std::vector<double> Times;
+	double DrawCalls = 0.0, UniformCalls = 0.0, ShadedFragments = 0.0, StateChanges = 0.0, RedundantState = 0.0;
+	size_t Next = 0;
+	for (unsigned int Frame = 0; Frame < Frames; Frame++)
+	{
+		for (; Next < Script.size() && Script[Next].Frame <= Frame; Next++) Callbacks.KeyboardCB(Script[Next].Key, 0, 0);
+
+		Callbacks.TickCB(FRAME_BENCHMARK_STEP);
+		Clock::time_point Start = Clock::now();
+		Program.RenderFrame();
+		glFinish();
+		Times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - Start).count());
+
+		DrawCalls += (double)Profiler::Get().GetFrameCounter(PROFILE_DRAW_CALLS);
+		UniformCalls += (double)Profiler::Get().GetFrameCounter(PROFILE_UNIFORM_CALLS);
+		ShadedFragments += (double)Profiler::Get().GetFrameCounter(PROFILE_SHADED_FRAGMENTS);
+		StateChanges += (double)Profiler::Get().GetFrameCounter(PROFILE_STATE_CHANGES);
+		RedundantState += (double)Profiler::Get().GetFrameCounter(PROFILE_REDUNDANT_STATE);
+	}
+
+	FrameBenchmarkResult Result;
+	memset(&Result, 0, sizeof(Result));
+	Result.Frames = Frames;
+	if (Frames == 0) return Result;
+
+	double Sum = 0.0;
+	for (double t : Times) Sum += t;
+	std::sort(Times.begin(), Times.end());
+	Result.Min = Times.front();
+	Result.Average = Sum / Frames;
+	Result.P50 = Times[std::min<size_t>(Frames - 1, (size_t)(Frames * 0.50))];
+	Result.P90 = Times[std::min<size_t>(Frames - 1, (size_t)(Frames * 0.90))];
+	Result.P99 = Times[std::min<size_t>(Frames - 1, (size_t)(Frames * 0.99))];
+	Result.Max = Times.back();
+	Result.DrawCalls = DrawCalls / Frames;
+	Result.UniformCalls = UniformCalls / Frames;
+	Result.ShadedFragments = ShadedFragments / Frames;
+	Result.StateChanges = StateChanges / Frames;
+	Result.RedundantState = RedundantState / Frames;
+	return Result;
+}
+
+inline std::string FrameBenchmarkToJson(const FrameBenchmarkResult& Result)
+{
+	std::ostringstream Out;
+	Out << "{\n"
+		<< "  \"frames\": " << Result.Frames << ",\n"
+		<< "  \"frame_ms_min\": " << Result.Min << ",\n"
+		<< "  \"frame_ms_avg\": " << Result.Average << ",\n"
+		<< "  \"frame_ms_p50\": " << Result.P50 << ",\n"
+		<< "  \"frame_ms_p90\": " << Result.P90 << ",\n"
+		<< "  \"frame_ms_p99\": " << Result.P99 << ",\n"
+		<< "  \"frame_ms_max\": " << Result.Max << ",\n"
+		<< "  \"draw_calls_per_frame\": " << Result.DrawCalls << ",\n"
+		<< "  \"uniform_calls_per_frame\": " << Result.UniformCalls << ",\n"
+		<< "  \"shaded_fragments_per_frame\": " << Result.ShadedFragments << ",\n"
+		<< "  \"state_changes_per_frame\": " << Result.StateChanges << ",\n"
+		<< "  \"redundant_state_skipped_per_frame\": " << Result.RedundantState << "\n"
+		<< "}\n";
+	return Out.str();
+}
+
+// the number after "Key": in the flat JSON written above
+inline bool ReadFrameBenchmarkValue(const std::string& Json, const char* pKey, double& Value)
+{
+	size_t Pos = Json.find(std::string("\"") + pKey + "\"");
+	if (Pos == std::string::npos) return false;
+	Pos = Json.find(':', Pos);
+	if (Pos == std::string::npos) return false;
+	Value = strtod(Json.c_str() + Pos + 1, nullptr);
+	return true;
+}
+
+// Compares against a result file of an earlier run. Frame times may be up to
+// Tolerance percent slower (p50 and p99); the call counts do not depend on the
+// machine and must not grow at all. Prints every regression, false if there is one.
+inline bool CheckFrameBenchmark(const FrameBenchmarkResult& Result, const std::string& BaselineFile, double Tolerance)
+{
+	std::ifstream File(BaselineFile);
+	if (!File)
+	{
+		std::cerr << "Error reading the benchmark baseline '" << BaselineFile << "'\n";
+		return false;
+	}
+	std::stringstream Text;
+	Text << File.rdbuf();
+	std::string Json = Text.str();
+
+	struct Check
+	{
+		const char* pKey;
+		double Value;
+		double Tolerance; // percent
+	};
+	const Check Checks[4] =
+	{
+		{ "frame_ms_p50", Result.P50, Tolerance },
+		{ "frame_ms_p99", Result.P99, Tolerance },
+		{ "draw_calls_per_frame", Result.DrawCalls, 0.0 },
+		{ "uniform_calls_per_frame", Result.UniformCalls, 0.0 },
+	};
+
+	bool Passed = true;
+	for (const Check& c : Checks)
+	{
+		double Baseline;
+		if (!ReadFrameBenchmarkValue(Json, c.pKey, Baseline)) continue;
+
+		double Limit = Baseline * (1.0 + c.Tolerance / 100.0) + 1e-6;
+		if (c.Value > Limit)
+		{
+			std::cerr << "Regression: " << c.pKey << " " << c.Value << ", baseline " << Baseline << " (limit " << Limit << ")\n";
+			Passed = false;
+		}
+	}
+	return Passed;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <cmath>
+
+// The six clip planes of a view-projection matrix in world space, normals point inside.
+struct Frustum
+{
+	glm::vec4 Planes[6]; // xyz - normal, w - distance
+
+	// ViewProj is stored row by row like the Pipeline matrices, the planes are
+	// the sums and differences of its last row with the other three
+	void FromViewProj(const glm::mat4& ViewProj)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			for (int s = 0; s < 2; s++)
+			{
+				float Sign = s == 0 ? 1.0f : -1.0f;
+				glm::vec4 Plane(ViewProj[3][0] + Sign * ViewProj[i][0],
+								ViewProj[3][1] + Sign * ViewProj[i][1],
+								ViewProj[3][2] + Sign * ViewProj[i][2],
+								ViewProj[3][3] + Sign * ViewProj[i][3]);
+
+				float Length = sqrtf(Plane.x * Plane.x + Plane.y * Plane.y + Plane.z * Plane.z);
+				Planes[i * 2 + s] = Length > 0.0f ? Plane / Length : Plane;
+			}
+		}
+	}
+
+	bool SphereVisible(const glm::vec3& Center, float Radius) const
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			if (Planes[i].x * Center.x + Planes[i].y * Center.y + Planes[i].z * Center.z + Planes[i].w < -Radius) return false;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,169 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include "Profiler.h"
+
+// Shadow copy of the GL binding state that changes per draw: the program, the vertex
+// array and the textures of every unit. The methods mirror the GL calls and skip the
+// ones that would set what is already set, so the draw loop can bind everything a draw
+// needs without asking whether the previous draw left it bound.
+//  - only correct while every bind goes through it, including the ones while creating
+//    and uploading objects; deleting goes through it too, because GL unbinds a deleted
+//    name and glGen* may hand the name out again
+//  - Invalidate forgets everything, for GL calls made behind its back (GLUT, tools)
+//  - PROFILE_STATE_CHANGES counts the calls issued, PROFILE_REDUNDANT_STATE the skipped
+const unsigned int GL_STATE_TEXTURE_UNITS = 16;
+
+class GLStateCache
+{
+private:
+	static const GLuint UNKNOWN = 0xffffffff;
+
+	// targets the renderer binds, any other goes straight to GL
+	enum TARGET { TARGET_2D, TARGET_2D_ARRAY, TARGET_BUFFER, TARGET_COUNT };
+
+	GLuint program;
+	GLuint vertexArray;
+	GLenum activeUnit; // GL_TEXTURE0 + i, 0 if unknown
+	GLuint textures[GL_STATE_TEXTURE_UNITS][TARGET_COUNT];
+
+	GLStateCache()
+	{
+		Invalidate();
+	}
+
+public:
+	static GLStateCache& Get()
+	{
+		static GLStateCache Instance;
+		return Instance;
+	}
+
+	void Invalidate()
+	{
+		program = vertexArray = UNKNOWN;
+		activeUnit = 0;
+		for (unsigned int i = 0; i < GL_STATE_TEXTURE_UNITS; i++)
+		{
+			for (unsigned int t = 0; t < TARGET_COUNT; t++) textures[i][t] = UNKNOWN;
+		}
+	}
+
+	void UseProgram(GLuint Program)
+	{
+		if (!Changed(program, Program)) return;
+		glUseProgram(Program);
+	}
+
+	void BindVertexArray(GLuint VertexArray)
+	{
+		if (!Changed(vertexArray, VertexArray)) return;
+		glBindVertexArray(VertexArray);
+	}
+
+	// Unit is GL_TEXTURE0 + i, as for glActiveTexture
+	void ActiveTexture(GLenum Unit)
+	{
+		if (activeUnit == Unit)
+		{
+			Profiler::Get().Count(PROFILE_REDUNDANT_STATE);
+			return;
+		}
+		activeUnit = Unit;
+		glActiveTexture(Unit);
+		Profiler::Get().Count(PROFILE_STATE_CHANGES);
+	}
+
+	// to the active unit, as glBindTexture
+	void BindTexture(GLenum Target, GLuint Texture)
+	{
+		int t = GetTarget(Target);
+		unsigned int i = activeUnit - GL_TEXTURE0;
+		if (t >= 0 && i < GL_STATE_TEXTURE_UNITS)
+		{
+			if (!Changed(textures[i][t], Texture)) return;
+		}
+		else
+		{
+			// the unit is not known, so no unit is known to hold its texture any more
+			if (t >= 0 && activeUnit == 0) ForgetTarget(t);
+			Profiler::Get().Count(PROFILE_STATE_CHANGES);
+		}
+		glBindTexture(Target, Texture);
+	}
+
+	// Unit is GL_TEXTURE0 + i; leaves Unit active, unless nothing had to change
+	void BindTexture(GLenum Unit, GLenum Target, GLuint Texture)
+	{
+		int t = GetTarget(Target);
+		unsigned int i = Unit - GL_TEXTURE0;
+		if (t >= 0 && i < GL_STATE_TEXTURE_UNITS && textures[i][t] == Texture)
+		{
+			Profiler::Get().Count(PROFILE_REDUNDANT_STATE);
+			return;
+		}
+		ActiveTexture(Unit);
+		BindTexture(Target, Texture);
+	}
+
+	void DeleteTextures(GLsizei Count, const GLuint* pTextures)
+	{
+		for (GLsizei n = 0; n < Count; n++)
+		{
+			if (pTextures[n] == 0) continue;
+			for (unsigned int i = 0; i < GL_STATE_TEXTURE_UNITS; i++)
+			{
+				for (unsigned int t = 0; t < TARGET_COUNT; t++)
+				{
+					if (textures[i][t] == pTextures[n]) textures[i][t] = 0;
+				}
+			}
+		}
+		glDeleteTextures(Count, pTextures);
+	}
+
+	void DeleteVertexArray(GLuint VertexArray)
+	{
+		if (vertexArray == VertexArray) vertexArray = 0;
+		glDeleteVertexArrays(1, &VertexArray);
+	}
+
+	// a program in use is deleted only once another one is used, until then its name is
+	// still taken; forgetting it makes the next UseProgram of any program go to GL
+	void DeleteProgram(GLuint Program)
+	{
+		if (program == Program) program = UNKNOWN;
+		glDeleteProgram(Program);
+	}
+
+private:
+	// stores the new value and counts the call as issued or skipped
+	static bool Changed(GLuint& Current, GLuint Value)
+	{
+		if (Current == Value)
+		{
+			Profiler::Get().Count(PROFILE_REDUNDANT_STATE);
+			return false;
+		}
+		Current = Value;
+		Profiler::Get().Count(PROFILE_STATE_CHANGES);
+		return true;
+	}
+
+	static int GetTarget(GLenum Target)
+	{
+		switch (Target)
+		{
+		case GL_TEXTURE_2D: return TARGET_2D;
+		case GL_TEXTURE_2D_ARRAY: return TARGET_2D_ARRAY;
+		case GL_TEXTURE_BUFFER: return TARGET_BUFFER;
+		}
+		return -1;
+	}
+
+	void ForgetTarget(int Target)
+	{
+		for (unsigned int i = 0; i < GL_STATE_TEXTURE_UNITS; i++) textures[i][Target] = UNKNOWN;
+	}
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+
+// A GL context without a window, for benchmarks on machines without a display or GPU
+// (Mesa llvmpipe). Everything is drawn into an offscreen framebuffer of the given size.
+//  - HEADLESS_OSMESA defined: an OSMesa context, rendered on the CPU
+//  - otherwise on Linux: EGL on the surfaceless platform (EGL_MESA_platform_surfaceless),
+//    or the default display if it is missing
+//  - on Windows, which has neither: a hidden GLUT window
+#if defined(HEADLESS_OSMESA)
+#include <GL/osmesa.h>
+#elif !defined(_WIN32)
+#define EGL_NO_X11 // no Xlib macros (Status, Success, None) in the files included after this one
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#if defined(HEADLESS_OSMESA)
+static OSMesaContext headlessContext = nullptr;
+static std::vector<unsigned char> headlessPixels; // OSMesa needs a buffer, the FBO is drawn instead
+#elif !defined(_WIN32)
+static EGLDisplay headlessDisplay = EGL_NO_DISPLAY;
+static EGLContext headlessContext = EGL_NO_CONTEXT;
+#endif
+static GLuint headlessFramebuffer = 0;
+static GLuint headlessRenderbuffers[2] = { 0, 0 }; // color, depth
+
+static bool HeadlessCreateContext(int argc, char** argv, unsigned int Width, unsigned int Height)
+{
+#if defined(HEADLESS_OSMESA)
+	const int Attribs[] = { OSMESA_FORMAT, OSMESA_RGBA, OSMESA_DEPTH_BITS, 24, OSMESA_PROFILE, OSMESA_COMPAT_PROFILE, 0 };
+	headlessContext = OSMesaCreateContextAttribs(Attribs, nullptr);
+	if (headlessContext == nullptr)
+	{
+		std::cerr << "Error: OSMesa context was not created\n";
+		return false;
+	}
+	headlessPixels.resize((size_t)Width * Height * 4);
+	if (!OSMesaMakeCurrent(headlessContext, headlessPixels.data(), GL_UNSIGNED_BYTE, Width, Height))
+	{
+		std::cerr << "Error: OSMesa context can not be made current\n";
+		return false;
+	}
+	return true;
+#elif !defined(_WIN32)
+	PFNEGLGETPLATFORMDISPLAYEXTPROC GetPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (GetPlatformDisplay != nullptr) headlessDisplay = GetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (headlessDisplay == EGL_NO_DISPLAY) headlessDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint Major = 0, Minor = 0;
+	if (headlessDisplay == EGL_NO_DISPLAY || !eglInitialize(headlessDisplay, &Major, &Minor))
+	{
+		std::cerr << "Error: no EGL display\n";
+		return false;
+	}
+
+	const EGLint ConfigAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig Config;
+	EGLint NumConfigs = 0;
+	if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(headlessDisplay, ConfigAttribs, &Config, 1, &NumConfigs) || NumConfigs == 0)
+	{
+		std::cerr << "Error: EGL has no desktop OpenGL config\n";
+		return false;
+	}
+
+	// the default (compatibility) context, the same the GLUT window gets
+	headlessContext = eglCreateContext(headlessDisplay, Config, EGL_NO_CONTEXT, nullptr);
+	if (headlessContext == EGL_NO_CONTEXT || !eglMakeCurrent(headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, headlessContext))
+	{
+		std::cerr << "Error: EGL context without a surface was not created, error 0x" << std::hex << eglGetError() << std::dec << "\n";
+		return false;
+	}
+	return true;
+#else
+	glutInit(&argc, argv);
+	glutInitDisplayMode(GLUT_RGBA);
+	glutInitWindowSize(1, 1);
+	glutCreateWindow("lr3 benchmark");
+	glutHideWindow();
+	return true;
+#endif
+}
+
+// creates the context and binds a Width x Height framebuffer; GLEW is initialized
+bool HeadlessBackendInit(int argc, char** argv, unsigned int Width, unsigned int Height)
+{
+	if (!HeadlessCreateContext(argc, argv, Width, Height)) return false;
+
+	// glewInit would also look for GLX/WGL, which a context without a window may not have
+	glewExperimental = GL_TRUE;
+#ifdef _WIN32
+	GLenum res = glewInit();
+#else
+	GLenum res = glewContextInit();
+#endif
+	if (res != GLEW_OK)
+	{
+		std::cerr << "Error: " << glewGetErrorString(res) << "\n";
+		return false;
+	}
+
+	glGenFramebuffers(1, &headlessFramebuffer);
+	glGenRenderbuffers(2, headlessRenderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, headlessRenderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, Width, Height);
+	glBindRenderbuffer(GL_RENDERBUFFER, headlessRenderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, Width, Height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, headlessFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headlessRenderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headlessRenderbuffers[1]);
+	GLenum Status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (Status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Offscreen framebuffer error, status: 0x" << std::hex << Status << std::dec << "\n";
+		return false;
+	}
+	glViewport(0, 0, Width, Height);
+	return true;
+}
+
+GLuint HeadlessBackendGetFramebuffer()
+{
+	return headlessFramebuffer;
+}
+
+void HeadlessBackendShutdown()
+{
+	if (headlessFramebuffer != 0) glDeleteFramebuffers(1, &headlessFramebuffer);
+	glDeleteRenderbuffers(2, headlessRenderbuffers);
+	headlessFramebuffer = 0;
+
+#if defined(HEADLESS_OSMESA)
+	OSMesaDestroyContext(headlessContext);
+	headlessContext = nullptr;
+#elif !defined(_WIN32)
+	eglMakeCurrent(headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(headlessDisplay, headlessContext);
+	eglTerminate(headlessDisplay);
+	headlessContext = EGL_NO_CONTEXT;
+	headlessDisplay = EGL_NO_DISPLAY;
+#endif
+}
@@ -8,8 +8,8 @@
 class ICallbacks
 {
 public:
-	virtual void RenderSceneCB() = 0;
-	virtual void IdleCB() = 0;
+	virtual void TickCB(float Step) = 0; // fixed simulation step, in seconds
+	virtual void RenderSceneCB(float Interpolation) = 0; // Interpolation - part of the next step already elapsed, 0..1
 	virtual void KeyboardCB(unsigned char key, int x, int y) = 0;
 };
 
@@ -0,0 +1,119 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <algorithm>
+#include "LightingTechnique.h"
+
+// Per-instance world matrices for glDrawElementsInstanced. The matrices are fed to
+// the mat4 attribute at INSTANCE_WORLD_LOCATION (4 vec4 attributes, one per row,
+// divisor 1), vertexInstanced reads them through gl_InstanceID implicitly.
+// Optionally a texture array layer per instance goes to INSTANCE_LAYER_LOCATION.
+class InstanceBuffer
+{
+private:
+	GLuint buffer;
+	unsigned int capacity; // matrices the buffer storage holds
+	unsigned int count;
+	GLuint layerBuffer;
+	unsigned int layerCapacity;
+	bool hasLayers; // UploadLayers was called since the last Upload
+
+public:
+	InstanceBuffer()
+	{
+		buffer = 0;
+		capacity = 0;
+		count = 0;
+		layerBuffer = 0;
+		layerCapacity = 0;
+		hasLayers = false;
+	}
+
+	~InstanceBuffer()
+	{
+		if (buffer != 0)
+		{
+			glDeleteBuffers(1, &buffer);
+			buffer = 0;
+		}
+		if (layerBuffer != 0)
+		{
+			glDeleteBuffers(1, &layerBuffer);
+			layerBuffer = 0;
+		}
+	}
+
+	bool Init()
+	{
+		glGenBuffers(1, &buffer);
+		glGenBuffers(1, &layerBuffer);
+		return buffer != 0 && layerBuffer != 0;
+	}
+
+	// replaces the contents, the old storage is orphaned so the driver
+	// does not wait for draws of the previous frame that still read it
+	void Upload(const glm::mat4* pWorld, unsigned int Count)
+	{
+		count = Count;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+		if (Count > capacity)
+		{
+			capacity = std::max(Count, capacity + capacity / 2);
+		}
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+		if (Count > 0) glBufferSubData(GL_ARRAY_BUFFER, 0, Count * sizeof(glm::mat4), pWorld);
+		hasLayers = false;
+	}
+
+	// one layer per matrix of the last Upload, for techniques with a texture array
+	void UploadLayers(const float* pLayers)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, layerBuffer);
+		if (count > layerCapacity)
+		{
+			layerCapacity = std::max(count, layerCapacity + layerCapacity / 2);
+		}
+		glBufferData(GL_ARRAY_BUFFER, layerCapacity * sizeof(float), nullptr, GL_STREAM_DRAW);
+		if (count > 0) glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(float), pLayers);
+		hasLayers = true;
+	}
+
+	unsigned int GetCount() const
+	{
+		return count;
+	}
+
+	// First - instance 0 of the next draw is matrix First of the buffer
+	void Bind(unsigned int First = 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		for (GLuint i = 0; i < 4; i++)
+		{
+			glEnableVertexAttribArray(INSTANCE_WORLD_LOCATION + i);
+			glVertexAttribPointer(INSTANCE_WORLD_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (const GLvoid*)(sizeof(glm::mat4) * First + sizeof(glm::vec4) * i));
+			glVertexAttribDivisor(INSTANCE_WORLD_LOCATION + i, 1);
+		}
+
+		if (hasLayers)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, layerBuffer);
+			glEnableVertexAttribArray(INSTANCE_LAYER_LOCATION);
+			glVertexAttribPointer(INSTANCE_LAYER_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(float), (const GLvoid*)(sizeof(float) * First));
+			glVertexAttribDivisor(INSTANCE_LAYER_LOCATION, 1);
+		}
+	}
+
+	void Unbind()
+	{
+		for (GLuint i = 0; i < 4; i++)
+		{
+			glVertexAttribDivisor(INSTANCE_WORLD_LOCATION + i, 0);
+			glDisableVertexAttribArray(INSTANCE_WORLD_LOCATION + i);
+		}
+		glVertexAttribDivisor(INSTANCE_LAYER_LOCATION, 0);
+		glDisableVertexAttribArray(INSTANCE_LAYER_LOCATION);
+	}
+};
@@ -0,0 +1,188 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+// Counts the jobs of one group that have not finished yet. A job started with
+// JobSystem::Run increments it, the end of the job decrements it; JobSystem::Wait
+// returns once it is back to zero.
+struct JobCounter
+{
+	std::atomic<int> Pending;
+
+	JobCounter() : Pending(0) {}
+	bool Done() const { return Pending.load(std::memory_order_acquire) == 0; }
+};
+
+// Work stealing job system: one queue per thread, a thread takes its newest job from
+// its own queue and, when that is empty, steals the oldest job of another thread.
+// Workers are started for all cores but one, the thread that waits for a counter
+// (the GLUT thread) runs jobs too, so all cores are busy while a frame is prepared.
+// Jobs may start jobs and wait for them, waiting never blocks a thread that could work.
+class JobSystem
+{
+public:
+	typedef std::function<void()> Job;
+	typedef std::function<void(unsigned int First, unsigned int Last)> RangeJob;
+
+private:
+	struct Queue
+	{
+		std::mutex Lock;
+		std::deque<std::pair<Job, JobCounter*> > Jobs;
+	};
+
+	std::vector<Queue*> queues; // 0 is shared by all threads that are not workers
+	std::vector<std::thread> workers;
+	std::atomic<int> queued;
+	std::atomic<bool> quit;
+	std::mutex sleepLock;
+	std::condition_variable wakeUp;
+
+public:
+	// NumWorkers = 0 starts one worker per core besides the calling thread
+	JobSystem(unsigned int NumWorkers = 0)
+	{
+		if (NumWorkers == 0)
+		{
+			unsigned int Cores = std::thread::hardware_concurrency();
+			NumWorkers = Cores > 1 ? Cores - 1 : 0;
+		}
+
+		queued = 0;
+		quit = false;
+		for (unsigned int i = 0; i <= NumWorkers; i++) queues.push_back(new Queue);
+
+		for (unsigned int i = 1; i <= NumWorkers; i++)
+		{
+			workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+		}
+	}
+
+	~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> Guard(sleepLock);
+			quit = true;
+		}
+		wakeUp.notify_all();
+		for (auto& Worker : workers) Worker.join();
+		for (Queue* q : queues) delete q;
+	}
+
+	// workers plus the thread that waits
+	unsigned int GetNumThreads() const
+	{
+		return (unsigned int)queues.size();
+	}
+
+	// queues Func on the queue of the calling thread
+	void Run(JobCounter& Counter, Job Func)
+	{
+		Counter.Pending.fetch_add(1, std::memory_order_relaxed);
+
+		Queue* q = queues[ThreadIndex(this)];
+		{
+			std::lock_guard<std::mutex> Guard(q->Lock);
+			q->Jobs.push_back(std::make_pair(std::move(Func), &Counter));
+		}
+		queued.fetch_add(1, std::memory_order_release);
+
+		if (!workers.empty())
+		{
+			std::lock_guard<std::mutex> Guard(sleepLock); // a worker about to sleep sees the job or the notify
+			wakeUp.notify_one();
+		}
+	}
+
+	// splits [0, Count) into ranges of at most Grain items and runs Func on each of them
+	void ParallelFor(JobCounter& Counter, unsigned int Count, unsigned int Grain, RangeJob Func)
+	{
+		Grain = std::max(Grain, 1u);
+		for (unsigned int First = 0; First < Count; First += Grain)
+		{
+			unsigned int Last = std::min(First + Grain, Count);
+			Run(Counter, [Func, First, Last]() { Func(First, Last); });
+		}
+	}
+
+	// runs jobs (of any group) until Counter drops to zero
+	void Wait(JobCounter& Counter)
+	{
+		unsigned int Self = ThreadIndex(this);
+		while (!Counter.Done())
+		{
+			if (!RunOne(Self)) std::this_thread::yield();
+		}
+	}
+
+private:
+	// index of the queue the calling thread pushes to and pops from
+	static unsigned int& ThreadIndex(const JobSystem* pOwner)
+	{
+		static thread_local const JobSystem* Owner = nullptr;
+		static thread_local unsigned int Index = 0;
+		if (Owner != pOwner)
+		{
+			Owner = pOwner;
+			Index = 0;
+		}
+		return Index;
+	}
+
+	bool Pop(unsigned int Index, bool Newest, std::pair<Job, JobCounter*>& Out)
+	{
+		Queue* q = queues[Index];
+		std::lock_guard<std::mutex> Guard(q->Lock);
+		if (q->Jobs.empty()) return false;
+
+		if (Newest)
+		{
+			Out = std::move(q->Jobs.back());
+			q->Jobs.pop_back();
+		}
+		else
+		{
+			Out = std::move(q->Jobs.front());
+			q->Jobs.pop_front();
+		}
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool RunOne(unsigned int Self)
+	{
+		std::pair<Job, JobCounter*> Next;
+		bool Found = Pop(Self, true, Next);
+
+		for (unsigned int i = 1; !Found && i < queues.size(); i++)
+		{
+			Found = Pop((Self + i) % queues.size(), false, Next);
+		}
+		if (!Found) return false;
+
+		Next.first();
+		Next.second->Pending.fetch_sub(1, std::memory_order_release);
+		return true;
+	}
+
+	void WorkerLoop(unsigned int Index)
+	{
+		ThreadIndex(this) = Index;
+
+		while (true)
+		{
+			if (RunOne(Index)) continue;
+
+			std::unique_lock<std::mutex> Guard(sleepLock);
+			wakeUp.wait(Guard, [this]() { return quit || queued.load(std::memory_order_acquire) > 0; });
+			if (quit) return;
+		}
+	}
+};
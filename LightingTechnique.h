@@ -4,11 +4,19 @@
 #include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
 #include <glm/glm.hpp>	//#include "math_3d.h" - vector
 #include <list>
+#include <cstddef>
+#include <cfloat>
+#include <algorithm>
 #include "Technique.h"
 #include "Pipeline.h"
+#include "Profiler.h"
 
 const int MAX_POINT_LIGHTS = 3;
 const int MAX_SPOT_LIGHTS = 2;
+const unsigned int MAX_SHADOW_CASCADES = 4;
+const GLuint SHADOW_MAP_UNIT = 4; //   G-  
+const GLuint SHADOW_ATLAS_UNIT = 5;
+const unsigned int MAX_SHADOW_POINT_SLICES = MAX_POINT_LIGHTS * 6; //     
 
 //     .
 static const char* vertex = R"(
@@ -25,27 +33,106 @@ static const char* vertex = R"(
 	out vec3 Normal0;
 	out vec3 WorldPos0;
 
+	#ifdef TEXTURE_ARRAY
+	uniform float gLayer;
+	flat out float Layer0;
+	#endif
+
+	invariant gl_Position; //   ,     (DepthPrepass.h)
+
 	void main()
 	{
 		gl_Position = gWVP * vec4(Position, 1.0);
 		TexCoord0 = TexCoord; 
 		Normal0 = (gWorld * vec4(Normal, 0.0)).xyz;
 		WorldPos0 = (gWorld * vec4(Position, 1.0)).xyz;
+	#ifdef TEXTURE_ARRAY
+		Layer0 = gLayer;
+	#endif
 	})";
 
-//  
-static const char* fragment = R"(
+//          :  
+//     ( INSTANCE_WORLD_LOCATION..+3,  1).
+//    ,   GLSL     
+static const char* vertexInstanced = R"(
+	#version 330 core
+
+	layout (location = 0) in vec3 Position;
+	layout (location = 1) in vec2 TexCoord;
+	layout (location = 2) in vec3 Normal;
+	layout (location = 3) in mat4 InstanceWorld;
+
+	uniform mat4 gViewProj;
+
+	out vec2 TexCoord0;
+	out vec3 Normal0;
+	out vec3 WorldPos0;
+
+	#ifdef TEXTURE_ARRAY
+	layout (location = 7) in float InstanceLayer;
+	flat out float Layer0;
+	#endif
+
+	invariant gl_Position;
+
+	void main()
+	{
+		vec4 WorldPos = vec4(Position, 1.0) * InstanceWorld;
+		gl_Position = gViewProj * WorldPos;
+		TexCoord0 = TexCoord;
+		Normal0 = (vec4(Normal, 0.0) * InstanceWorld).xyz;
+		WorldPos0 = WorldPos.xyz;
+	#ifdef TEXTURE_ARRAY
+		Layer0 = InstanceLayer;
+	#endif
+	})";
+
+const GLuint INSTANCE_WORLD_LOCATION = 3;
+const GLuint INSTANCE_LAYER_LOCATION = 7; //      (TEXTURE_ARRAY)
+
+//        ,
+//   lightingCommon
+static const char* fragmentHeader = R"(
 	#version 330                                                                        
 																						
-	const int MAX_POINT_LIGHTS = 3;
-	const int MAX_SPOT_LIGHTS = 2;                                                     
-																						
 	in vec2 TexCoord0;                                                                  
 	in vec3 Normal0;                                                                    
 	in vec3 WorldPos0;                                                                  
 																						
-	out vec4 FragColor;                                                                 
-																						
+	out vec4 FragColor;
+
+	//  TEXTURE_ARRAY  -  Layer0 ,    
+	//    ; TEXTURED 0 -   
+	#ifdef TEXTURE_ARRAY
+	uniform sampler2DArray gSampler;
+	flat in float Layer0;
+	vec4 SampleTexture(vec2 uv) { return texture(gSampler, vec3(uv, Layer0)); }
+	#else
+	uniform sampler2D gSampler;
+	vec4 SampleTexture(vec2 uv) { return texture(gSampler, uv); }
+	#endif
+	#ifndef TEXTURED
+	#define TEXTURED 1
+	#endif
+	#if TEXTURED
+	vec4 SampleDiffuse(vec2 uv) { return SampleTexture(uv); }
+	#else
+	vec4 SampleDiffuse(vec2 uv) { return vec4(1.0); }
+	#endif
+	uniform vec3 gEyeWorldPos;                                                                  
+	uniform float gMatSpecularIntensity;                                                        
+	uniform float gSpecularPower;
+)";
+
+//    :      .
+//      WorldPos0, gEyeWorldPos, gMatSpecularIntensity  gSpecularPower,
+//    ,      main()
+static const char* lightingCommon = R"(
+	// SPECULAR 0     (    )
+	#ifndef SPECULAR
+	#define SPECULAR 1
+	#endif
+
 	struct BaseLight                                                                    
 	{                                                                                   
 		vec3 Color;                                                                     
@@ -80,15 +167,6 @@ static const char* fragment = R"(
 		float Cutoff;                                                                           
 	};                                                                                         
 																								
-	uniform int gNumPointLights;                
-	uniform int gNumSpotLights;                                                
-	uniform DirectionalLight gDirectionalLight;                                                 
-	uniform PointLight gPointLights[MAX_POINT_LIGHTS];           
-	uniform SpotLight gSpotLights[MAX_SPOT_LIGHTS];                               
-	uniform sampler2D gSampler;                                                                 
-	uniform vec3 gEyeWorldPos;                                                                  
-	uniform float gMatSpecularIntensity;                                                        
-	uniform float gSpecularPower;                                                               
 			// 																					
 	vec4 CalcLightInternal(BaseLight Light, vec3 LightDirection, vec3 Normal)            
 	{                                                                                           
@@ -102,6 +180,7 @@ static const char* fragment = R"(
 		{                                                                
 			DiffuseColor = vec4(Light.Color, 1.0f) * Light.DiffuseIntensity * DiffuseFactor;    
 																								
+	#if SPECULAR
 			vec3 VertexToEye = normalize(gEyeWorldPos - WorldPos0);                             
 			vec3 LightReflect = normalize(reflect(LightDirection, Normal));                     
 			float SpecularFactor = dot(VertexToEye, LightReflect);                              
@@ -111,16 +190,12 @@ static const char* fragment = R"(
 				SpecularColor = vec4(Light.Color, 1.0f) *                                       
 								gMatSpecularIntensity * SpecularFactor;                         
 			}                                                                                   
+	#endif
 		}                                                                                       
 																								
 		return (AmbientColor + DiffuseColor + SpecularColor);                                   
 	}                                                                                           
 																								
-	vec4 CalcDirectionalLight(vec3 Normal)                                                      
-	{                                                                                           
-		return CalcLightInternal(gDirectionalLight.Base, gDirectionalLight.Direction, Normal); 
-	}                                                                                           
-																								
 	vec4 CalcPointLight(PointLight l, vec3 Normal)                                       
 	{                                                                                           
 		vec3 LightDirection = WorldPos0 - l.Position;                                           
@@ -149,24 +224,142 @@ static const char* fragment = R"(
 		 {                                                                                  
 			return vec4(0,0,0,0);                                                               
 	   	}                                                                                       
-	}                                                                                        
+	}
+)";
+
+//    SHADOWS:     CascadedShadowMap (ShadowMapping.h),
+//       ShadowAtlas (ShadowAtlas.h)
+static const char* shadowSampling = R"(
+	#ifdef SHADOWS
+	const int MAX_SHADOW_CASCADES = 4;
+
+	uniform sampler2DArrayShadow gShadowMap;
+	uniform mat4 gLightViewProj[MAX_SHADOW_CASCADES];
+	uniform int gNumCascades;
+	uniform int gShadowPcfRadius;
+
+	// 1 - , 0 -  ;   ( ) ,    ,
+	//   (2r+1)^2    ,     
+	float CalcShadow()
+	{
+		for (int i = 0; i < gNumCascades; i++)
+		{
+			vec3 p = (gLightViewProj[i] * vec4(WorldPos0, 1.0)).xyz * 0.5 + 0.5;
+			if (any(lessThan(p, vec3(0.0))) || any(greaterThan(p, vec3(1.0)))) continue;
+
+			vec2 Texel = 1.0 / vec2(textureSize(gShadowMap, 0).xy);
+			float Sum = 0.0;
+			for (int y = -gShadowPcfRadius; y <= gShadowPcfRadius; y++)
+			{
+				for (int x = -gShadowPcfRadius; x <= gShadowPcfRadius; x++)
+				{
+					Sum += texture(gShadowMap, vec4(p.xy + vec2(x, y) * Texel, float(i), p.z));
+				}
+			}
+			float Side = float(2 * gShadowPcfRadius + 1);
+			return Sum / (Side * Side);
+		}
+		return 1.0;
+	}
+
+	const int MAX_SHADOW_POINT_SLICES = 18;
+	const int MAX_SHADOW_SPOT_SLICES = 2;
+
+	uniform sampler2DShadow gShadowAtlas;
+	uniform mat4 gPointShadowMatrix[MAX_SHADOW_POINT_SLICES]; //  -> (u, v, ) 
+	uniform vec4 gPointShadowRect[MAX_SHADOW_POINT_SLICES]; //   ,  -  
+	uniform mat4 gSpotShadowMatrix[MAX_SHADOW_SPOT_SLICES];
+	uniform vec4 gSpotShadowRect[MAX_SHADOW_SPOT_SLICES];
+
+	//   (   ) - 
+	float SampleShadowAtlas(mat4 Matrix, vec4 Rect)
+	{
+		if (Rect.z <= Rect.x) return 1.0;
+		vec4 p = Matrix * vec4(WorldPos0, 1.0);
+		if (p.w <= 0.0) return 1.0;
+		vec3 uvz = p.xyz / p.w;
+		if (any(lessThan(uvz.xy, Rect.xy)) || any(greaterThan(uvz.xy, Rect.zw)) || uvz.z > 1.0) return 1.0;
+		return texture(gShadowAtlas, uvz);
+	}
+
+	//   -      : +X, -X, +Y, -Y, +Z, -Z
+	float CalcPointShadow(int Light, vec3 LightPosition)
+	{
+		vec3 d = WorldPos0 - LightPosition;
+		vec3 a = abs(d);
+		int Face = (a.x >= a.y && a.x >= a.z) ? (d.x >= 0.0 ? 0 : 1) : (a.y >= a.z ? (d.y >= 0.0 ? 2 : 3) : (d.z >= 0.0 ? 4 : 5));
+		return SampleShadowAtlas(gPointShadowMatrix[Light * 6 + Face], gPointShadowRect[Light * 6 + Face]);
+	}
+
+	float CalcSpotShadow(int Light)
+	{
+		return SampleShadowAtlas(gSpotShadowMatrix[Light], gSpotShadowRect[Light]);
+	}
+	#endif
+)";
+
+//  
+static const char* fragment = R"(
+	const int MAX_POINT_LIGHTS = 3;
+	const int MAX_SPOT_LIGHTS = 2;                                                     
+																						
+	// all light sources arrive in one std140 block, uploaded with a single glBufferSubData per frame
+	layout (std140) uniform Lights
+	{
+		int gNumPointLights;
+		int gNumSpotLights;
+		DirectionalLight gDirectionalLight;
+		PointLight gPointLights[MAX_POINT_LIGHTS];
+		SpotLight gSpotLights[MAX_SPOT_LIGHTS];
+	};
+
+	vec4 CalcDirectionalLight(vec3 Normal)                                                      
+	{                                                                                           
+		vec4 Color = CalcLightInternal(gDirectionalLight.Base, gDirectionalLight.Direction, Normal);
+	#ifdef SHADOWS
+		//      ,  
+		vec4 Ambient = vec4(gDirectionalLight.Base.Color, 1.0) * gDirectionalLight.Base.AmbientIntensity;
+		Color = Ambient + (Color - Ambient) * CalcShadow();
+	#endif
+		return Color;
+	}                                                                                           
 																								
 	void main()                                                                                 
 	{                                                                                           
 		vec3 Normal = normalize(Normal0);                                                       
 		vec4 TotalLight = CalcDirectionalLight(Normal);                                         
 																								
-		for (int i = 0 ; i < gNumPointLights ; i++) 
+	//  NUM_POINT_LIGHTS/NUM_SPOT_LIGHTS     ,  
+	#ifdef NUM_POINT_LIGHTS
+		const int NumPointLights = NUM_POINT_LIGHTS;
+	#else
+		int NumPointLights = gNumPointLights;
+	#endif
+	#ifdef NUM_SPOT_LIGHTS
+		const int NumSpotLights = NUM_SPOT_LIGHTS;
+	#else
+		int NumSpotLights = gNumSpotLights;
+	#endif
+
+		for (int i = 0 ; i < NumPointLights ; i++) 
 		{                                           
+		#ifdef SHADOWS
+			TotalLight += CalcPointLight(gPointLights[i], Normal) * CalcPointShadow(i, gPointLights[i].Position);
+		#else
 			TotalLight += CalcPointLight(gPointLights[i], Normal);                                            
+		#endif
 		}                                                                                       
 			
-		for (int i = 0 ; i < gNumSpotLights ; i++)
+		for (int i = 0 ; i < NumSpotLights ; i++)
 		{                                            
+		#ifdef SHADOWS
+				TotalLight += CalcSpotLight(gSpotLights[i], Normal) * CalcSpotShadow(i);
+		#else
 				TotalLight += CalcSpotLight(gSpotLights[i], Normal);                                
+		#endif
 		}       
 																					
-		FragColor = texture2D(gSampler, TexCoord0.xy) * TotalLight;
+		FragColor = SampleDiffuse(TexCoord0.xy) * TotalLight;
 
 	})";
 
@@ -222,133 +415,236 @@ struct SpotLight : public PointLight
 	}
 };
 
+// distance at which a point or spot light contributes less than 1/256 of its peak,
+// FLT_MAX when it is not attenuated at all
+inline float CalcPointLightRadius(const PointLight& Light)
+{
+	float MaxChannel = std::max(Light.Color.x, std::max(Light.Color.y, Light.Color.z));
+	float Intensity = MaxChannel * (Light.AmbientIntensity + Light.DiffuseIntensity) * 256.0f;
+	float C = Light.Attenuation.Constant - Intensity;
+	float L = Light.Attenuation.Linear;
+	float E = Light.Attenuation.Exp;
+
+	if (C >= 0.0f) return 0.0f;
+	if (E > 0.0f) return (-L + sqrtf(L * L - 4.0f * E * C)) / (2.0f * E);
+	if (L > 0.0f) return -C / L;
+	return FLT_MAX;
+}
+
+//   uniform-   
+const GLuint LIGHTS_UBO_BINDING = 0;
+
+// CPU-side mirror of the "Lights" uniform block, laid out by the std140 rules:
+// structs and arrays of structs start on a 16 byte boundary and are padded to a multiple of 16
+struct LightsBlock
+{
+	struct BaseData
+	{
+		glm::vec3 Color;
+		float AmbientIntensity;
+		float DiffuseIntensity;
+		float pad[3];
+	};
+
+	struct DirectionalData
+	{
+		BaseData Base;
+		glm::vec3 Direction;
+		float pad;
+	};
+
+	struct PointData
+	{
+		BaseData Base;
+		glm::vec3 Position;
+		float pad;
+		struct
+		{
+			float Constant;
+			float Linear;
+			float Exp;
+			float pad;
+		} Atten;
+	};
+
+	struct SpotData
+	{
+		PointData Base;
+		glm::vec3 Direction;
+		float Cutoff;
+	};
+
+	GLint NumPointLights;
+	GLint NumSpotLights;
+	GLint pad[2];
+	DirectionalData DirectionalLight;
+	PointData PointLights[MAX_POINT_LIGHTS];
+	SpotData SpotLights[MAX_SPOT_LIGHTS];
+};
+
+static_assert(sizeof(LightsBlock::DirectionalData) == 48, "std140 DirectionalLight must be 48 bytes");
+static_assert(sizeof(LightsBlock::PointData) == 64, "std140 PointLight must be 64 bytes");
+static_assert(sizeof(LightsBlock::SpotData) == 80, "std140 SpotLight must be 80 bytes");
+static_assert(offsetof(LightsBlock, PointLights) == 64, "std140 Lights block layout mismatch");
+
+//  LightingTechnique,   #define    uniform:
+//   -1 -    Lights   
+struct LightingPermutation
+{
+	bool Instanced;
+	bool TextureArray;
+	int NumPointLights; // -1  0..MAX_POINT_LIGHTS
+	int NumSpotLights; // -1  0..MAX_SPOT_LIGHTS
+	bool Specular;
+	bool Textured;
+	bool Shadows; //   , . shadowSampling
+
+	LightingPermutation(bool instanced = false, bool textureArray = false)
+	{
+		Instanced = instanced;
+		TextureArray = textureArray;
+		NumPointLights = NumSpotLights = -1;
+		Specular = true;
+		Textured = true;
+		Shadows = false;
+	}
+
+	//   
+	unsigned int GetKey() const
+	{
+		return (Instanced ? 1u : 0u) | (TextureArray ? 2u : 0u) | (Specular ? 4u : 0u) | (Textured ? 8u : 0u) |
+			((unsigned int)(NumPointLights + 1) << 4) | ((unsigned int)(NumSpotLights + 1) << 8) | (Shadows ? 1u << 12 : 0u);
+	}
+};
+
 class LightingTechnique : public Technique
 {
 private:
 	GLuint gWorldLocation; //             
 	GLuint gSamplerLocation;
 	GLuint gWVPLocation;
-
-	GLuint dirLightColor;
-	GLuint dirLightAmbientIntensity;
-	GLuint dirLightDirection;
-	GLuint dirLightDiffuseIntensity;
+	GLuint gViewProjLocation; //    
+	GLuint gLayerLocation; //       
+	LightingPermutation permutation;
 
 	GLuint eyeWorldPosition; //  
 	GLuint matSpecularIntensityLocation; //  
 	GLuint matSpecularPowerLocation; //   
 
-	GLuint numPointLightsLocation;
-	GLuint numSpotLightsLocation; //   
+	GLuint shadowMapLocation; //   
+	GLuint lightViewProjLocation;
+	GLuint numCascadesLocation;
+	GLuint shadowPcfRadiusLocation;
+	GLuint shadowAtlasLocation;
+	GLuint pointShadowMatrixLocation;
+	GLuint pointShadowRectLocation;
+	GLuint spotShadowMatrixLocation;
+	GLuint spotShadowRectLocation;
 
-	struct 
-	{
-        GLuint Color;
-        GLuint AmbientIntensity;
-        GLuint DiffuseIntensity;
-        GLuint Position;
-        struct 
-		{
-            GLuint Constant;
-            GLuint Linear;
-            GLuint Exp;
-        } Atten; 
-    } pointLightsLocation[MAX_POINT_LIGHTS];
-
-	struct {
-		GLuint Color;
-		GLuint AmbientIntensity;
-		GLuint DiffuseIntensity;
-		GLuint Position;
-		GLuint Direction;
-		GLuint Cutoff;
-		struct {
-			GLuint Constant;
-			GLuint Linear;
-			GLuint Exp;
-		} Atten;
-	} spotLightsLocation[MAX_SPOT_LIGHTS];
+	GLuint lightsUBO; //   LightsBlock,    LIGHTS_UBO_BINDING
+	LightsBlock lights; //     CPU
+	bool lightsDirty;
 
 public:
-	LightingTechnique() { }
-
-	virtual bool Init() override
+	// Instanced -      ,    gWorld/gWVP
+	// TextureArray -   TextureArray,   SetLayer   
+	LightingTechnique(bool Instanced = false, bool TextureArray = false) : LightingTechnique(LightingPermutation(Instanced, TextureArray))
 	{
-		if (!Technique::Init()) return false;
-		if (!createShaders(vertex, fragment)) return false;
-
-		gWorldLocation = GetUniformLocation("gWorld"); //             
-		gWVPLocation = GetUniformLocation("gWVP");
-		gSamplerLocation = GetUniformLocation("gSampler");
-
-		dirLightColor = GetUniformLocation("gDirectionalLight.Base.Color");
-		dirLightAmbientIntensity = GetUniformLocation("gDirectionalLight.Base.AmbientIntensity");
-		dirLightDirection = GetUniformLocation("gDirectionalLight.Direction");
-		dirLightDiffuseIntensity = GetUniformLocation("gDirectionalLight.Base.DiffuseIntensity");
-
-		eyeWorldPosition = GetUniformLocation("gEyeWorldPos");
-		matSpecularIntensityLocation = GetUniformLocation("gMatSpecularIntensity");
-		matSpecularPowerLocation = GetUniformLocation("gSpecularPower");
+	}
 
-		numPointLightsLocation = GetUniformLocation("gNumPointLights"); 
-		numSpotLightsLocation = GetUniformLocation("gNumSpotLights"); //   
+	LightingTechnique(const LightingPermutation& Permutation)
+	{
+		permutation = Permutation;
+		permutation.NumPointLights = std::min(permutation.NumPointLights, MAX_POINT_LIGHTS);
+		permutation.NumSpotLights = std::min(permutation.NumSpotLights, MAX_SPOT_LIGHTS);
+		gSamplerLocation = eyeWorldPosition = matSpecularIntensityLocation = matSpecularPowerLocation = 0xFFFFFFFF;
+		shadowMapLocation = lightViewProjLocation = numCascadesLocation = shadowPcfRadiusLocation = 0xFFFFFFFF;
+		shadowAtlasLocation = pointShadowMatrixLocation = pointShadowRectLocation = spotShadowMatrixLocation = spotShadowRectLocation = 0xFFFFFFFF;
+		gWorldLocation = gWVPLocation = gViewProjLocation = gLayerLocation = 0;
+		lightsUBO = 0;
+		memset(&lights, 0, sizeof(lights));
+		lightsDirty = true;
+	}
 
-		for (unsigned int i = 0; i < MAX_POINT_LIGHTS; i++) 
+	~LightingTechnique()
+	{
+		if (lightsUBO != 0)
 		{
-			char Name[128];
-			memset(Name, 0, sizeof(Name));
-			snprintf(Name, sizeof(Name), "gPointLights[%d].Base.Color", i);
-			pointLightsLocation[i].Color = GetUniformLocation(Name);
-
-			snprintf(Name, sizeof(Name), "gPointLights[%d].Base.AmbientIntensity", i);
-			pointLightsLocation[i].AmbientIntensity = GetUniformLocation(Name);
+			glDeleteBuffers(1, &lightsUBO);
+			lightsUBO = 0;
+		}
+	}
 
-			snprintf(Name, sizeof(Name), "gPointLights[%d].Position", i);
-			pointLightsLocation[i].Position = GetUniformLocation(Name);
+	virtual bool Init() override
+	{
+		return BeginInit() && FinishInit();
+	}
 
-			snprintf(Name, sizeof(Name), "gPointLights[%d].Base.DiffuseIntensity", i);
-			pointLightsLocation[i].DiffuseIntensity = GetUniformLocation(Name);
+	//  ,     (. Technique::beginShaders)
+	bool BeginInit()
+	{
+		if (!Technique::Init()) return false;
+		if (permutation.TextureArray) AddDefine("TEXTURE_ARRAY");
+		if (permutation.NumPointLights >= 0) AddDefine("NUM_POINT_LIGHTS", permutation.NumPointLights);
+		if (permutation.NumSpotLights >= 0) AddDefine("NUM_SPOT_LIGHTS", permutation.NumSpotLights);
+		if (!permutation.Specular) AddDefine("SPECULAR", 0);
+		if (!permutation.Textured) AddDefine("TEXTURED", 0);
+		if (permutation.Shadows) AddDefine("SHADOWS");
+
+		const char* FragmentParts[] = { fragmentHeader, lightingCommon, shadowSampling, fragment };
+		return beginShaders(permutation.Instanced ? &vertexInstanced : &vertex, 1, FragmentParts, 4);
+	}
 
-			snprintf(Name, sizeof(Name), "gPointLights[%d].Atten.Constant", i);
-			pointLightsLocation[i].Atten.Constant = GetUniformLocation(Name);
+	// FinishInit    
+	bool IsCompiled()
+	{
+		return isLinkComplete();
+	}
 
-			snprintf(Name, sizeof(Name), "gPointLights[%d].Atten.Linear", i);
-			pointLightsLocation[i].Atten.Linear = GetUniformLocation(Name);
+	bool FinishInit()
+	{
+		if (!finishShaders()) return false;
 
-			snprintf(Name, sizeof(Name), "gPointLights[%d].Atten.Exp", i);
-			pointLightsLocation[i].Atten.Exp = GetUniformLocation(Name);
+		if (permutation.Instanced)
+		{
+			gViewProjLocation = GetUniformLocation("gViewProj");
 		}
-		for (unsigned int i = 0; i < MAX_SPOT_LIGHTS; i++) 
+		else
 		{
-			char Name[128];
-			memset(Name, 0, sizeof(Name));
-			snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Base.Color", i);
-			spotLightsLocation[i].Color = GetUniformLocation(Name);
-
-			snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Base.AmbientIntensity", i);
-			spotLightsLocation[i].AmbientIntensity = GetUniformLocation(Name);
-
-			snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Position", i);
-			spotLightsLocation[i].Position = GetUniformLocation(Name);
-
-			snprintf(Name, sizeof(Name), "gSpotLights[%d].Direction", i);
-			spotLightsLocation[i].Direction = GetUniformLocation(Name);
-
-			snprintf(Name, sizeof(Name), "gSpotLights[%d].Cutoff", i);
-			spotLightsLocation[i].Cutoff = GetUniformLocation(Name);
+			gWorldLocation = GetUniformLocation("gWorld"); //             
+			gWVPLocation = GetUniformLocation("gWVP");
+			if (permutation.TextureArray) gLayerLocation = GetUniformLocation("gLayer");
+		}
+		//         uniform 
+		if (permutation.Textured) gSamplerLocation = GetUniformLocation("gSampler");
 
-			snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Base.DiffuseIntensity", i);
-			spotLightsLocation[i].DiffuseIntensity = GetUniformLocation(Name);
+		if (permutation.Specular)
+		{
+			eyeWorldPosition = GetUniformLocation("gEyeWorldPos");
+			matSpecularIntensityLocation = GetUniformLocation("gMatSpecularIntensity");
+			matSpecularPowerLocation = GetUniformLocation("gSpecularPower");
+		}
 
-			snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Atten.Constant", i);
-			spotLightsLocation[i].Atten.Constant = GetUniformLocation(Name);
+		if (permutation.Shadows)
+		{
+			shadowMapLocation = GetUniformLocation("gShadowMap");
+			lightViewProjLocation = GetUniformLocation("gLightViewProj");
+			numCascadesLocation = GetUniformLocation("gNumCascades");
+			shadowPcfRadiusLocation = GetUniformLocation("gShadowPcfRadius");
+			shadowAtlasLocation = GetUniformLocation("gShadowAtlas");
+			pointShadowMatrixLocation = GetUniformLocation("gPointShadowMatrix");
+			pointShadowRectLocation = GetUniformLocation("gPointShadowRect");
+			spotShadowMatrixLocation = GetUniformLocation("gSpotShadowMatrix");
+			spotShadowRectLocation = GetUniformLocation("gSpotShadowRect");
+		}
 
-			snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Atten.Linear", i);
-			spotLightsLocation[i].Atten.Linear = GetUniformLocation(Name);
+		if (!BindUniformBlock("Lights", LIGHTS_UBO_BINDING)) return false;
 
-			snprintf(Name, sizeof(Name), "gSpotLights[%d].Base.Atten.Exp", i);
-			spotLightsLocation[i].Atten.Exp = GetUniformLocation(Name);
-		}
+		glGenBuffers(1, &lightsUBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, lightsUBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(LightsBlock), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		lightsDirty = true;
 
 		return true;
 	}
@@ -363,19 +659,31 @@ public:
 		glUniformMatrix4fv(gWVPLocation, 1, GL_TRUE, (const GLfloat*)value);
 	}
 
+	void SetViewProj(const glm::mat4* value)
+	{
+		glUniformMatrix4fv(gViewProjLocation, 1, GL_TRUE, (const GLfloat*)value);
+	}
+
 	void SetTextureUnit(unsigned int TextureUnit)
 	{
 		glUniform1i(gSamplerLocation, TextureUnit);
 	}
 
+	const LightingPermutation& GetPermutation() const
+	{
+		return permutation;
+	}
+
+	void SetLayer(float Layer)
+	{
+		glUniform1f(gLayerLocation, Layer);
+	}
+
 	void SetDirectionalLight(DirectionalLight& Light)
 	{
-		glUniform3f(dirLightColor, Light.Color.x, Light.Color.y, Light.Color.z);
-		glUniform1f(dirLightAmbientIntensity, Light.AmbientIntensity);
-		glm::vec3 Direction = Light.Direction;
-		glm::normalize(Direction);
-		glUniform3f(dirLightDirection, Direction.x, Direction.y, Direction.z);
-		glUniform1f(dirLightDiffuseIntensity, Light.DiffuseIntensity);
+		PackBaseLight(lights.DirectionalLight.Base, Light);
+		lights.DirectionalLight.Direction = Light.Direction;
+		lightsDirty = true;
 	}
 
 	void SetMatSpecularIntensity(float Intensity)
@@ -393,39 +701,84 @@ public:
 		glUniform3f(eyeWorldPosition, EyeWorldPos.x, EyeWorldPos.y, EyeWorldPos.z);
 	}
 
+	//   ( -> NDC)   PCF;     SHADOW_MAP_UNIT.
+	//       
+	void SetShadowCascades(unsigned int NumCascades, const glm::mat4* pLightViewProj, int PcfRadius)
+	{
+		if (!permutation.Shadows) return;
+		if (NumCascades > MAX_SHADOW_CASCADES) NumCascades = MAX_SHADOW_CASCADES;
+
+		glUniform1i(shadowMapLocation, SHADOW_MAP_UNIT);
+		glUniform1i(numCascadesLocation, NumCascades);
+		glUniform1i(shadowPcfRadiusLocation, PcfRadius);
+		if (NumCascades > 0) glUniformMatrix4fv(lightViewProjLocation, NumCascades, GL_TRUE, (const GLfloat*)pLightViewProj);
+	}
+
+	//    ( 6 , . MAX_SHADOW_POINT_SLICES)  ;
+	//    SHADOW_ATLAS_UNIT,    -   
+	void SetLocalShadows(const glm::mat4* pPointMatrices, const glm::vec4* pPointRects, const glm::mat4* pSpotMatrices, const glm::vec4* pSpotRects)
+	{
+		if (!permutation.Shadows) return;
+
+		glUniform1i(shadowAtlasLocation, SHADOW_ATLAS_UNIT);
+		glUniformMatrix4fv(pointShadowMatrixLocation, MAX_SHADOW_POINT_SLICES, GL_TRUE, (const GLfloat*)pPointMatrices);
+		glUniform4fv(pointShadowRectLocation, MAX_SHADOW_POINT_SLICES, (const GLfloat*)pPointRects);
+		glUniformMatrix4fv(spotShadowMatrixLocation, MAX_SPOT_LIGHTS, GL_TRUE, (const GLfloat*)pSpotMatrices);
+		glUniform4fv(spotShadowRectLocation, MAX_SPOT_LIGHTS, (const GLfloat*)pSpotRects);
+	}
+
 	void SetPointLights(unsigned int NumLights, const PointLight* pLights)
 	{
-		glUniform1i(numPointLightsLocation, NumLights);
+		if (NumLights > MAX_POINT_LIGHTS) NumLights = MAX_POINT_LIGHTS;
+		lights.NumPointLights = NumLights;
 
-		for (unsigned int i = 0; i < NumLights; i++) {
-			glUniform3f(pointLightsLocation[i].Color, pLights[i].Color.x, pLights[i].Color.y, pLights[i].Color.z);
-			glUniform1f(pointLightsLocation[i].AmbientIntensity, pLights[i].AmbientIntensity);
-			glUniform1f(pointLightsLocation[i].DiffuseIntensity, pLights[i].DiffuseIntensity);
-			glUniform3f(pointLightsLocation[i].Position, pLights[i].Position.x, pLights[i].Position.y, pLights[i].Position.z);
-			glUniform1f(pointLightsLocation[i].Atten.Constant, pLights[i].Attenuation.Constant);
-			glUniform1f(pointLightsLocation[i].Atten.Linear, pLights[i].Attenuation.Linear);
-			glUniform1f(pointLightsLocation[i].Atten.Exp, pLights[i].Attenuation.Exp);
+		for (unsigned int i = 0; i < NumLights; i++)
+		{
+			PackPointLight(lights.PointLights[i], pLights[i]);
 		}
+		lightsDirty = true;
 	}
 
 	void SetSpotLights(unsigned int NumLights, const SpotLight* pLights) //      SpotLight
 	{
-		glUniform1i(numSpotLightsLocation, NumLights);
+		if (NumLights > MAX_SPOT_LIGHTS) NumLights = MAX_SPOT_LIGHTS;
+		lights.NumSpotLights = NumLights;
 
 		for (unsigned int i = 0; i < NumLights; i++)
 		{
-			glUniform3f(spotLightsLocation[i].Color, pLights[i].Color.x, pLights[i].Color.y, pLights[i].Color.z);
-			glUniform1f(spotLightsLocation[i].AmbientIntensity, pLights[i].AmbientIntensity);
-			glUniform1f(spotLightsLocation[i].DiffuseIntensity, pLights[i].DiffuseIntensity);
-			glUniform3f(spotLightsLocation[i].Position, pLights[i].Position.x, pLights[i].Position.y, pLights[i].Position.z);
-			glm::vec3 Direction = pLights[i].Direction;
-			glm::normalize(Direction);
-			glUniform3f(spotLightsLocation[i].Direction, Direction.x, Direction.y, Direction.z);
-			glUniform1f(spotLightsLocation[i].Cutoff, cosf(glm::radians(pLights[i].Cutoff)));
-			glUniform1f(spotLightsLocation[i].Atten.Constant, pLights[i].Attenuation.Constant);
-			glUniform1f(spotLightsLocation[i].Atten.Linear, pLights[i].Attenuation.Linear);
-			glUniform1f(spotLightsLocation[i].Atten.Exp, pLights[i].Attenuation.Exp);
+			PackPointLight(lights.SpotLights[i].Base, pLights[i]);
+			lights.SpotLights[i].Direction = pLights[i].Direction;
+			lights.SpotLights[i].Cutoff = cosf(glm::radians(pLights[i].Cutoff));
 		}
+		lightsDirty = true;
 	}
-};
 
+	// uploads everything set through SetDirectionalLight/SetPointLights/SetSpotLights
+	// in one call; must be called after the setters and before drawing
+	void CommitLights()
+	{
+		PROFILE_GPU_SCOPE("Uniforms.Lights");
+		glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTS_UBO_BINDING, lightsUBO);
+		if (!lightsDirty) return;
+
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightsBlock), &lights);
+		lightsDirty = false;
+	}
+
+private:
+	static void PackBaseLight(LightsBlock::BaseData& Dst, const BaseLight& Src)
+	{
+		Dst.Color = Src.Color;
+		Dst.AmbientIntensity = Src.AmbientIntensity;
+		Dst.DiffuseIntensity = Src.DiffuseIntensity;
+	}
+
+	static void PackPointLight(LightsBlock::PointData& Dst, const PointLight& Src)
+	{
+		PackBaseLight(Dst.Base, Src);
+		Dst.Position = Src.Position;
+		Dst.Atten.Constant = Src.Attenuation.Constant;
+		Dst.Atten.Linear = Src.Attenuation.Linear;
+		Dst.Atten.Exp = Src.Attenuation.Exp;
+	}
+};
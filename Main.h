@@ -4,38 +4,176 @@
 #include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
 #include <glm/glm.hpp>	//#include "math_3d.h" - vector
 #include <Magick++.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
 
 #include "Pipeline.h"
 #include "Texture.h"
+#include "TextureStreaming.h"
+#include "TextureCache.h"
+#include "TextureArray.h"
 #include "LightingTechnique.h"
+#include "ShaderPermutations.h"
+#include "ClusteredLighting.h"
+#include "DeferredShading.h"
+#include "ShadowMapping.h"
+#include "ShadowAtlas.h"
+#include "DepthPrepass.h"
+#include "RenderQueue.h"
+#include "GLStateCache.h"
+#include "BatchTransformBenchmark.h"
+#include "JobSystem.h"
+#include "Frustum.h"
+#include "Bvh.h"
+#include "Instancing.h"
+#include "MultiDrawIndirect.h"
+#include "Mesh.h"
+#include "MeshFile.h"
+#include "NormalGeneration.h"
+#include "NormalGenerationBenchmark.h"
+#include "Profiler.h"
 #include "ICallbacks.h"
 
 constexpr auto WINDOW_WIDTH = 1980;
 constexpr auto WINDOW_HEIGHT = 1250;
 
-struct Vertex
+//       
+struct FrameSchedulerSettings
 {
-	glm::vec3 m_pos;
-	glm::vec2 m_tex;
-	glm::vec3 m_normal;
+	float TickRate = 60.0f; //    ,     
+	float TargetFPS = 0.0f; // 0 -   (     VSync)
+	bool VSync = true; //     ,   -  
+	unsigned int MaxTicksPerFrame = 5; //        
+};
+
+//  :      ,  
+//        GLUT      
+// .         ,   .
+class FrameScheduler
+{
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	FrameSchedulerSettings settings;
+	Clock::time_point lastTime;
+	Clock::time_point nextFrame;
+	double accumulator; //  ,    
+	bool visible;
+	bool framePosted;
+
+public:
+	FrameScheduler()
+	{
+		accumulator = 0.0;
+		visible = true;
+		framePosted = false;
+	}
+
+	void Start(const FrameSchedulerSettings& Settings)
+	{
+		settings = Settings;
+		settings.TickRate = std::max(settings.TickRate, 1.0f);
+		lastTime = nextFrame = Clock::now();
+		accumulator = 0.0;
+	}
+
+	float GetStep() const
+	{
+		return 1.0f / settings.TickRate;
+	}
+
+	//  ,     , 0..1
+	float GetInterpolation() const
+	{
+		return (float)std::min(accumulator / GetStep(), 1.0);
+	}
 
-	Vertex(glm::vec3 pos, glm::vec2 tex)
+	void SetVisible(bool Visible)
 	{
-		m_pos = pos;
-		m_tex = tex;
-		m_normal = glm::vec3(0.0f, 0.0f, 0.0f);
+		visible = Visible;
+	}
+
+	//  ,    
+	void FrameDone()
+	{
+		framePosted = false;
+	}
+
+	//   GLUT:  ,  ,    
+	void Idle(ICallbacks* pCallbacks)
+	{
+		Clock::time_point Now = Clock::now();
+		accumulator += std::chrono::duration<double>(Now - lastTime).count();
+		lastTime = Now;
+
+		double Step = GetStep();
+		unsigned int Ticks = 0;
+		while (accumulator >= Step && Ticks < settings.MaxTicksPerFrame)
+		{
+			pCallbacks->TickCB((float)Step);
+			accumulator -= Step;
+			Ticks++;
+		}
+		if (Ticks == settings.MaxTicksPerFrame) accumulator = std::min(accumulator, Step); //  
+
+		bool FrameDue = visible && !framePosted && (settings.TargetFPS <= 0.0f || Now >= nextFrame);
+		if (FrameDue)
+		{
+			if (settings.TargetFPS > 0.0f)
+			{
+				Clock::duration Interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / settings.TargetFPS));
+				nextFrame += Interval;
+				if (nextFrame < Now) nextFrame = Now + Interval; //    
+			}
+			framePosted = true;
+			glutPostRedisplay(); //  GLUT,  ,     
+			return;
+		}
+
+		//     -      
+		Clock::time_point Wake = lastTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(Step - accumulator));
+		if (visible && !framePosted && settings.TargetFPS > 0.0f) Wake = std::min(Wake, nextFrame);
+		if (!visible) Wake = std::max(Wake, Now + std::chrono::milliseconds(50)); //      
+		if (Wake > Now) std::this_thread::sleep_until(Wake);
+	}
+
+	// VSync   ,   ;  glutGetProcAddress,
+	// wglew.h  glxew.h    windows.h  Xlib   
+	void ApplySwapInterval() const
+	{
+#ifdef _WIN32
+		typedef int (__stdcall* SwapIntervalProc)(int);
+		const char* Names[1] = { "wglSwapIntervalEXT" };
+#else
+		typedef int (*SwapIntervalProc)(int);
+		const char* Names[2] = { "glXSwapIntervalMESA", "glXSwapIntervalSGI" };
+#endif
+		for (const char* pName : Names)
+		{
+			SwapIntervalProc SwapInterval = (SwapIntervalProc)glutGetProcAddress(pName);
+			if (SwapInterval != nullptr)
+			{
+				SwapInterval(settings.VSync ? 1 : 0);
+				return;
+			}
+		}
 	}
 };
 
 static ICallbacks* callbacks = nullptr;
-static void aRenderSceneCB() { callbacks->RenderSceneCB(); }
-static void aIdleCB() { callbacks->IdleCB(); }
+static FrameScheduler scheduler;
+static void aRenderSceneCB() { scheduler.FrameDone(); callbacks->RenderSceneCB(scheduler.GetInterpolation()); }
+static void aIdleCB() { scheduler.Idle(callbacks); }
 static void aKeyboardCB(unsigned char key, int x, int y) { callbacks->KeyboardCB(key, x, y); }
+static void aWindowStatusCB(int state) { scheduler.SetVisible(state != GLUT_HIDDEN && state != GLUT_FULLY_COVERED); }
 static void InitCallbacks()
 {
 	glutDisplayFunc(aRenderSceneCB); //GLUT interacts with window system
 	glutIdleFunc(aIdleCB);
 	glutKeyboardFunc(aKeyboardCB);
+	glutWindowStatusFunc(aWindowStatusCB);
 }
 void GLUTBackendInit(int argc, char** argv)
 {
@@ -57,44 +195,243 @@ bool GLUTBackendCreateWindow(unsigned int Width, unsigned int Height, const char
 	}
 	return 1;
 }
-void GLUTBackendRun(ICallbacks* pCallbacks)
+//   GL      
+void InitRenderState()
 {
-	if (!pCallbacks)
-	{
-		std::cerr << __FUNCTION__ << " : callbacks are not specified!\n";
-		return;
-	}
-
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f); //setting the color of the window
 	// image quality improvement
 	glFrontFace(GL_CW);
 	glCullFace(GL_BACK);
 	//glEnable(GL_CULL_FACE);
 	glEnable(GL_DEPTH_TEST);
+}
+void GLUTBackendRun(ICallbacks* pCallbacks, const FrameSchedulerSettings& Settings = FrameSchedulerSettings())
+{
+	if (!pCallbacks)
+	{
+		std::cerr << __FUNCTION__ << " : callbacks are not specified!\n";
+		return;
+	}
+
+	InitRenderState();
 
 	callbacks = pCallbacks;
+	scheduler.Start(Settings);
+	scheduler.ApplySwapInterval();
 	InitCallbacks();
 	glutMainLoop(); //transferring control to GLUT, it's waiting for events in the window
 }
 
 
+//  ,    (  ,     BatchTransform)
+struct SceneObjects
+{
+	std::vector<float> ScaleX, ScaleY, ScaleZ;
+	std::vector<float> PosX, PosY, PosZ;
+	std::vector<float> RotateX, RotateY, RotateZ;
+	std::vector<float> RotateYBase; // RotateY = RotateYBase + Spin * 
+	std::vector<float> Spin;
+	std::vector<float> Layer; //   
+	std::vector<unsigned int> Version; //     
+	float Radius; //  ,     1
+
+	unsigned int Count() const
+	{
+		return (unsigned int)PosX.size();
+	}
+
+	void Clear()
+	{
+		Resize(0);
+	}
+
+	void Resize(unsigned int Count)
+	{
+		std::vector<float>* Arrays[] = { &ScaleX, &ScaleY, &ScaleZ, &PosX, &PosY, &PosZ, &RotateX, &RotateY, &RotateZ, &RotateYBase, &Spin, &Layer };
+		for (auto* a : Arrays) a->resize(Count);
+		Version.resize(Count);
+	}
+
+	// ,     
+	void GetBounds(unsigned int i, glm::vec3& Min, glm::vec3& Max) const
+	{
+		float r = Radius * std::max(ScaleX[i], std::max(ScaleY[i], ScaleZ[i]));
+		glm::vec3 Center(PosX[i], PosY[i], PosZ[i]);
+		Min = Center - glm::vec3(r);
+		Max = Center + glm::vec3(r);
+	}
+
+	void Add(const glm::vec3& Pos, float Scale, float Angle, float SpinSpeed, float TextureLayer = 0.0f)
+	{
+		ScaleX.push_back(Scale); ScaleY.push_back(Scale); ScaleZ.push_back(Scale);
+		PosX.push_back(Pos.x); PosY.push_back(Pos.y); PosZ.push_back(Pos.z);
+		RotateX.push_back(0.0f); RotateY.push_back(Angle); RotateZ.push_back(0.0f);
+		RotateYBase.push_back(Angle);
+		Spin.push_back(SpinSpeed);
+		Layer.push_back(TextureLayer);
+		Version.push_back(0);
+	}
+
+	//  From   pIndices[First..Last)   First..Last,    Time
+	void Gather(const SceneObjects& From, const unsigned int* pIndices, unsigned int First, unsigned int Last, float Time)
+	{
+		for (unsigned int i = First; i < Last; i++)
+		{
+			unsigned int o = pIndices[i];
+			ScaleX[i] = From.ScaleX[o]; ScaleY[i] = From.ScaleY[o]; ScaleZ[i] = From.ScaleZ[o];
+			PosX[i] = From.PosX[o]; PosY[i] = From.PosY[o]; PosZ[i] = From.PosZ[o];
+			RotateX[i] = From.RotateX[o];
+			RotateY[i] = From.RotateYBase[o] + From.Spin[o] * Time;
+			RotateZ[i] = From.RotateZ[o];
+			Layer[i] = From.Layer[o];
+		}
+	}
+
+	//  [First, Last)
+	TransformBatch Batch(unsigned int First, unsigned int Last) const
+	{
+		TransformBatch b = { &ScaleX[First], &ScaleY[First], &ScaleZ[First], &PosX[First], &PosY[First], &PosZ[First],
+			&RotateX[First], &RotateY[First], &RotateZ[First], Last - First };
+		return b;
+	}
+};
+
+// ,      ;  GLUT     GL
+struct FrameData
+{
+	Pipeline Camera;
+	glm::mat4 View;
+	glm::mat4 ViewProj;
+	glm::vec3 EyePos;
+	SpotLight SpotLights[2];
+	PointLight PointLights[3];
+	std::vector<PointLight> AllPointLights; // PointLights +  
+	std::vector<glm::mat4> World; //     [0, NumVisible)
+	std::vector<glm::mat4> WVP;
+	std::vector<float> Layers;
+	std::vector<unsigned int> Visible; //  ,    BVH
+	RenderQueue Queue; //    , Visible      
+	SceneObjects Gathered; //   ,  BatchTransform
+	unsigned int NumVisible;
+	bool Clustered; //      
+	bool DepthPrepass; //   ,   ,    
+	ShadowCascades Shadows; // Count 0 -   
+	std::vector<unsigned int> ShadowCasters; //    ,   
+	SceneObjects ShadowGathered;
+	std::vector<glm::mat4> ShadowWVP; // BatchTransform   ,    
+	ShadowAtlasFrame Atlas; //      ,   
+	bool InstancesUploaded; // World    ,       
+	bool LayersUploaded;
+	std::vector<DrawElementsIndirectCommand> Commands; //       ,   Queue
+	bool CommandsUploaded;
+	JobCounter Ready;
+
+	FrameData()
+	{
+		NumVisible = 0;
+		Clustered = false;
+		DepthPrepass = false;
+		InstancesUploaded = LayersUploaded = CommandsUploaded = false;
+	}
+};
+
+const unsigned int OBJECT_CHUNK = 256; //    
+const int CROWD_SIDE = 316; //  -  CROWD_SIDE x CROWD_SIDE 
+
 class Main : public ICallbacks
 {
 private:
-	GLuint VBO; // a global variable for storing a pointer to the vertex buffer
-	GLuint IBO;
-	float Scale;
-	float Scale1;
-	Texture* pTexture;
+	Mesh* pMesh; //          VAO
+	const char* pMeshFile; //  .mesh    nullptr
+	float Scale; //  ,   KickFrame   
+	float Scale1; //  
+	double simTime; //     
+	double previousSimTime; //   ,    
+	float interpolation;
+	TextureStreamer* pStreamer; //    ,     
+	TextureCache* pTextures; //    ,    
+	TextureHandle texture;
+	TextureArray* pTextureArray; //      
+	ProgramCache* pProgramCache; //     
 	LightingTechnique* pEffect;
+	LightingTechnique* pEffectInstanced;
+	LightingTechnique* pEffectArray; //     
+	LightingTechnique* pEffectArrayInstanced;
+	LightingTechniqueRegistry* pVariants; //       ,   
+	ClusteredLightingTechnique* pClusteredEffect;
+	ClusteredLightingTechnique* pClusteredEffectInstanced;
+	InstanceBuffer* pInstances; //      glDrawElementsInstanced
+	MeshPool* pMeshPool; //        
+	IndirectDrawBuffer* pIndirect; //     pMeshPool
+	LightClusterer* pClusterer;
+	DeferredRenderer* pDeferred;
+	CascadedShadowMap* pShadows; //      
+	ShadowAtlas* pShadowAtlas; //     
+	DepthPrepassTechnique* pDepthPrepass;
+	DepthPrepassTechnique* pDepthPrepassInstanced;
+	FragmentCounter* pFragments; //     
+	JobSystem* pJobs;
+	bool clusteredShading; // 'c'      
+	bool deferredShading; // 'g' -    G-
+	bool crowd; // 'n' -      
+	bool instancedRendering; // 'i' -     
+	bool textureArrays; // 't' -   -  ,   
+	SHADOW_QUALITY shadowQuality; // 'h' -  :  , , , 
+	bool depthPrepass; // 'z' -   ,    
+	bool multiDraw; // 'm' -       glMultiDrawElementsIndirect  
+	bool crowdBuilt;
+	std::vector<PointLight> lightField; //  ,     
 	DirectionalLight directionalLight;
+	SceneObjects objects;
+	BoundingVolumeHierarchy objectBvh; //   ,    
+	std::vector<std::pair<unsigned int, glm::vec3> > pendingMoves; // MoveObject   KickFrame
+	FrameData frames[2]; //    ,   
+	unsigned int frameIndex;
+	bool framePending;
+	GLuint outputFramebuffer; //   , 0 - 
 
 public:
-	Main()
+	Main(const char* pMeshFileName = nullptr)
 	{
+		pMeshFile = pMeshFileName;
 		Scale = 0.0f; Scale1 = 0;
-		pTexture = nullptr;
+		simTime = previousSimTime = 0.0;
+		interpolation = 1.0f;
+		pMesh = nullptr;
+		pStreamer = nullptr;
+		pTextures = nullptr;
+		pTextureArray = nullptr;
+		pProgramCache = nullptr;
 		pEffect = nullptr;
+		pEffectInstanced = nullptr;
+		pEffectArray = nullptr;
+		pEffectArrayInstanced = nullptr;
+		pVariants = nullptr;
+		pClusteredEffect = nullptr;
+		pClusteredEffectInstanced = nullptr;
+		pInstances = nullptr;
+		pMeshPool = nullptr;
+		pIndirect = nullptr;
+		pClusterer = nullptr;
+		pDeferred = nullptr;
+		pShadows = nullptr;
+		pShadowAtlas = nullptr;
+		pDepthPrepass = nullptr;
+		pDepthPrepassInstanced = nullptr;
+		pFragments = nullptr;
+		pJobs = nullptr;
+		clusteredShading = false;
+		deferredShading = false;
+		crowd = false;
+		instancedRendering = false;
+		textureArrays = false;
+		shadowQuality = SHADOW_QUALITY_MEDIUM;
+		depthPrepass = false;
+		multiDraw = true;
+		crowdBuilt = true; //     Init
+		frameIndex = 0;
+		framePending = false;
+		outputFramebuffer = 0;
 		directionalLight.Color = glm::vec3(1.0f, 1.0f, 1.0f); //   ()
 		directionalLight.AmbientIntensity = 0.5f; //  ,  
 		directionalLight.DiffuseIntensity = 0.2f; //   
@@ -103,155 +440,729 @@ public:
 
 	~Main()
 	{
-		delete pTexture;
+		if (framePending) pJobs->Wait(frames[frameIndex].Ready);
+
+		delete pJobs;
+		delete pMesh;
+		texture = TextureHandle(); //    
+		delete pTextures;
+		delete pTextureArray;
+		delete pStreamer;
 		delete pEffect;
+		delete pEffectInstanced;
+		delete pEffectArray;
+		delete pEffectArrayInstanced;
+		delete pVariants;
+		delete pClusteredEffect;
+		delete pClusteredEffectInstanced;
+		delete pInstances;
+		delete pIndirect;
+		delete pMeshPool;
+		delete pClusterer;
+		delete pDeferred;
+		delete pShadows;
+		delete pShadowAtlas;
+		delete pDepthPrepass;
+		delete pDepthPrepassInstanced;
+		delete pFragments;
+		Technique::SetProgramCache(nullptr);
+		delete pProgramCache;
 	}
 
 	bool Init()
 	{
-		CreateBuffers();
+		pProgramCache = new ProgramCache("shadercache");
+		Technique::SetProgramCache(pProgramCache);
+
+		if (!CreateBuffers()) return false;
 
-		pTexture = new Texture(GL_TEXTURE_2D, "test9.jpg");
-		if (!pTexture->Load()) return false;
+		pStreamer = new TextureStreamer();
+		pTextures = new TextureCache(*pStreamer);
+		texture = pTextures->Acquire("test9.jpg");
 
 		pEffect = new LightingTechnique();
 		if (!pEffect->Init()) return false;
 		pEffect->Enable();
 		pEffect->SetTextureUnit(0);
 
+		pEffectInstanced = new LightingTechnique(true);
+		if (!pEffectInstanced->Init()) return false;
+		pEffectInstanced->Enable();
+		pEffectInstanced->SetTextureUnit(0);
+
+		pEffectArray = new LightingTechnique(false, true);
+		if (!pEffectArray->Init()) return false;
+		pEffectArray->Enable();
+		pEffectArray->SetTextureUnit(0);
+
+		pEffectArrayInstanced = new LightingTechnique(true, true);
+		if (!pEffectArrayInstanced->Init()) return false;
+		pEffectArrayInstanced->Enable();
+		pEffectArrayInstanced->SetTextureUnit(0);
+
+		//  ,    SubmitFrame,    -   
+		pVariants = new LightingTechniqueRegistry(0);
+		for (int Mode = 0; Mode < 4; Mode++) pVariants->Request(GetForwardPermutation((Mode & 1) != 0, (Mode & 2) != 0, shadowQuality != SHADOW_QUALITY_OFF));
+
+		pClusteredEffect = new ClusteredLightingTechnique();
+		if (!pClusteredEffect->Init()) return false;
+		pClusteredEffect->SetTextureUnit(0);
+
+		pClusteredEffectInstanced = new ClusteredLightingTechnique(true);
+		if (!pClusteredEffectInstanced->Init()) return false;
+		pClusteredEffectInstanced->SetTextureUnit(0);
+
+		pInstances = new InstanceBuffer();
+		if (!pInstances->Init()) return false;
+
+		//     ;   -     SortDraws
+		pMeshPool = new MeshPool();
+		const Mesh* Meshes[] = { pMesh };
+		if (!pMeshPool->Build(Meshes, 1)) return false;
+		pIndirect = new IndirectDrawBuffer();
+		if (!pIndirect->Init()) return false;
+
+		pClusterer = new LightClusterer();
+		if (!pClusterer->Init()) return false;
+
+		pDeferred = new DeferredRenderer();
+		if (!pDeferred->Init(WINDOW_WIDTH, WINDOW_HEIGHT)) return false;
+
+		pShadows = new CascadedShadowMap();
+		if (!pShadows->Init(shadowQuality)) return false;
+
+		pShadowAtlas = new ShadowAtlas();
+		if (!pShadowAtlas->Init()) return false;
+
+		pDepthPrepass = new DepthPrepassTechnique();
+		if (!pDepthPrepass->Init()) return false;
+
+		pDepthPrepassInstanced = new DepthPrepassTechnique(true);
+		if (!pDepthPrepassInstanced->Init()) return false;
+
+		pFragments = new FragmentCounter();
+		if (!pFragments->Init()) return false;
+
+		pJobs = new JobSystem();
+
+		pTextureArray = new TextureArray();
+		if (!pTextureArray->Load({ "test9.jpg", "test.jpg" }, 512, 512, pJobs)) return false;
+
+		CreateLightField();
+		CreateScene();
+
+		if (pProgramCache->IsSupported()) std::cout << "Shader programs: " << pProgramCache->GetHits() << " from the cache, " << pProgramCache->GetMisses() << " compiled\n";
+
 		return true;
 	}
 
-	void Run()
+	void Run(const FrameSchedulerSettings& Settings = FrameSchedulerSettings())
 	{
-		GLUTBackendRun(this);
+		GLUTBackendRun(this, Settings);
 	}
 
-	virtual void RenderSceneCB() override //draw
+	//    ,      KickFrame
+	virtual void TickCB(float Step) override
 	{
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		//glClear(GL_COLOR_BUFFER_BIT); //clearing the frame buffer using the color specified above
+		previousSimTime = simTime;
+		simTime += Step;
+		MoveCrowdWave();
+	}
+
+	virtual void RenderSceneCB(float Interpolation) override //draw
+	{
+		interpolation = Interpolation;
+		RenderFrame();
+
+		//    ,    
+		glutSwapBuffers(); //swap the background buffer and the frame buffer
+	}
+
+	//      ,     -       
+	void RenderFrame()
+	{
+		Profiler::Get().BeginFrame(); //   GPU ,  PROFILER_GPU_LATENCY  
+		GLStateCache::Get().Invalidate(); // ,      (GLUT),  
+		{
+			PROFILE_GPU_SCOPE("Frame");
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFramebuffer); //    G-  
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			//glClear(GL_COLOR_BUFFER_BIT); //clearing the frame buffer using the color specified above
+
+			if (!framePending) KickFrame(frames[frameIndex]);
+
+			FrameData& f = frames[frameIndex];
+			{
+				PROFILE_SCOPE("WaitJobs");
+				pJobs->Wait(f.Ready); //  GLUT   ,  
+			}
+			{
+				PROFILE_GPU_SCOPE("Textures.Update");
+				pTextures->Update(); //     GL  PBO
+			}
+			{
+				PROFILE_SCOPE("Shaders.Update");
+				pVariants->Update(); //   
+			}
+			SubmitFrame(f);
+		}
+		Profiler::Get().EndFrame();
+
+		//   ,     
+		frameIndex ^= 1;
+		KickFrame(frames[frameIndex]);
+		framePending = true;
+	}
+
+	//        
+	bool IsLoading() const
+	{
+		return pStreamer->GetPendingCount() != 0 || pVariants->GetPendingCount() != 0;
+	}
 
-		Scale += 0.1f;
-		Scale1 += 0.05f;
+	//   ,     ; 0 - 
+	void SetOutputFramebuffer(GLuint Framebuffer)
+	{
+		outputFramebuffer = Framebuffer;
+		pDeferred->SetOutputFramebuffer(Framebuffer);
+	}
 
-		Pipeline p;
+private:
+
+	//  ,    f;       GL
+	void KickFrame(FrameData& f)
+	{
+		// 0.1  0.05    60   ,  ,       
+		double Time = previousSimTime + (simTime - previousSimTime) * interpolation;
+		Scale = (float)(Time * 6.0);
+		Scale1 = (float)(Time * 3.0);
 
-		p.Scale(0.3,0.3,0.3); // 
-		p.WorldPos(0.0f, 0.0f, 0);
-		p.Rotate(0, Scale, 0); //  
+		// ,    , -   
+		if (crowd != crowdBuilt) CreateScene();
+		ApplyMoves();
 
+		Pipeline& p = f.Camera; //  ,     
 
 		glm::vec3 CameraPos(0.0f, 0.0f, -3.0f); //    
 		glm::vec3 CameraTarget(0.0f, 0.0f, 2.0f); //   
 		glm::vec3 CameraUp(0.0f, 1.0f, 0.0f); //  
 		p.SetCamera(CameraPos, CameraTarget, CameraUp);
+		p.SetPerspectiveProj(60.0f, WINDOW_WIDTH, WINDOW_HEIGHT, 1.0f, 100.0f);
 
-		glm::vec3 SpotlightPos(0.0f, 0.0f, 0.0f);
-		glm::vec3 SpotlightDir(1.0f, 0.0f, 0.0f);
+		f.EyePos = CameraPos;
+		f.View = p.GetViewTrans();
+		f.ViewProj = p.GetViewProjTrans();
+		f.Clustered = clusteredShading && !deferredShading;
+		f.DepthPrepass = depthPrepass && !deferredShading; // G-       
 
-		p.SetPerspectiveProj(60.0f, WINDOW_WIDTH, WINDOW_HEIGHT, 1.0f, 100.0f);
+		//    ;   ,       
+		if (pShadows->GetQuality() != shadowQuality) pShadows->SetQuality(shadowQuality);
+		f.Shadows.Count = 0;
+		glm::vec3 SceneMin, SceneMax;
+		if (!deferredShading && !f.Clustered && objectBvh.GetBounds(SceneMin, SceneMax))
+		{
+			pShadows->Fit(f.ViewProj, p.GetPerspectiveProj(), directionalLight.Direction, SceneMin, SceneMax, f.Shadows);
+		}
 
-		SpotLight sl[2];
+		float LightTime = Scale1, ObjectTime = Scale;
+		pJobs->Run(f.Ready, [this, &f, LightTime, ObjectTime]()
+		{
+			AnimateLights(f, LightTime);
+			PrepareShadowAtlas(f, ObjectTime);
+			if (f.Clustered)
+			{
+				PROFILE_SCOPE("Clusters.Prepare");
+				pClusterer->Prepare(f.View, f.Camera.GetPerspectiveProj(), (unsigned int)f.AllPointLights.size(), f.AllPointLights.data(),
+					2, f.SpotLights, *pJobs);
+			}
+		});
+		pJobs->Run(f.Ready, [this, &f, ObjectTime]() { PrepareShadowCascades(f, ObjectTime); });
+		pJobs->Run(f.Ready, [this, &f, ObjectTime]() { PrepareObjects(f, ObjectTime); });
+	}
+
+	void AnimateLights(FrameData& f, float Time)
+	{
+		PROFILE_SCOPE("AnimateLights");
+		SpotLight* sl = f.SpotLights;
 		sl[0].DiffuseIntensity = 0.8f;
 		sl[0].Color = glm::vec3(0.0f, 1.0f, 1.0f);
 		sl[0].Position = glm::vec3(0.0f, 0.0f, 0.0f);
-		sl[0].Direction = glm::vec3(sinf(Scale1), 0.0f, cosf(Scale1));
+		sl[0].Direction = glm::vec3(sinf(Time), 0.0f, cosf(Time));
 		sl[0].Attenuation.Linear = 0.1f;
 		sl[0].Cutoff = 100.0f; 
 		//   -         ,      
 
 		sl[1].DiffuseIntensity = 0.5f; // 
 		sl[1].Color = glm::vec3(1.0f, 0.0f, 1.0f);
-		sl[1].Position = -CameraPos;
-		sl[1].Direction = -CameraTarget;
+		sl[1].Position = -f.EyePos;
+		sl[1].Direction = -f.Camera.GetCamera().Target;
 		sl[1].Attenuation.Linear = 0.1f; // 
 		sl[1].Cutoff = 100.0f; //  ,   -     
 
-		pEffect->SetSpotLights(2, sl);
-
-		PointLight pl[3]; //      ,      
+		PointLight* pl = f.PointLights; //      ,      
 		pl[0].DiffuseIntensity = 0.3; //  () 
 		pl[0].Color = glm::vec3(1.0f, 0.0f, 0.0f); // red
-		pl[0].Position = glm::vec3(sinf(Scale1) * 10, 1.0f, cosf(Scale1) * 10);
+		pl[0].Position = glm::vec3(sinf(Time) * 10, 1.0f, cosf(Time) * 10);
 		pl[0].Attenuation.Linear = 0.1;
 
 		pl[1].DiffuseIntensity = 0.3;
 		pl[1].Color = glm::vec3(0.0f, 1.0f, 0.0f); // green
-		pl[1].Position = glm::vec3(sinf(Scale1 + 2.1f) * 10, 1.0f, cosf(Scale1 + 2.1f) * 10);
+		pl[1].Position = glm::vec3(sinf(Time + 2.1f) * 10, 1.0f, cosf(Time + 2.1f) * 10);
 		pl[1].Attenuation.Linear = 0.1;
 
 		pl[2].DiffuseIntensity = 0.3;
 		pl[2].Color = glm::vec3(0.0f, 0.0f, 1.0f); // blue
-		pl[2].Position = glm::vec3(sinf(Scale1 + 4.2f) * 10, 1.0f, cosf(Scale1 + 4.2f) * 10);
+		pl[2].Position = glm::vec3(sinf(Time + 4.2f) * 10, 1.0f, cosf(Time + 4.2f) * 10);
 		pl[2].Attenuation.Linear = 0.1;
 
-		pEffect->SetPointLights(3, pl);
+		//    MAX_POINT_LIGHTS,      
+		f.AllPointLights.assign(pl, pl + 3);
+		f.AllPointLights.insert(f.AllPointLights.end(), lightField.begin(), lightField.end());
+	}
+
+	//     :        
+	// .     ,    
+	void PrepareShadowAtlas(FrameData& f, float Time)
+	{
+		if (f.Shadows.Count == 0)
+		{
+			f.Atlas.Clear();
+			return;
+		}
+
+		PROFILE_SCOPE("ShadowAtlas.Prepare");
+		auto Cull = [this](const glm::mat4& ViewProj, std::vector<unsigned int>& Casters) -> uint64_t
+		{
+			Frustum View;
+			View.FromViewProj(ViewProj);
+			Casters.clear();
+			objectBvh.Cull(View, Casters);
 
-		pEffect->SetWVP(p.GetWVPTrans());
-		pEffect->SetWorld(p.GetWorldTrans());
-		pEffect->SetDirectionalLight(directionalLight);
+			uint64_t Hash = 14695981039346656037ull ^ objects.Count(); // FNV-1a    
+			for (unsigned int o : Casters)
+			{
+				if (objects.Spin[o] != 0.0f) return SHADOW_CASTERS_ANIMATED;
+				Hash = (Hash ^ o) * 1099511628211ull;
+				Hash = (Hash ^ objects.Version[o]) * 1099511628211ull;
+			}
+			return Hash == SHADOW_CASTERS_ANIMATED ? 1 : Hash;
+		};
+		auto Transform = [this, Time](const std::vector<unsigned int>& Casters, std::vector<glm::mat4>& World)
+		{
+			unsigned int Count = (unsigned int)Casters.size(), First = (unsigned int)World.size();
+			SceneObjects g;
+			g.Resize(Count);
+			g.Gather(objects, Casters.data(), 0, Count, Time);
+			std::vector<glm::mat4> WVP(Count);
+			World.resize(First + Count);
+			if (Count > 0) BatchTransform(g.Batch(0, Count), glm::mat4{ 1.0f }, &World[First], WVP.data());
+		};
+
+		float TanHalfFOV = tanf(glm::radians(f.Camera.GetPerspectiveProj().FOV / 2.0f));
+		pShadowAtlas->Prepare(f.ViewProj, f.EyePos, TanHalfFOV, 3, f.PointLights, 2, f.SpotLights, Cull, Transform, f.Atlas);
+	}
 
-		pEffect->SetEyeWorldPos(CameraPos);
-		pEffect->SetMatSpecularIntensity(0); //  
-		pEffect->SetMatSpecularPower(0); //   
+	//     :       BVH,   
+	// ,     -         
+	// .      f.Shadows.Casters,  OBJECT_CHUNK  
+	void PrepareShadowCascades(FrameData& f, float Time)
+	{
+		ShadowCascades& s = f.Shadows;
+		f.ShadowCasters.clear();
+		if (s.Count == 0)
+		{
+			s.Casters.clear();
+			return;
+		}
 
-		// Rendering
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1); // Enable or disable the shared array of vertex attributes
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO); // Bind the buffer, prepare it for rendering
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0); // data inside the buffer
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)12);
-		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)20);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-		pTexture->Bind(GL_TEXTURE0);
+		PROFILE_SCOPE("PrepareShadowCascades");
+		for (unsigned int c = 0; c < s.Count; c++)
+		{
+			Frustum View;
+			View.FromViewProj(s.ViewProj[c]);
+			s.First[c] = (unsigned int)f.ShadowCasters.size();
+			objectBvh.Cull(View, f.ShadowCasters);
+			s.CasterCount[c] = (unsigned int)f.ShadowCasters.size() - s.First[c];
+		}
 
-		glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_INT, 0);
+		unsigned int Count = (unsigned int)f.ShadowCasters.size();
+		s.Casters.resize(Count);
+		f.ShadowWVP.resize(Count);
+		f.ShadowGathered.Resize(Count);
 
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
+		JobCounter Done;
+		pJobs->ParallelFor(Done, Count, OBJECT_CHUNK, [this, &f, Time](unsigned int First, unsigned int Last)
+		{
+			SceneObjects& g = f.ShadowGathered;
+			g.Gather(objects, f.ShadowCasters.data(), First, Last, Time);
+			BatchTransform(g.Batch(First, Last), glm::mat4{ 1.0f }, &f.Shadows.Casters[First], &f.ShadowWVP[First]);
+		});
+		pJobs->Wait(Done);
+	}
 
-		// indicates that the current window should be redrawn and during operation
-		// of the main loop GLUT render function will be called
-		glutPostRedisplay();
+	//   BVH,     ,  OBJECT_CHUNK  
+	void PrepareObjects(FrameData& f, float Time)
+	{
+		PROFILE_SCOPE("PrepareObjects");
+		Frustum View;
+		View.FromViewProj(f.ViewProj);
 
-		glutSwapBuffers(); //swap the background buffer and the frame buffer
+		f.Visible.clear();
+		objectBvh.Cull(View, f.Visible);
+		SortDraws(f);
+		IndirectDrawBuffer::BuildCommands(*pMeshPool, f.Queue, f.Commands);
+
+		unsigned int Count = (unsigned int)f.Visible.size();
+		f.World.resize(Count);
+		f.WVP.resize(Count);
+		f.Layers.resize(Count);
+		f.Gathered.Resize(Count);
+
+		JobCounter Done;
+		pJobs->ParallelFor(Done, Count, OBJECT_CHUNK, [this, &f, Time](unsigned int First, unsigned int Last)
+		{
+			SceneObjects& g = f.Gathered;
+			g.Gather(objects, f.Visible.data(), First, Last, Time);
+			std::copy(g.Layer.begin() + First, g.Layer.begin() + Last, f.Layers.begin() + First);
+
+			BatchTransform(g.Batch(First, Last), f.ViewProj, &f.World[First], &f.WVP[First]);
+		});
+		pJobs->Wait(Done);
+		f.NumVisible = Count;
+		f.InstancesUploaded = f.LayersUploaded = f.CommandsUploaded = false;
 	}
 
-	virtual void IdleCB()
+	//     :  GL,   ,  ; 
+	//       ,   -   
+	//  ,      .  ,  ( 
+	// )      ,     
+	void SortDraws(FrameData& f)
 	{
-		RenderSceneCB();
+		PROFILE_SCOPE("SortDraws");
+		const glm::mat4& v = f.View; //  2 -    
+		f.Queue.Clear();
+		for (unsigned int o : f.Visible)
+		{
+			float Depth = v[2][0] * objects.PosX[o] + v[2][1] * objects.PosY[o] + v[2][2] * objects.PosZ[o] + v[2][3];
+			f.Queue.Push(RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, 0, 0, Depth), o);
+		}
+		f.Queue.Sort();
+		std::copy(f.Queue.GetItems(), f.Queue.GetItems() + f.Queue.GetCount(), f.Visible.begin());
 	}
 
-private:
+	// ,    GLUT:      
+	void SubmitFrame(FrameData& f)
+	{
+		RenderShadowAtlas(f); //   :   ,   ,  
+
+		if (deferredShading)
+		{
+			PROFILE_GPU_SCOPE("Deferred");
+			GeometryPassTechnique* pGeometryPass = pDeferred->BeginGeometryPass(instancedRendering);
+			pGeometryPass->SetMatSpecularIntensity(0);
+			pGeometryPass->SetMatSpecularPower(0);
+			DrawObjects(pGeometryPass, f);
+
+			pDeferred->LightPass(f.Camera, f.EyePos, directionalLight, (unsigned int)f.AllPointLights.size(), f.AllPointLights.data(), 2, f.SpotLights);
+		}
+		else if (clusteredShading && f.Clustered)
+		{
+			PROFILE_GPU_SCOPE("Clustered");
+			ClusteredLightingTechnique* pTechnique = instancedRendering ? pClusteredEffectInstanced : pClusteredEffect;
+			pClusterer->Upload();
+			if (f.DepthPrepass) DepthPrepass(f);
+
+			pTechnique->Enable();
+			pTechnique->SetClusters(*pClusterer, f.Camera.GetPerspectiveProj());
+			pClusterer->Bind();
+
+			pTechnique->SetDirectionalLight(directionalLight);
+			pTechnique->SetEyeWorldPos(f.EyePos);
+			pTechnique->SetMatSpecularIntensity(0);
+			pTechnique->SetMatSpecularPower(0);
+			DrawLit(pTechnique, f);
+		}
+		else
+		{
+			PROFILE_GPU_SCOPE("Forward");
+			LightingTechnique* pTechnique = pVariants->Get(GetForwardPermutation(instancedRendering, textureArrays, f.Shadows.Count > 0));
+			if (pTechnique == nullptr)
+			{
+				pTechnique = textureArrays ? (instancedRendering ? pEffectArrayInstanced : pEffectArray) :
+					(instancedRendering ? pEffectInstanced : pEffect);
+			}
+			//    :     ,   
+			bool Shadows = pTechnique->GetPermutation().Shadows;
+			if (Shadows) RenderShadows(f);
+			if (f.DepthPrepass) DepthPrepass(f);
+
+			{
+				PROFILE_SCOPE("Uniforms"); //  ,  
+				pTechnique->Enable();
+				pTechnique->SetSpotLights(2, f.SpotLights);
+				pTechnique->SetPointLights(3, f.PointLights);
+				pTechnique->SetDirectionalLight(directionalLight);
+
+				pTechnique->SetEyeWorldPos(f.EyePos);
+				pTechnique->SetMatSpecularIntensity(0); //  
+				pTechnique->SetMatSpecularPower(0); //   
+				pTechnique->CommitLights(); //     
+				if (Shadows)
+				{
+					pShadows->Bind(SHADOW_MAP_UNIT);
+					pTechnique->SetShadowCascades(f.Shadows.Count, f.Shadows.ViewProj, pShadows->GetPcfRadius());
+					pShadowAtlas->Bind(SHADOW_ATLAS_UNIT);
+					pTechnique->SetLocalShadows(f.Atlas.PointMatrices, f.Atlas.PointRects, f.Atlas.SpotMatrices, f.Atlas.SpotRects);
+				}
+			}
+			DrawLit(pTechnique, f, textureArrays);
+		}
+	}
+
+	//     3   2     (  0)
+	static LightingPermutation GetForwardPermutation(bool Instanced, bool TextureArray, bool Shadows)
+	{
+		LightingPermutation Permutation(Instanced, TextureArray);
+		Permutation.NumPointLights = 3;
+		Permutation.NumSpotLights = 2;
+		Permutation.Specular = false;
+		Permutation.Shadows = Shadows;
+		return Permutation;
+	}
+
+	//     ,   :     
+	// ,         
+	void RenderShadows(FrameData& f)
+	{
+		PROFILE_GPU_SCOPE("Shadows");
+		pMesh->Bind();
+		pShadows->Render(f.Shadows, [this](unsigned int Count) { pMesh->DrawInstanced(Count); });
+	}
+
+	//         (   );  
+	//          
+	void DepthPrepass(FrameData& f)
+	{
+		PROFILE_GPU_SCOPE("DepthPrepass");
+		DepthPrepassTechnique* pTechnique = instancedRendering ? pDepthPrepassInstanced : pDepthPrepass;
+		pTechnique->Enable();
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		DrawObjects(pTechnique, f);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+
+	//  ,   ,   
+	template <class T> void DrawLit(T* pTechnique, FrameData& f, bool Layered = false)
+	{
+		pFragments->Begin();
+		DrawObjects(pTechnique, f, Layered);
+		pFragments->End();
+
+		if (f.DepthPrepass)
+		{
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
+		}
+	}
+
+	//     ,     
+	void RenderShadowAtlas(FrameData& f)
+	{
+		if (f.Atlas.Slices.empty()) return;
+
+		PROFILE_GPU_SCOPE("ShadowAtlas");
+		pMesh->Bind();
+		pShadowAtlas->Render(f.Atlas, [this](unsigned int Count) { pMesh->DrawInstanced(Count); });
+	}
+
+	//           
+	void UploadInstances(FrameData& f, bool Layered)
+	{
+		if (!f.InstancesUploaded)
+		{
+			pInstances->Upload(f.World.data(), f.NumVisible);
+			f.InstancesUploaded = true;
+			f.LayersUploaded = false;
+		}
+		if (Layered && !f.LayersUploaded)
+		{
+			pInstances->UploadLayers(f.Layers.data());
+			f.LayersUploaded = true;
+		}
+	}
+
+	// Layered -    ,     
+	template <class T> void DrawObjects(T* pTechnique, FrameData& f, bool Layered = false)
+	{
+		if (f.NumVisible == 0) return;
+
+		PROFILE_GPU_SCOPE("Draw");
+		BindMesh(Layered);
+		if (instancedRendering)
+		{
+			//          
+			UploadInstances(f, Layered);
+			pInstances->Bind();
+			pTechnique->SetViewProj(&f.ViewProj);
+			DrawInstances(f);
+			pInstances->Unbind();
+		}
+		else
+		{
+			//    :       
+			uint64_t State = 0;
+			float Layer = -1.0f;
+			for (unsigned int i = 0; i < f.NumVisible; i++)
+			{
+				uint64_t Key = f.Queue.GetKey(i) >> 32; //  
+				if (i > 0 && Key != State) BindMesh(Layered);
+				State = Key;
+
+				pTechnique->SetWVP(&f.WVP[i]);
+				pTechnique->SetWorld(&f.World[i]);
+				if (Layered && f.Layers[i] != Layer)
+				{
+					Layer = f.Layers[i];
+					SetLayer(pTechnique, Layer);
+				}
+				pMesh->Draw();
+			}
+		}
+	}
+
+	//  0      SortDraws;    GLStateCache,  
+	//       
+	void BindMesh(bool Layered)
+	{
+		BindGeometry(instancedRendering);
+
+		PROFILE_GPU_SCOPE("Textures.Bind");
+		if (Layered) pTextureArray->Bind(GL_TEXTURE0);
+		else texture.Bind(GL_TEXTURE0);
+	}
 
-	void CalcNormals(const unsigned int* pIndices, unsigned int IndexCount, Vertex* pVertices, unsigned int VertexCount) 
+	//        VAO;     
+	void BindGeometry(bool Instanced)
 	{
-		for (unsigned int i = 0; i < IndexCount; i += 3) 
+		if (Instanced && multiDraw) pMeshPool->Bind();
+		else pMesh->Bind();
+	}
+
+	//   ,  BindGeometry(true)  pInstances->Bind():  
+	//  GPU -    ,     , -     pMesh
+	void DrawInstances(FrameData& f)
+	{
+		if (!multiDraw)
+		{
+			pMesh->DrawInstanced(f.NumVisible);
+			return;
+		}
+		if (!f.CommandsUploaded)
 		{
-			unsigned int Index0 = pIndices[i];
-			unsigned int Index1 = pIndices[i + 1];
-			unsigned int Index2 = pIndices[i + 2];
-			glm::vec3 v1 = pVertices[Index1].m_pos - pVertices[Index0].m_pos;
-			glm::vec3 v2 = pVertices[Index2].m_pos - pVertices[Index0].m_pos;
-			glm::vec3 Normal = v1 * v2;
-			glm::normalize(Normal);
-
-			pVertices[Index0].m_normal += Normal;
-			pVertices[Index1].m_normal += Normal;
-			pVertices[Index2].m_normal += Normal;
+			pIndirect->Upload(f.Commands);
+			f.CommandsUploaded = true;
 		}
+		pIndirect->Draw(*pInstances);
+	}
+
+	//       
+	static void SetLayer(LightingTechnique* pTechnique, float Layer)
+	{
+		pTechnique->SetLayer(Layer);
+	}
 
-		for (unsigned int i = 0; i < VertexCount; i++) 
+	template <class T> static void SetLayer(T*, float)
+	{
+	}
+
+	//   ,  ,   ~100 000   
+	void CreateScene()
+	{
+		objects.Clear();
+		pendingMoves.clear(); //   
+		objects.Radius = pMesh->GetBoundingRadius();
+		objects.Add(glm::vec3(0.0f, 0.0f, 0.0f), 0.3f, 0.0f, 1.0f);
+
+		if (crowd)
 		{
-			glm::normalize(pVertices[i].m_normal);
+			for (int z = 0; z < CROWD_SIDE; z++)
+			{
+				for (int x = 0; x < CROWD_SIDE; x++)
+				{
+					objects.Add(glm::vec3((x - CROWD_SIDE / 2) * 0.5f, -2.5f, 2.0f + z * 0.5f), 0.15f, (float)((x * 37 + z * 11) % 360), 0.5f + (x % 4) * 0.5f,
+						(float)((x + z) % pTextureArray->GetLayerCount()));
+				}
+			}
 		}
+		crowdBuilt = crowd;
+
+		std::vector<glm::vec3> Min(objects.Count()), Max(objects.Count());
+		for (unsigned int i = 0; i < objects.Count(); i++) objects.GetBounds(i, Min[i], Max[i]);
+		objectBvh.Build(objects.Count(), Min.data(), Max.data());
 	}
 
-	void CreateBuffers()
+	//      :     MoveObject,  
+	// BVH   ,      
+	void MoveCrowdWave()
 	{
+		if (objects.Count() < 1 + (unsigned int)CROWD_SIDE) return; //  
+		for (int x = 0; x < CROWD_SIDE; x++)
+		{
+			float Height = 0.3f * fabsf(sinf((float)simTime * 3.0f + x * 0.2f));
+			MoveObject(1 + x, glm::vec3((x - CROWD_SIDE / 2) * 0.5f, -2.5f + Height, 2.0f));
+		}
+	}
+
+	//   ;    ,   
+	//     KickFrame    BVH
+	void MoveObject(unsigned int i, const glm::vec3& Pos)
+	{
+		pendingMoves.push_back(std::make_pair(i, Pos));
+	}
+
+	void ApplyMoves()
+	{
+		for (const auto& Move : pendingMoves)
+		{
+			unsigned int i = Move.first;
+			objects.PosX[i] = Move.second.x;
+			objects.PosY[i] = Move.second.y;
+			objects.PosZ[i] = Move.second.z;
+			objects.Version[i]++;
+
+			glm::vec3 Min, Max;
+			objects.GetBounds(i, Min, Max);
+			objectBvh.SetBounds(i, Min, Max);
+		}
+		pendingMoves.clear();
+		objectBvh.Refit();
+	}
+
+	//   32x32    
+	void CreateLightField()
+	{
+		const int Side = 32;
+		for (int z = 0; z < Side; z++)
+		{
+			for (int x = 0; x < Side; x++)
+			{
+				PointLight l;
+				l.Color = glm::vec3((x % 3) == 0 ? 1.0f : 0.2f, (x % 3) == 1 ? 1.0f : 0.2f, (z % 2) == 0 ? 1.0f : 0.2f);
+				l.DiffuseIntensity = 0.5f;
+				l.Position = glm::vec3((x - Side / 2) * 0.5f, -1.5f, (z - Side / 2) * 0.5f);
+				l.Attenuation.Exp = 50.0f; //    1.6
+				lightField.push_back(l);
+			}
+		}
+	}
+
+	bool CreateBuffers()
+	{
+		pMesh = new Mesh();
+		if (pMeshFile != nullptr) return LoadMeshFile(pMeshFile, *pMesh); //      
+
 		Vertex Vertices[4] =
 		{
 			//			 				 
@@ -266,15 +1177,10 @@ private:
 									2, 3, 0,
 									0, 2, 1	 };
 
-		CalcNormals(Indices, 12, Vertices, 4);
+		GenerateNormals(Indices, 12, Vertices, 4);
 
-		glGenBuffers(1, &VBO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertices), Vertices, GL_STATIC_DRAW);
-
-		glGenBuffers(1, &IBO);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices), Indices, GL_STATIC_DRAW);
+		//  : 20     32
+		return pMesh->Create(Vertices, 4, Indices, 12, VERTEX_LAYOUT_COMPACT);
 	}
 
 	virtual void KeyboardCB(unsigned char key, int x, int y)
@@ -296,6 +1202,58 @@ private:
 		case 'a':
 			directionalLight.DiffuseIntensity -= 0.05f;
 			break;
+
+		case 'c': //  
+			clusteredShading = !clusteredShading;
+			break;
+
+		case 'g': //  
+			deferredShading = !deferredShading;
+			break;
+
+		case 'b': //    
+			BenchmarkBatchTransform(10000, 20);
+			break;
+
+		case 'n': //   
+			crowd = !crowd;
+			break;
+
+		case 'i': //  
+			instancedRendering = !instancedRendering;
+			break;
+
+		case 't': //  
+			textureArrays = !textureArrays;
+			break;
+
+		case 'm': //     glMultiDrawElementsIndirect  
+			multiDraw = !multiDraw;
+			std::cout << (multiDraw ? (pIndirect->IsSupported() ? "Multi-draw indirect\n" : "Multi-draw indirect is not supported, a draw call per mesh\n") : "Instanced draw per mesh\n");
+			break;
+
+		case 'v': //   
+			BenchmarkNormalGeneration(1024);
+			break;
+
+		case 'p': // min/avg/p99  
+			Profiler::Get().Report(std::cout);
+			std::cout << "Shaded fragments per frame: " << pFragments->GetLast() << (depthPrepass ? " (depth pre-pass)\n" : "\n");
+			std::cout << "State changes per frame: " << Profiler::Get().GetFrameCounter(PROFILE_STATE_CHANGES)
+				<< ", skipped as redundant: " << Profiler::Get().GetFrameCounter(PROFILE_REDUNDANT_STATE) << "\n";
+			break;
+
+		case 'r': //  120     Chrome
+			Profiler::Get().Capture(120, "trace.json");
+			break;
+
+		case 'z': //   ;   'p'
+			depthPrepass = !depthPrepass;
+			break;
+
+		case 'h': //  
+			shadowQuality = (SHADOW_QUALITY)((shadowQuality + 1) % SHADOW_QUALITY_COUNT);
+			break;
 		}
 	}
 };
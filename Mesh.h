@@ -0,0 +1,315 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include "Profiler.h"
+#include "GLStateCache.h"
+
+struct Vertex
+{
+	glm::vec3 m_pos;
+	glm::vec2 m_tex;
+	glm::vec3 m_normal;
+
+	Vertex() { }
+
+	Vertex(glm::vec3 pos, glm::vec2 tex)
+	{
+		m_pos = pos;
+		m_tex = tex;
+		m_normal = glm::vec3(0.0f, 0.0f, 0.0f);
+	}
+};
+
+// 20 bytes instead of 32: half float texture coordinates and the normal
+// packed as signed normalized 10:10:10:2 (GL_INT_2_10_10_10_REV)
+struct CompactVertex
+{
+	glm::vec3 m_pos;
+	GLushort m_tex[2];
+	GLuint m_normal;
+};
+
+static_assert(sizeof(Vertex) == 32, "Vertex must stay tightly packed");
+static_assert(sizeof(CompactVertex) == 20, "CompactVertex must stay tightly packed");
+
+enum VERTEX_LAYOUT
+{
+	VERTEX_LAYOUT_FULL,    // Vertex
+	VERTEX_LAYOUT_COMPACT  // CompactVertex
+};
+
+// IEEE 754 binary16, rounded to nearest even, overflow goes to infinity
+inline GLushort FloatToHalf(float Value)
+{
+	GLuint Bits;
+	memcpy(&Bits, &Value, sizeof(Bits));
+
+	GLuint Sign = (Bits >> 16) & 0x8000;
+	GLuint Abs = Bits & 0x7FFFFFFF;
+
+	if (Abs >= 0x7F800000) // inf or NaN
+	{
+		return (GLushort)(Sign | 0x7C00 | (Abs > 0x7F800000 ? 0x200 : 0));
+	}
+	if (Abs >= 0x477FF000) // rounds to a value above the largest half
+	{
+		return (GLushort)(Sign | 0x7C00);
+	}
+	if (Abs < 0x38800000) // half denormal or zero
+	{
+		float Scaled;
+		memcpy(&Scaled, &Abs, sizeof(Scaled));
+		return (GLushort)(Sign | (GLuint)lrintf(Scaled * 16777216.0f)); // 2^24, one step of the smallest denormal
+	}
+
+	GLuint Rounded = Abs + 0xFFF + ((Abs >> 13) & 1);
+	return (GLushort)(Sign | ((Rounded - 0x38000000) >> 13));
+}
+
+// direction only, the shaders normalize the interpolated normal anyway
+inline GLuint PackNormal(const glm::vec3& Normal)
+{
+	float Length = sqrtf(Normal.x * Normal.x + Normal.y * Normal.y + Normal.z * Normal.z);
+	glm::vec3 n = Length > 0.0f ? Normal / Length : Normal;
+
+	int x = (int)lrintf(std::min(std::max(n.x, -1.0f), 1.0f) * 511.0f);
+	int y = (int)lrintf(std::min(std::max(n.y, -1.0f), 1.0f) * 511.0f);
+	int z = (int)lrintf(std::min(std::max(n.z, -1.0f), 1.0f) * 511.0f);
+
+	return ((GLuint)x & 0x3FF) | (((GLuint)y & 0x3FF) << 10) | (((GLuint)z & 0x3FF) << 20);
+}
+
+inline CompactVertex MakeCompactVertex(const Vertex& v)
+{
+	CompactVertex c;
+	c.m_pos = v.m_pos;
+	c.m_tex[0] = FloatToHalf(v.m_tex.x);
+	c.m_tex[1] = FloatToHalf(v.m_tex.y);
+	c.m_normal = PackNormal(v.m_normal);
+	return c;
+}
+
+// Vertex and index buffers plus a vertex array object that records the attribute
+// setup once, drawing is a bind and a draw call. Attributes 0, 1 and 2 are the
+// position, texture coordinates and normal every technique expects.
+class Mesh
+{
+private:
+	GLuint VAO;
+	GLuint VBO;
+	GLuint IBO;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	VERTEX_LAYOUT layout;
+	glm::vec3 boundsMin; // object space bounding box
+	glm::vec3 boundsMax;
+
+public:
+	Mesh()
+	{
+		VAO = VBO = IBO = 0;
+		vertexCount = 0;
+		indexCount = 0;
+		layout = VERTEX_LAYOUT_FULL;
+		boundsMin = boundsMax = glm::vec3(0.0f, 0.0f, 0.0f);
+	}
+
+	~Mesh()
+	{
+		Clear();
+	}
+
+	// uploads the geometry in the given layout, the vertices are converted if needed
+	bool Create(const Vertex* pVertices, unsigned int VertexCount, const unsigned int* pIndices, unsigned int IndexCount,
+		VERTEX_LAYOUT Layout)
+	{
+		if (!Allocate(VertexCount, IndexCount, Layout)) return false;
+
+		if (Layout == VERTEX_LAYOUT_COMPACT)
+		{
+			std::vector<CompactVertex> Compact(VertexCount);
+			for (unsigned int i = 0; i < VertexCount; i++) Compact[i] = MakeCompactVertex(pVertices[i]);
+			UploadVertices(0, Compact.data(), VertexCount * sizeof(CompactVertex));
+		}
+		else
+		{
+			UploadVertices(0, pVertices, VertexCount * sizeof(Vertex));
+		}
+		UploadIndices(0, pIndices, IndexCount * sizeof(unsigned int));
+
+		glm::vec3 Min(FLT_MAX, FLT_MAX, FLT_MAX), Max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (unsigned int i = 0; i < VertexCount; i++)
+		{
+			Min = glm::min(Min, pVertices[i].m_pos);
+			Max = glm::max(Max, pVertices[i].m_pos);
+		}
+		if (VertexCount > 0) SetBounds(Min, Max);
+
+		return glGetError() == GL_NO_ERROR;
+	}
+
+	// creates the buffers with undefined contents, UploadVertices and UploadIndices fill them part by part
+	bool Allocate(unsigned int VertexCount, unsigned int IndexCount, VERTEX_LAYOUT Layout)
+	{
+		Clear();
+		layout = Layout;
+		vertexCount = VertexCount;
+		indexCount = IndexCount;
+
+		glGenVertexArrays(1, &VAO);
+		GLStateCache::Get().BindVertexArray(VAO);
+
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)VertexCount * GetVertexSize(Layout), nullptr, GL_STATIC_DRAW);
+		SetupAttributes(Layout);
+
+		// the element buffer binding is part of the VAO state
+		glGenBuffers(1, &IBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)IndexCount * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+
+		GLStateCache::Get().BindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		return glGetError() == GL_NO_ERROR;
+	}
+
+	// Offset and Size in bytes, the data is already in the mesh layout; the copy
+	// target is used so the upload never touches the bound VAO
+	void UploadVertices(size_t Offset, const void* pData, size_t Size)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)Offset, (GLsizeiptr)Size, pData);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	void UploadIndices(size_t Offset, const void* pData, size_t Size)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, IBO);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)Offset, (GLsizeiptr)Size, pData);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	// all of Source, which has the same layout, to vertex FirstVertex and index FirstIndex;
+	// buffer to buffer on the GPU, so a mesh streamed from a file is merged as well
+	void CopyFrom(const Mesh& Source, unsigned int FirstVertex, unsigned int FirstIndex)
+	{
+		GLsizei VertexSize = GetVertexSize(layout);
+		glBindBuffer(GL_COPY_READ_BUFFER, Source.VBO);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (GLintptr)FirstVertex * VertexSize, (GLsizeiptr)Source.vertexCount * VertexSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, Source.IBO);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, IBO);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (GLintptr)FirstIndex * sizeof(unsigned int), (GLsizeiptr)Source.indexCount * sizeof(unsigned int));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	void SetBounds(const glm::vec3& Min, const glm::vec3& Max)
+	{
+		boundsMin = Min;
+		boundsMax = Max;
+	}
+
+	const glm::vec3& GetBoundsMin() const
+	{
+		return boundsMin;
+	}
+
+	const glm::vec3& GetBoundsMax() const
+	{
+		return boundsMax;
+	}
+
+	// radius of the sphere around the object space origin that holds the whole mesh
+	float GetBoundingRadius() const
+	{
+		glm::vec3 Far = glm::max(glm::abs(boundsMin), glm::abs(boundsMax));
+		return glm::length(Far);
+	}
+
+	void Bind() const
+	{
+		GLStateCache::Get().BindVertexArray(VAO);
+	}
+
+	void Unbind() const
+	{
+		GLStateCache::Get().BindVertexArray(0);
+	}
+
+	// the mesh must be bound
+	void Draw() const
+	{
+		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+		Profiler::Get().Count(PROFILE_DRAW_CALLS);
+	}
+
+	void DrawInstanced(unsigned int InstanceCount) const
+	{
+		glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, InstanceCount);
+		Profiler::Get().Count(PROFILE_DRAW_CALLS);
+	}
+
+	unsigned int GetVertexCount() const
+	{
+		return vertexCount;
+	}
+
+	unsigned int GetIndexCount() const
+	{
+		return indexCount;
+	}
+
+	VERTEX_LAYOUT GetLayout() const
+	{
+		return layout;
+	}
+
+	static GLsizei GetVertexSize(VERTEX_LAYOUT Layout)
+	{
+		return Layout == VERTEX_LAYOUT_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
+	}
+
+	// attribute pointers of the layout for the buffer bound to GL_ARRAY_BUFFER,
+	// starting at byte Offset; the bound VAO records them
+	static void SetupAttributes(VERTEX_LAYOUT Layout, size_t Offset = 0)
+	{
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+
+		if (Layout == VERTEX_LAYOUT_COMPACT)
+		{
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(CompactVertex), (const GLvoid*)(Offset + offsetof(CompactVertex, m_pos)));
+			glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (const GLvoid*)(Offset + offsetof(CompactVertex, m_tex)));
+			glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (const GLvoid*)(Offset + offsetof(CompactVertex, m_normal)));
+		}
+		else
+		{
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)(Offset + offsetof(Vertex, m_pos)));
+			glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)(Offset + offsetof(Vertex, m_tex)));
+			glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)(Offset + offsetof(Vertex, m_normal)));
+		}
+	}
+
+private:
+	void Clear()
+	{
+		if (VAO != 0) GLStateCache::Get().DeleteVertexArray(VAO);
+		if (VBO != 0) glDeleteBuffers(1, &VBO);
+		if (IBO != 0) glDeleteBuffers(1, &IBO);
+		VAO = VBO = IBO = 0;
+		vertexCount = 0;
+		indexCount = 0;
+	}
+};
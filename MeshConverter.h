@@ -0,0 +1,581 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cfloat>
+#include "Mesh.h"
+#include "MeshFile.h"
+#include "NormalGeneration.h"
+
+// Offline conversion of OBJ and PLY files into the binary .mesh format of MeshFile.h.
+// Both text formats put v = 0 at the bottom of the image while Texture uploads the
+// top row first, so the texture coordinates are flipped on the way in.
+
+struct MeshData
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+	bool HasNormals;
+
+	MeshData() : HasNormals(false) { }
+};
+
+// Reads a text file line by line through a fixed buffer, much faster than
+// iostreams on files of several gigabytes.
+class LineReader
+{
+private:
+	FILE* file;
+	std::vector<char> buffer;
+	size_t begin; // first unread byte
+	size_t end;   // one past the last valid byte
+	bool eof;
+
+public:
+	LineReader(FILE* File) : file(File), buffer(1 << 20), begin(0), end(0), eof(false) { }
+
+	// next line without the line break, nullptr at the end of the file
+	char* Next()
+	{
+		while (true)
+		{
+			char* pStart = buffer.data() + begin;
+			char* pBreak = (char*)memchr(pStart, '\n', end - begin);
+			if (pBreak != nullptr || (eof && begin < end))
+			{
+				char* pEnd = pBreak != nullptr ? pBreak : buffer.data() + end;
+				begin = pBreak != nullptr ? (size_t)(pBreak - buffer.data()) + 1 : end;
+				if (pEnd > pStart && pEnd[-1] == '\r') pEnd--;
+				*pEnd = 0;
+				return pStart;
+			}
+			if (eof) return nullptr;
+
+			// move the partial line to the front, grow if it fills the whole buffer
+			memmove(buffer.data(), buffer.data() + begin, end - begin);
+			end -= begin;
+			begin = 0;
+			if (end + 1 >= buffer.size()) buffer.resize(buffer.size() * 2);
+
+			size_t Read = fread(buffer.data() + end, 1, buffer.size() - end - 1, file);
+			end += Read;
+			if (Read == 0) eof = true;
+		}
+	}
+
+	// reads Size raw bytes following the lines consumed so far
+	bool ReadBytes(void* pOut, size_t Size)
+	{
+		size_t Buffered = std::min(Size, end - begin);
+		memcpy(pOut, buffer.data() + begin, Buffered);
+		begin += Buffered;
+		return Buffered == Size || fread((char*)pOut + Buffered, 1, Size - Buffered, file) == Size - Buffered;
+	}
+};
+
+namespace MeshConverterDetail
+{
+	// fopen is deprecated by the MSVC runtime
+	inline FILE* OpenFile(const char* pFileName, const char* pMode)
+	{
+#ifdef _MSC_VER
+		FILE* File = nullptr;
+		return fopen_s(&File, pFileName, pMode) == 0 ? File : nullptr;
+#else
+		return fopen(pFileName, pMode);
+#endif
+	}
+
+	// splits a header line into up to MaxWords words, returns how many were found
+	inline int SplitWords(char* p, std::string* pWords, int MaxWords)
+	{
+		int Count = 0;
+		while (Count < MaxWords)
+		{
+			while (*p == ' ' || *p == '\t') p++;
+			if (*p == 0) break;
+			char* pStart = p;
+			while (*p != 0 && *p != ' ' && *p != '\t') p++;
+			pWords[Count++].assign(pStart, p);
+		}
+		return Count;
+	}
+
+	struct ObjCorner
+	{
+		int Position, TexCoord, Normal;
+
+		bool operator==(const ObjCorner& Other) const
+		{
+			return Position == Other.Position && TexCoord == Other.TexCoord && Normal == Other.Normal;
+		}
+	};
+
+	struct ObjCornerHash
+	{
+		size_t operator()(const ObjCorner& c) const
+		{
+			uint64_t h = (uint64_t)(uint32_t)c.Position * 0x9E3779B97F4A7C15ull;
+			h ^= (uint64_t)(uint32_t)c.TexCoord * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+			h ^= (uint64_t)(uint32_t)c.Normal * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+			return (size_t)h;
+		}
+	};
+
+	// OBJ indices start at 1, negative ones count back from the last element
+	inline int ObjIndex(long Value, size_t Count)
+	{
+		if (Value > 0) return (int)(Value - 1);
+		if (Value < 0) return (int)((long)Count + Value);
+		return -1;
+	}
+
+	inline bool ParseObjCorner(char*& p, size_t NumPositions, size_t NumTexCoords, size_t NumNormals, ObjCorner& Corner)
+	{
+		while (*p == ' ' || *p == '\t') p++;
+		if (*p == 0) return false;
+
+		char* pEnd;
+		Corner.Position = ObjIndex(strtol(p, &pEnd, 10), NumPositions);
+		Corner.TexCoord = -1;
+		Corner.Normal = -1;
+		if (pEnd == p) return false;
+		p = pEnd;
+
+		if (*p == '/')
+		{
+			p++;
+			if (*p != '/')
+			{
+				Corner.TexCoord = ObjIndex(strtol(p, &pEnd, 10), NumTexCoords);
+				p = pEnd;
+			}
+			if (*p == '/')
+			{
+				p++;
+				Corner.Normal = ObjIndex(strtol(p, &pEnd, 10), NumNormals);
+				p = pEnd;
+			}
+		}
+		while (*p != 0 && *p != ' ' && *p != '\t') p++;
+		return true;
+	}
+
+	enum PLY_TYPE { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID };
+
+	inline PLY_TYPE PlyType(const char* pName)
+	{
+		static const char* Names[][2] = { { "char", "int8" }, { "uchar", "uint8" }, { "short", "int16" }, { "ushort", "uint16" },
+			{ "int", "int32" }, { "uint", "uint32" }, { "float", "float32" }, { "double", "float64" } };
+		for (int i = 0; i < PLY_INVALID; i++)
+		{
+			if (strcmp(pName, Names[i][0]) == 0 || strcmp(pName, Names[i][1]) == 0) return (PLY_TYPE)i;
+		}
+		return PLY_INVALID;
+	}
+
+	inline size_t PlyTypeSize(PLY_TYPE Type)
+	{
+		static const size_t Sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+		return Sizes[Type];
+	}
+
+	inline double PlyDecode(const unsigned char* p, PLY_TYPE Type)
+	{
+		switch (Type)
+		{
+		case PLY_INT8: { int8_t v; memcpy(&v, p, 1); return v; }
+		case PLY_UINT8: return *p;
+		case PLY_INT16: { int16_t v; memcpy(&v, p, 2); return v; }
+		case PLY_UINT16: { uint16_t v; memcpy(&v, p, 2); return v; }
+		case PLY_INT32: { int32_t v; memcpy(&v, p, 4); return v; }
+		case PLY_UINT32: { uint32_t v; memcpy(&v, p, 4); return v; }
+		case PLY_FLOAT32: { float v; memcpy(&v, p, 4); return v; }
+		case PLY_FLOAT64: { double v; memcpy(&v, p, 8); return v; }
+		default: return 0.0;
+		}
+	}
+
+	struct PlyProperty
+	{
+		std::string Name;
+		PLY_TYPE Type;
+		PLY_TYPE CountType; // PLY_INVALID for scalar properties
+	};
+
+	struct PlyElement
+	{
+		std::string Name;
+		size_t Count;
+		std::vector<PlyProperty> Properties;
+	};
+
+	// one value of the next element, from text or binary little endian input
+	class PlyReader
+	{
+	private:
+		LineReader& reader;
+		bool binary;
+		char* line; // rest of the current text line
+
+	public:
+		PlyReader(LineReader& Reader, bool Binary) : reader(Reader), binary(Binary), line(nullptr) { }
+
+		bool BeginElement()
+		{
+			if (binary) return true;
+			line = reader.Next();
+			return line != nullptr;
+		}
+
+		bool Read(PLY_TYPE Type, double& Value)
+		{
+			if (binary)
+			{
+				unsigned char Bytes[8];
+				if (!reader.ReadBytes(Bytes, PlyTypeSize(Type))) return false;
+				Value = PlyDecode(Bytes, Type);
+				return true;
+			}
+
+			char* pEnd;
+			Value = strtod(line, &pEnd);
+			if (pEnd == line) return false;
+			line = pEnd;
+			return true;
+		}
+	};
+}
+
+inline bool LoadOBJ(const char* pFileName, MeshData& Out)
+{
+	using namespace MeshConverterDetail;
+
+	FILE* File = OpenFile(pFileName, "rb");
+	if (File == nullptr)
+	{
+		std::cerr << "Error opening '" << pFileName << "'\n";
+		return false;
+	}
+
+	std::vector<glm::vec3> Positions;
+	std::vector<glm::vec2> TexCoords;
+	std::vector<glm::vec3> Normals;
+	std::unordered_map<ObjCorner, unsigned int, ObjCornerHash> Corners; // every distinct v/vt/vn triple is one vertex
+	std::vector<unsigned int> Polygon;
+
+	Out = MeshData();
+	Out.HasNormals = true;
+
+	LineReader Reader(File);
+	bool Valid = true;
+	for (char* p = Reader.Next(); p != nullptr && Valid; p = Reader.Next())
+	{
+		while (*p == ' ' || *p == '\t') p++;
+
+		if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			glm::vec3 v;
+			v.x = strtof(p + 2, &p); v.y = strtof(p, &p); v.z = strtof(p, &p);
+			Positions.push_back(v);
+		}
+		else if (p[0] == 'v' && p[1] == 't')
+		{
+			glm::vec2 t;
+			t.x = strtof(p + 2, &p); t.y = 1.0f - strtof(p, &p);
+			TexCoords.push_back(t);
+		}
+		else if (p[0] == 'v' && p[1] == 'n')
+		{
+			glm::vec3 n;
+			n.x = strtof(p + 2, &p); n.y = strtof(p, &p); n.z = strtof(p, &p);
+			Normals.push_back(n);
+		}
+		else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			p++;
+			Polygon.clear();
+
+			ObjCorner Corner;
+			while (ParseObjCorner(p, Positions.size(), TexCoords.size(), Normals.size(), Corner))
+			{
+				if (Corner.Position < 0 || Corner.Position >= (int)Positions.size() || Corner.TexCoord >= (int)TexCoords.size() ||
+					Corner.Normal >= (int)Normals.size())
+				{
+					Valid = false;
+					break;
+				}
+
+				auto Found = Corners.find(Corner);
+				if (Found == Corners.end())
+				{
+					Vertex v(Positions[Corner.Position], Corner.TexCoord >= 0 ? TexCoords[Corner.TexCoord] : glm::vec2(0.0f, 0.0f));
+					if (Corner.Normal >= 0) v.m_normal = Normals[Corner.Normal];
+					else Out.HasNormals = false;
+
+					Found = Corners.emplace(Corner, (unsigned int)Out.Vertices.size()).first;
+					Out.Vertices.push_back(v);
+				}
+				Polygon.push_back(Found->second);
+			}
+
+			// polygons become triangle fans
+			for (size_t i = 2; i < Polygon.size(); i++)
+			{
+				Out.Indices.push_back(Polygon[0]);
+				Out.Indices.push_back(Polygon[i - 1]);
+				Out.Indices.push_back(Polygon[i]);
+			}
+		}
+	}
+	fclose(File);
+
+	if (!Valid) std::cerr << "Invalid face in '" << pFileName << "'\n";
+	return Valid;
+}
+
+inline bool LoadPLY(const char* pFileName, MeshData& Out)
+{
+	using namespace MeshConverterDetail;
+
+	FILE* File = OpenFile(pFileName, "rb");
+	if (File == nullptr)
+	{
+		std::cerr << "Error opening '" << pFileName << "'\n";
+		return false;
+	}
+
+	LineReader Reader(File);
+	std::vector<PlyElement> Elements;
+	bool Binary = false, Valid = true;
+
+	char* p = Reader.Next();
+	if (p == nullptr || strcmp(p, "ply") != 0) Valid = false;
+
+	while (Valid && (p = Reader.Next()) != nullptr && strcmp(p, "end_header") != 0)
+	{
+		std::string Word[5];
+		int Fields = SplitWords(p, Word, 5);
+
+		if (Word[0] == "format")
+		{
+			if (Word[1] == "binary_little_endian") Binary = true;
+			else if (Word[1] != "ascii") Valid = false; // big endian is not supported
+		}
+		else if (Word[0] == "element" && Fields >= 3)
+		{
+			PlyElement e;
+			e.Name = Word[1];
+			e.Count = (size_t)strtoull(Word[2].c_str(), nullptr, 10);
+			Elements.push_back(e);
+		}
+		else if (Word[0] == "property" && !Elements.empty())
+		{
+			// property <type> <name> or property list <count type> <type> <name>
+			bool List = Word[1] == "list";
+			PlyProperty Prop;
+			Prop.CountType = List ? PlyType(Word[2].c_str()) : PLY_INVALID;
+			Prop.Type = PlyType((List ? Word[3] : Word[1]).c_str());
+			Prop.Name = List ? Word[4] : Word[2];
+
+			if (Prop.Type == PLY_INVALID || (List && (Fields < 5 || Prop.CountType == PLY_INVALID))) Valid = false;
+			Elements.back().Properties.push_back(Prop);
+		}
+	}
+	if (p == nullptr) Valid = false;
+
+	Out = MeshData();
+	PlyReader Values(Reader, Binary);
+
+	for (size_t e = 0; e < Elements.size() && Valid; e++)
+	{
+		const PlyElement& Element = Elements[e];
+		bool IsVertex = Element.Name == "vertex", IsFace = Element.Name == "face";
+
+		// where each vertex property goes: 0-2 position, 3-4 texture, 5-7 normal
+		std::vector<int> Slot(Element.Properties.size(), -1);
+		if (IsVertex)
+		{
+			const char* SlotNames[][3] = { { "x" }, { "y" }, { "z" }, { "u", "s", "texture_u" }, { "v", "t", "texture_v" },
+				{ "nx" }, { "ny" }, { "nz" } };
+			for (size_t i = 0; i < Element.Properties.size(); i++)
+			{
+				for (int s = 0; s < 8; s++)
+				{
+					for (int n = 0; n < 3 && SlotNames[s][n] != nullptr; n++)
+					{
+						if (Element.Properties[i].Name == SlotNames[s][n]) Slot[i] = s;
+					}
+				}
+				if (Slot[i] == 5) Out.HasNormals = true;
+			}
+			Out.Vertices.reserve(Element.Count);
+		}
+
+		std::vector<unsigned int> Polygon;
+		for (size_t i = 0; i < Element.Count && Valid; i++)
+		{
+			if (!Values.BeginElement())
+			{
+				Valid = false;
+				break;
+			}
+
+			float Attributes[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+			for (size_t k = 0; k < Element.Properties.size() && Valid; k++)
+			{
+				const PlyProperty& Prop = Element.Properties[k];
+				double Value;
+
+				if (Prop.CountType == PLY_INVALID)
+				{
+					Valid = Values.Read(Prop.Type, Value);
+					if (Slot[k] >= 0) Attributes[Slot[k]] = (float)Value;
+					continue;
+				}
+
+				double Count;
+				Valid = Values.Read(Prop.CountType, Count);
+				bool IsIndices = IsFace && (Prop.Name == "vertex_indices" || Prop.Name == "vertex_index");
+				Polygon.clear();
+				for (size_t j = 0; j < (size_t)Count && Valid; j++)
+				{
+					Valid = Values.Read(Prop.Type, Value);
+					if (IsIndices) Polygon.push_back((unsigned int)Value);
+				}
+
+				for (size_t j = 2; j < Polygon.size(); j++)
+				{
+					Out.Indices.push_back(Polygon[0]);
+					Out.Indices.push_back(Polygon[j - 1]);
+					Out.Indices.push_back(Polygon[j]);
+				}
+			}
+
+			if (IsVertex)
+			{
+				Vertex v(glm::vec3(Attributes[0], Attributes[1], Attributes[2]), glm::vec2(Attributes[3], 1.0f - Attributes[4]));
+				v.m_normal = glm::vec3(Attributes[5], Attributes[6], Attributes[7]);
+				Out.Vertices.push_back(v);
+			}
+		}
+	}
+	fclose(File);
+
+	for (size_t i = 0; i < Out.Indices.size() && Valid; i++)
+	{
+		if (Out.Indices[i] >= Out.Vertices.size()) Valid = false;
+	}
+
+	if (!Valid) std::cerr << "Invalid or unsupported PLY file '" << pFileName << "'\n";
+	return Valid;
+}
+
+// writes Data in the .mesh format, the vertices are converted to Layout in small batches
+inline bool WriteMeshFile(const char* pFileName, const MeshData& Data, VERTEX_LAYOUT Layout)
+{
+	if (Data.Vertices.size() > 0xFFFFFFFFu || Data.Indices.size() > 0xFFFFFFFFu)
+	{
+		std::cerr << "Mesh is too large for 32-bit indices\n";
+		return false;
+	}
+
+	MeshFileHeader Header;
+	memcpy(Header.Magic, MESH_FILE_MAGIC, sizeof(Header.Magic));
+	Header.Version = MESH_FILE_VERSION;
+	Header.Layout = Layout;
+	Header.VertexSize = (uint32_t)Mesh::GetVertexSize(Layout);
+	Header.VertexCount = Data.Vertices.size();
+	Header.IndexCount = Data.Indices.size();
+
+	glm::vec3 Min(FLT_MAX, FLT_MAX, FLT_MAX), Max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (const Vertex& v : Data.Vertices)
+	{
+		Min = glm::min(Min, v.m_pos);
+		Max = glm::max(Max, v.m_pos);
+	}
+	if (Data.Vertices.empty()) Min = Max = glm::vec3(0.0f, 0.0f, 0.0f);
+	Header.BoundsMin[0] = Min.x; Header.BoundsMin[1] = Min.y; Header.BoundsMin[2] = Min.z;
+	Header.BoundsMax[0] = Max.x; Header.BoundsMax[1] = Max.y; Header.BoundsMax[2] = Max.z;
+
+	auto Align = [](uint64_t Offset) { return (Offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT; };
+	Header.VertexOffset = Align(sizeof(MeshFileHeader));
+	Header.IndexOffset = Align(Header.VertexOffset + Header.VertexCount * Header.VertexSize);
+
+	FILE* File = MeshConverterDetail::OpenFile(pFileName, "wb");
+	if (File == nullptr)
+	{
+		std::cerr << "Error creating '" << pFileName << "'\n";
+		return false;
+	}
+
+	static const char Zeros[MESH_FILE_ALIGNMENT] = { 0 };
+	bool Ok = fwrite(&Header, sizeof(Header), 1, File) == 1;
+	Ok = Ok && fwrite(Zeros, 1, (size_t)(Header.VertexOffset - sizeof(Header)), File) == Header.VertexOffset - sizeof(Header);
+
+	if (Layout == VERTEX_LAYOUT_COMPACT)
+	{
+		std::vector<CompactVertex> Batch;
+		for (size_t First = 0; First < Data.Vertices.size() && Ok; First += 65536)
+		{
+			size_t Last = std::min(First + 65536, Data.Vertices.size());
+			Batch.resize(Last - First);
+			for (size_t i = First; i < Last; i++) Batch[i - First] = MakeCompactVertex(Data.Vertices[i]);
+			Ok = fwrite(Batch.data(), sizeof(CompactVertex), Batch.size(), File) == Batch.size();
+		}
+	}
+	else if (!Data.Vertices.empty())
+	{
+		Ok = Ok && fwrite(Data.Vertices.data(), sizeof(Vertex), Data.Vertices.size(), File) == Data.Vertices.size();
+	}
+
+	uint64_t Written = Header.VertexOffset + Header.VertexCount * Header.VertexSize;
+	Ok = Ok && fwrite(Zeros, 1, (size_t)(Header.IndexOffset - Written), File) == Header.IndexOffset - Written;
+	if (!Data.Indices.empty())
+	{
+		Ok = Ok && fwrite(Data.Indices.data(), sizeof(unsigned int), Data.Indices.size(), File) == Data.Indices.size();
+	}
+
+	Ok = fclose(File) == 0 && Ok;
+	if (!Ok) std::cerr << "Error writing '" << pFileName << "'\n";
+	return Ok;
+}
+
+// OBJ or PLY (by extension) -> .mesh
+inline bool ConvertMesh(const char* pSrcFileName, const char* pDstFileName, VERTEX_LAYOUT Layout)
+{
+	std::string Name = pSrcFileName;
+	std::string Extension = Name.substr(Name.find_last_of('.') + 1);
+	for (char& c : Extension) c = (char)tolower((unsigned char)c);
+
+	MeshData Data;
+	bool Loaded;
+	if (Extension == "obj") Loaded = LoadOBJ(pSrcFileName, Data);
+	else if (Extension == "ply") Loaded = LoadPLY(pSrcFileName, Data);
+	else
+	{
+		std::cerr << "Unknown mesh format '" << pSrcFileName << "', expected .obj or .ply\n";
+		return false;
+	}
+	if (!Loaded) return false;
+
+	if (!Data.HasNormals)
+	{
+		JobSystem Jobs;
+		GenerateNormals(Data.Indices.data(), (unsigned int)Data.Indices.size(), Data.Vertices.data(), (unsigned int)Data.Vertices.size(), &Jobs);
+	}
+
+	if (!WriteMeshFile(pDstFileName, Data, Layout)) return false;
+
+	std::cout << pSrcFileName << " -> " << pDstFileName << ": " << Data.Vertices.size() << " vertices, "
+		<< Data.Indices.size() / 3 << " triangles" << (Data.HasNormals ? "" : ", normals generated") << "\n";
+	return true;
+}
@@ -0,0 +1,246 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "Mesh.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Binary mesh file (.mesh), written by ConvertMesh (MeshConverter.h):
+//   MeshFileHeader
+//   vertex block - VertexCount vertices in the layout of the header, at VertexOffset
+//   index block  - IndexCount 32-bit triangle indices, at IndexOffset
+// The blocks are in the exact format of the GL buffers, so loading is a copy
+// from the file straight into the buffer objects.
+const char MESH_FILE_MAGIC[4] = { 'M', 'S', 'H', 'B' };
+const uint32_t MESH_FILE_VERSION = 1;
+const size_t MESH_FILE_ALIGNMENT = 16; // blocks start at multiples of this
+const size_t MESH_STREAM_CHUNK = 8 << 20; // bytes mapped at once while loading
+
+struct MeshFileHeader
+{
+	char Magic[4];
+	uint32_t Version;
+	uint32_t Layout; // VERTEX_LAYOUT
+	uint32_t VertexSize;
+	uint64_t VertexCount;
+	uint64_t IndexCount;
+	uint64_t VertexOffset;
+	uint64_t IndexOffset;
+	float BoundsMin[3];
+	float BoundsMax[3];
+};
+
+static_assert(sizeof(MeshFileHeader) == 72, "MeshFileHeader layout is part of the file format");
+
+// Read-only file that maps one window of itself at a time; the address space and
+// the resident set stay at the window size no matter how large the file is.
+class MappedFile
+{
+private:
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int file;
+#endif
+	uint64_t size;
+	void* view; // start of the mapped window (aligned down)
+	size_t viewSize;
+
+public:
+	MappedFile()
+	{
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = nullptr;
+#else
+		file = -1;
+#endif
+		size = 0;
+		view = nullptr;
+		viewSize = 0;
+	}
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	bool Open(const char* pFileName)
+	{
+		Close();
+#ifdef _WIN32
+		file = CreateFileA(pFileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER FileSize;
+		if (!GetFileSizeEx(file, &FileSize)) return false;
+		size = (uint64_t)FileSize.QuadPart;
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		return mapping != nullptr;
+#else
+		file = open(pFileName, O_RDONLY);
+		if (file < 0) return false;
+
+		struct stat Info;
+		if (fstat(file, &Info) != 0) return false;
+		size = (uint64_t)Info.st_size;
+		return true;
+#endif
+	}
+
+	void Close()
+	{
+		Unmap();
+#ifdef _WIN32
+		if (mapping != nullptr) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (file >= 0) close(file);
+		file = -1;
+#endif
+		size = 0;
+	}
+
+	uint64_t GetSize() const
+	{
+		return size;
+	}
+
+	// maps [Offset, Offset + Size) in place of the previous window, returns its first byte
+	const unsigned char* Map(uint64_t Offset, size_t Size)
+	{
+		Unmap();
+		if (Size == 0 || Offset > size || Size > size - Offset) return nullptr; // Offset + Size could wrap
+
+		uint64_t Start = Offset - Offset % Granularity();
+		viewSize = (size_t)(Offset - Start) + Size;
+#ifdef _WIN32
+		view = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(Start >> 32), (DWORD)(Start & 0xFFFFFFFF), viewSize);
+		if (view == nullptr) return nullptr;
+#else
+		view = mmap(nullptr, viewSize, PROT_READ, MAP_PRIVATE, file, (off_t)Start);
+		if (view == MAP_FAILED)
+		{
+			view = nullptr;
+			return nullptr;
+		}
+		madvise(view, viewSize, MADV_SEQUENTIAL);
+#endif
+		return (const unsigned char*)view + (Offset - Start);
+	}
+
+	void Unmap()
+	{
+		if (view == nullptr) return;
+#ifdef _WIN32
+		UnmapViewOfFile(view);
+#else
+		munmap(view, viewSize);
+#endif
+		view = nullptr;
+		viewSize = 0;
+	}
+
+private:
+	static uint64_t Granularity()
+	{
+#ifdef _WIN32
+		SYSTEM_INFO Info;
+		GetSystemInfo(&Info);
+		return Info.dwAllocationGranularity;
+#else
+		return (uint64_t)sysconf(_SC_PAGESIZE);
+#endif
+	}
+};
+
+inline bool ReadMeshFileHeader(MappedFile& File, MeshFileHeader& Header)
+{
+	const unsigned char* pData = File.Map(0, sizeof(MeshFileHeader));
+	if (pData == nullptr) return false;
+	memcpy(&Header, pData, sizeof(Header));
+	File.Unmap();
+
+	if (memcmp(Header.Magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC)) != 0 || Header.Version != MESH_FILE_VERSION) return false;
+	if (Header.Layout != VERTEX_LAYOUT_FULL && Header.Layout != VERTEX_LAYOUT_COMPACT) return false;
+	if (Header.VertexSize != (uint32_t)Mesh::GetVertexSize((VERTEX_LAYOUT)Header.Layout)) return false;
+	if (Header.VertexCount > 0xFFFFFFFFu || Header.IndexCount > 0xFFFFFFFFu || Header.IndexCount % 3 != 0) return false;
+
+	// both blocks inside the file; the sizes cannot overflow (32-bit counts, a vertex size of the
+	// layout), but a 64-bit offset can, so the offset and the size are checked against the file apart
+	uint64_t FileSize = File.GetSize();
+	uint64_t VertexBytes = Header.VertexCount * Header.VertexSize;
+	uint64_t IndexBytes = Header.IndexCount * sizeof(uint32_t);
+	return Header.VertexOffset >= sizeof(MeshFileHeader) && Header.IndexOffset >= sizeof(MeshFileHeader) &&
+		Header.VertexOffset <= FileSize && VertexBytes <= FileSize - Header.VertexOffset &&
+		Header.IndexOffset <= FileSize && IndexBytes <= FileSize - Header.IndexOffset;
+}
+
+// Streams a .mesh file into Target, ChunkSize bytes at a time: every chunk is mapped,
+// handed to glBufferSubData and unmapped, there is no intermediate copy in memory.
+// Index values are not checked against VertexCount, the file is trusted to be
+// produced by ConvertMesh.
+inline bool LoadMeshFile(const char* pFileName, Mesh& Target, size_t ChunkSize = MESH_STREAM_CHUNK)
+{
+	MappedFile File;
+	if (!File.Open(pFileName))
+	{
+		std::cerr << "Error opening mesh file '" << pFileName << "'\n";
+		return false;
+	}
+
+	MeshFileHeader Header;
+	if (!ReadMeshFileHeader(File, Header))
+	{
+		std::cerr << "Invalid mesh file '" << pFileName << "'\n";
+		return false;
+	}
+
+	if (!Target.Allocate((unsigned int)Header.VertexCount, (unsigned int)Header.IndexCount, (VERTEX_LAYOUT)Header.Layout)) return false;
+
+	ChunkSize = std::max(ChunkSize, (size_t)1 << 16);
+	uint64_t Sizes[2] = { Header.VertexCount * Header.VertexSize, Header.IndexCount * sizeof(uint32_t) };
+	uint64_t Offsets[2] = { Header.VertexOffset, Header.IndexOffset };
+
+	for (int Block = 0; Block < 2; Block++)
+	{
+		for (uint64_t Done = 0; Done < Sizes[Block]; Done += ChunkSize)
+		{
+			size_t Size = (size_t)std::min((uint64_t)ChunkSize, Sizes[Block] - Done);
+			const unsigned char* pData = File.Map(Offsets[Block] + Done, Size);
+			if (pData == nullptr)
+			{
+				std::cerr << "Error mapping mesh file '" << pFileName << "'\n";
+				return false;
+			}
+
+			if (Block == 0) Target.UploadVertices((size_t)Done, pData, Size);
+			else Target.UploadIndices((size_t)Done, pData, Size);
+		}
+	}
+	File.Unmap();
+
+	Target.SetBounds(glm::vec3(Header.BoundsMin[0], Header.BoundsMin[1], Header.BoundsMin[2]),
+		glm::vec3(Header.BoundsMax[0], Header.BoundsMax[1], Header.BoundsMax[2]));
+
+	return glGetError() == GL_NO_ERROR;
+}
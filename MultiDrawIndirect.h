@@ -0,0 +1,189 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <cfloat>
+#include <algorithm>
+#include "Mesh.h"
+#include "Instancing.h"
+#include "RenderQueue.h"
+#include "Profiler.h"
+
+// where one mesh of a MeshPool lies in the shared buffers
+struct MeshRange
+{
+	unsigned int FirstIndex;
+	unsigned int IndexCount;
+	int BaseVertex; // added to its indices, which stay as they were in the mesh
+};
+
+// Static meshes of one vertex layout merged into one vertex and one index buffer with
+// one VAO, so draws of different meshes need no bind in between and one indirect call
+// can draw them all. Slot i is the i-th mesh given to Build, the mesh slot of render keys.
+class MeshPool
+{
+private:
+	Mesh mesh;
+	std::vector<MeshRange> ranges;
+
+public:
+	bool Build(const Mesh* const* pMeshes, unsigned int Count)
+	{
+		ranges.clear();
+		if (Count == 0) return false;
+
+		VERTEX_LAYOUT Layout = pMeshes[0]->GetLayout();
+		unsigned int Vertices = 0, Indices = 0;
+		glm::vec3 Min(FLT_MAX), Max(-FLT_MAX);
+		for (unsigned int i = 0; i < Count; i++)
+		{
+			if (pMeshes[i]->GetLayout() != Layout)
+			{
+				std::cerr << "Mesh " << i << " has a vertex layout different from the rest of the pool\n";
+				return false;
+			}
+			MeshRange Range = { Indices, pMeshes[i]->GetIndexCount(), (int)Vertices };
+			ranges.push_back(Range);
+			Vertices += pMeshes[i]->GetVertexCount();
+			Indices += pMeshes[i]->GetIndexCount();
+			Min = glm::min(Min, pMeshes[i]->GetBoundsMin());
+			Max = glm::max(Max, pMeshes[i]->GetBoundsMax());
+		}
+
+		if (!mesh.Allocate(Vertices, Indices, Layout)) return false;
+		for (unsigned int i = 0; i < Count; i++) mesh.CopyFrom(*pMeshes[i], (unsigned int)ranges[i].BaseVertex, ranges[i].FirstIndex);
+		mesh.SetBounds(Min, Max);
+		return glGetError() == GL_NO_ERROR;
+	}
+
+	const MeshRange& GetRange(unsigned int Slot) const
+	{
+		return ranges[Slot];
+	}
+
+	unsigned int GetCount() const
+	{
+		return (unsigned int)ranges.size();
+	}
+
+	void Bind() const
+	{
+		mesh.Bind();
+	}
+};
+
+// the layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand
+{
+	GLuint Count;
+	GLuint InstanceCount;
+	GLuint FirstIndex;
+	GLint BaseVertex;
+	GLuint BaseInstance;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand must match the GL layout");
+
+// The draws of a pass as commands in a GL_DRAW_INDIRECT_BUFFER, drawn from a MeshPool
+// by one glMultiDrawElementsIndirect. A command draws a run of consecutive instances of
+// the same mesh; BaseInstance is the first of them, so the per instance attributes of an
+// InstanceBuffer bound at 0 give every draw its world matrix and texture layer and the
+// instanced shaders need no change. Without GL 4.3 or ARB_multi_draw_indirect the same
+// commands are drawn one glDrawElementsInstancedBaseVertex each, with the instance
+// attributes rebound at BaseInstance.
+class IndirectDrawBuffer
+{
+private:
+	GLuint buffer;
+	unsigned int capacity; // commands the buffer storage holds
+	std::vector<DrawElementsIndirectCommand> commands; // of the last Upload
+	bool supported;
+
+public:
+	IndirectDrawBuffer()
+	{
+		buffer = 0;
+		capacity = 0;
+		supported = false;
+	}
+
+	~IndirectDrawBuffer()
+	{
+		if (buffer != 0) glDeleteBuffers(1, &buffer);
+	}
+
+	bool Init()
+	{
+		supported = (GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance)) != 0;
+		if (!supported) return true;
+
+		glGenBuffers(1, &buffer);
+		return buffer != 0;
+	}
+
+	bool IsSupported() const
+	{
+		return supported;
+	}
+
+	// Commands for the instances in the order of the sorted Queue (instance i is item i):
+	// a new command wherever the mesh slot changes. Only reads, so it runs in the frame jobs
+	static void BuildCommands(const MeshPool& Pool, const RenderQueue& Queue, std::vector<DrawElementsIndirectCommand>& Out)
+	{
+		Out.clear();
+		unsigned int Count = Queue.GetCount();
+		for (unsigned int First = 0; First < Count;)
+		{
+			unsigned int Slot = RenderQueue::GetMesh(Queue.GetKey(First));
+			unsigned int Last = First + 1;
+			while (Last < Count && RenderQueue::GetMesh(Queue.GetKey(Last)) == Slot) Last++;
+
+			const MeshRange& Range = Pool.GetRange(Slot);
+			DrawElementsIndirectCommand Command = { Range.IndexCount, Last - First, Range.FirstIndex, Range.BaseVertex, First };
+			Out.push_back(Command);
+			First = Last;
+		}
+	}
+
+	// replaces the commands, the old storage is orphaned as in InstanceBuffer::Upload
+	void Upload(const std::vector<DrawElementsIndirectCommand>& Commands)
+	{
+		commands = Commands;
+		if (!supported) return;
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+		if (commands.size() > capacity)
+		{
+			capacity = std::max((unsigned int)commands.size(), capacity + capacity / 2);
+		}
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+		if (!commands.empty()) glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	// the pool and Instances (at 0) must be bound
+	void Draw(InstanceBuffer& Instances) const
+	{
+		if (commands.empty()) return;
+
+		if (supported)
+		{
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, (GLsizei)commands.size(), 0);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			Profiler::Get().Count(PROFILE_DRAW_CALLS);
+			return;
+		}
+
+		for (const DrawElementsIndirectCommand& Command : commands)
+		{
+			Instances.Bind(Command.BaseInstance);
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, Command.Count, GL_UNSIGNED_INT,
+				(const GLvoid*)(sizeof(unsigned int) * Command.FirstIndex), Command.InstanceCount, Command.BaseVertex);
+			Profiler::Get().Count(PROFILE_DRAW_CALLS);
+		}
+		Instances.Bind();
+	}
+};
@@ -0,0 +1,217 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include "Mesh.h"
+#include "JobSystem.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NORMAL_GENERATION_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Smooth vertex normals and tangents for indexed triangle meshes.
+//  1. face normals, cross(p1 - p0, p2 - p0): its length is twice the triangle area,
+//     so the sum below is area weighted; faces are split across jobs
+//  2. vertex -> face adjacency in CSR form (offsets + face list), built with atomic
+//     counters; every vertex sorts its own short list so the sums do not depend on
+//     the thread timing
+//  3. every vertex sums the normals of its faces (a gather, no two jobs write the
+//     same vertex) and the sums are normalized 4 at a time with SSE2
+const unsigned int NORMAL_JOB_SIZE = 16384; // triangles or vertices per job
+
+// the faces around every vertex: Faces[Offsets[v] .. Offsets[v + 1])
+struct VertexFaceAdjacency
+{
+	std::vector<unsigned int> Offsets;
+	std::vector<unsigned int> Faces;
+};
+
+namespace NormalGenerationDetail
+{
+	// runs Func over [0, Count) in NORMAL_JOB_SIZE pieces, on the calling thread without a job system
+	template <class F> void ForRange(JobSystem* pJobs, unsigned int Count, F Func)
+	{
+		if (pJobs == nullptr || Count <= NORMAL_JOB_SIZE)
+		{
+			Func(0u, Count);
+			return;
+		}
+
+		JobCounter Done;
+		pJobs->ParallelFor(Done, Count, NORMAL_JOB_SIZE, Func);
+		pJobs->Wait(Done);
+	}
+
+	// x, y, z /= length, zero vectors stay zero
+	inline void Normalize(float* x, float* y, float* z, unsigned int First, unsigned int Last)
+	{
+		unsigned int i = First;
+#ifdef NORMAL_GENERATION_SSE
+		const __m128 Zero = _mm_setzero_ps();
+		for (; i + 4 <= Last; i += 4)
+		{
+			__m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+			__m128 Length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+			__m128 NonZero = _mm_cmpgt_ps(Length, Zero);
+			__m128 Inverse = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), Length), NonZero);
+			_mm_storeu_ps(x + i, _mm_mul_ps(vx, Inverse));
+			_mm_storeu_ps(y + i, _mm_mul_ps(vy, Inverse));
+			_mm_storeu_ps(z + i, _mm_mul_ps(vz, Inverse));
+		}
+#endif
+		for (; i < Last; i++)
+		{
+			float Length = sqrtf(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+			float Inverse = Length > 0.0f ? 1.0f / Length : 0.0f;
+			x[i] *= Inverse;
+			y[i] *= Inverse;
+			z[i] *= Inverse;
+		}
+	}
+}
+
+inline void BuildVertexFaceAdjacency(const unsigned int* pIndices, unsigned int IndexCount, unsigned int VertexCount,
+	VertexFaceAdjacency& Adjacency, JobSystem* pJobs = nullptr)
+{
+	using namespace NormalGenerationDetail;
+	unsigned int FaceCount = IndexCount / 3;
+
+	std::vector<std::atomic<unsigned int> > Counts(VertexCount + 1);
+	ForRange(pJobs, VertexCount + 1, [&](unsigned int First, unsigned int Last)
+	{
+		for (unsigned int v = First; v < Last; v++) Counts[v].store(0, std::memory_order_relaxed);
+	});
+
+	ForRange(pJobs, FaceCount, [&](unsigned int First, unsigned int Last)
+	{
+		for (unsigned int i = First * 3; i < Last * 3; i++) Counts[pIndices[i]].fetch_add(1, std::memory_order_relaxed);
+	});
+
+	// exclusive prefix sum, Counts becomes the write cursor of every vertex
+	Adjacency.Offsets.resize(VertexCount + 1);
+	unsigned int Sum = 0;
+	for (unsigned int v = 0; v <= VertexCount; v++)
+	{
+		Adjacency.Offsets[v] = Sum;
+		Sum += Counts[v].load(std::memory_order_relaxed);
+		Counts[v].store(Adjacency.Offsets[v], std::memory_order_relaxed);
+	}
+
+	Adjacency.Faces.resize(Sum);
+	ForRange(pJobs, FaceCount, [&](unsigned int First, unsigned int Last)
+	{
+		for (unsigned int f = First; f < Last; f++)
+		{
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				Adjacency.Faces[Counts[pIndices[f * 3 + k]].fetch_add(1, std::memory_order_relaxed)] = f;
+			}
+		}
+	});
+
+	ForRange(pJobs, VertexCount, [&](unsigned int First, unsigned int Last)
+	{
+		for (unsigned int v = First; v < Last; v++)
+		{
+			std::sort(Adjacency.Faces.begin() + Adjacency.Offsets[v], Adjacency.Faces.begin() + Adjacency.Offsets[v + 1]);
+		}
+	});
+}
+
+// overwrites m_normal of every vertex with the area weighted average of the normals
+// of the triangles around it; vertices that no triangle uses get a zero normal
+inline void GenerateNormals(const unsigned int* pIndices, unsigned int IndexCount, Vertex* pVertices, unsigned int VertexCount,
+	JobSystem* pJobs = nullptr)
+{
+	using namespace NormalGenerationDetail;
+	unsigned int FaceCount = IndexCount / 3;
+
+	std::vector<glm::vec3> FaceNormals(FaceCount);
+	ForRange(pJobs, FaceCount, [&](unsigned int First, unsigned int Last)
+	{
+		for (unsigned int f = First; f < Last; f++)
+		{
+			const glm::vec3& p0 = pVertices[pIndices[f * 3]].m_pos;
+			FaceNormals[f] = glm::cross(pVertices[pIndices[f * 3 + 1]].m_pos - p0, pVertices[pIndices[f * 3 + 2]].m_pos - p0);
+		}
+	});
+
+	VertexFaceAdjacency Adjacency;
+	BuildVertexFaceAdjacency(pIndices, IndexCount, VertexCount, Adjacency, pJobs);
+
+	std::vector<float> x(VertexCount), y(VertexCount), z(VertexCount);
+	ForRange(pJobs, VertexCount, [&](unsigned int First, unsigned int Last)
+	{
+		for (unsigned int v = First; v < Last; v++)
+		{
+			glm::vec3 Sum(0.0f, 0.0f, 0.0f);
+			for (unsigned int i = Adjacency.Offsets[v]; i < Adjacency.Offsets[v + 1]; i++) Sum += FaceNormals[Adjacency.Faces[i]];
+			x[v] = Sum.x; y[v] = Sum.y; z[v] = Sum.z;
+		}
+
+		Normalize(x.data(), y.data(), z.data(), First, Last);
+		for (unsigned int v = First; v < Last; v++) pVertices[v].m_normal = glm::vec3(x[v], y[v], z[v]);
+	});
+}
+
+// Per-vertex tangents for normal mapping from the texture coordinate gradients of the
+// faces (area weighted like the normals), orthogonalized against m_normal, which must
+// already be set. w is the handedness: bitangent = w * cross(normal, tangent).
+inline void GenerateTangents(const unsigned int* pIndices, unsigned int IndexCount, const Vertex* pVertices, unsigned int VertexCount,
+	std::vector<glm::vec4>& Tangents, JobSystem* pJobs = nullptr)
+{
+	using namespace NormalGenerationDetail;
+	unsigned int FaceCount = IndexCount / 3;
+
+	// the unnormalized gradient times the uv area keeps the area weighting
+	std::vector<glm::vec3> FaceTangents(FaceCount), FaceBitangents(FaceCount);
+	ForRange(pJobs, FaceCount, [&](unsigned int First, unsigned int Last)
+	{
+		for (unsigned int f = First; f < Last; f++)
+		{
+			const Vertex& v0 = pVertices[pIndices[f * 3]];
+			const Vertex& v1 = pVertices[pIndices[f * 3 + 1]];
+			const Vertex& v2 = pVertices[pIndices[f * 3 + 2]];
+			glm::vec3 e1 = v1.m_pos - v0.m_pos, e2 = v2.m_pos - v0.m_pos;
+			glm::vec2 d1 = v1.m_tex - v0.m_tex, d2 = v2.m_tex - v0.m_tex;
+
+			float Det = d1.x * d2.y - d2.x * d1.y;
+			float Sign = Det < 0.0f ? -1.0f : 1.0f;
+			FaceTangents[f] = (e1 * d2.y - e2 * d1.y) * Sign;
+			FaceBitangents[f] = (e2 * d1.x - e1 * d2.x) * Sign;
+		}
+	});
+
+	VertexFaceAdjacency Adjacency;
+	BuildVertexFaceAdjacency(pIndices, IndexCount, VertexCount, Adjacency, pJobs);
+
+	Tangents.resize(VertexCount);
+	std::vector<float> x(VertexCount), y(VertexCount), z(VertexCount);
+	ForRange(pJobs, VertexCount, [&](unsigned int First, unsigned int Last)
+	{
+		for (unsigned int v = First; v < Last; v++)
+		{
+			glm::vec3 T(0.0f, 0.0f, 0.0f), B(0.0f, 0.0f, 0.0f);
+			for (unsigned int i = Adjacency.Offsets[v]; i < Adjacency.Offsets[v + 1]; i++)
+			{
+				T += FaceTangents[Adjacency.Faces[i]];
+				B += FaceBitangents[Adjacency.Faces[i]];
+			}
+
+			// Gram-Schmidt against the normal
+			const glm::vec3& N = pVertices[v].m_normal;
+			T -= N * glm::dot(N, T);
+			x[v] = T.x; y[v] = T.y; z[v] = T.z;
+			Tangents[v].w = glm::dot(glm::cross(N, T), B) < 0.0f ? -1.0f : 1.0f;
+		}
+
+		Normalize(x.data(), y.data(), z.data(), First, Last);
+		for (unsigned int v = First; v < Last; v++) Tangents[v] = glm::vec4(x[v], y[v], z[v], Tangents[v].w);
+	});
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <cmath>
+
+#include "NormalGeneration.h"
+
+// Side x Side wavy height field, two triangles per quad
+inline void BuildNormalTestMesh(unsigned int Side, std::vector<Vertex>& Vertices, std::vector<unsigned int>& Indices)
+{
+	Vertices.clear();
+	Indices.clear();
+	Vertices.reserve(Side * Side);
+	for (unsigned int z = 0; z < Side; z++)
+	{
+		for (unsigned int x = 0; x < Side; x++)
+		{
+			float fx = (float)x / Side, fz = (float)z / Side;
+			glm::vec3 Pos(fx * 10.0f, sinf(fx * 31.0f) * cosf(fz * 17.0f) * 0.5f, fz * 10.0f);
+			Vertices.push_back(Vertex(Pos, glm::vec2(fx, fz)));
+		}
+	}
+	for (unsigned int z = 0; z + 1 < Side; z++)
+	{
+		for (unsigned int x = 0; x + 1 < Side; x++)
+		{
+			unsigned int i = z * Side + x;
+			unsigned int Quad[6] = { i, i + Side, i + 1, i + 1, i + Side, i + Side + 1 };
+			Indices.insert(Indices.end(), Quad, Quad + 6);
+		}
+	}
+}
+
+// reference: scatter the face normals into the vertices one triangle after another, in double precision
+inline std::vector<double> ReferenceNormals(const std::vector<Vertex>& Vertices, const std::vector<unsigned int>& Indices)
+{
+	std::vector<double> Reference(Vertices.size() * 3, 0.0);
+	for (size_t i = 0; i + 2 < Indices.size(); i += 3)
+	{
+		glm::vec3 n = glm::cross(Vertices[Indices[i + 1]].m_pos - Vertices[Indices[i]].m_pos,
+			Vertices[Indices[i + 2]].m_pos - Vertices[Indices[i]].m_pos);
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			Reference[Indices[i + k] * 3 + 0] += n.x;
+			Reference[Indices[i + k] * 3 + 1] += n.y;
+			Reference[Indices[i + k] * 3 + 2] += n.z;
+		}
+	}
+	return Reference;
+}
+
+// largest angle between the vertex normals and the reference, in degrees
+inline double MaxNormalDeviation(const std::vector<double>& Reference, const std::vector<Vertex>& Vertices)
+{
+	double MaxAngle = 0.0;
+	for (size_t v = 0; v < Vertices.size(); v++)
+	{
+		const double* r = &Reference[v * 3];
+		double Length = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+		const glm::vec3& n = Vertices[v].m_normal;
+		double Cos = (r[0] * n.x + r[1] * n.y + r[2] * n.z) / Length;
+		MaxAngle = std::max(MaxAngle, acos(std::min(1.0, std::max(-1.0, Cos))) * 180.0 / 3.14159265358979);
+	}
+	return MaxAngle;
+}
+
+// largest |dot(N, T)|, 0 for tangents orthogonal to the normals
+inline float MaxTangentDot(const std::vector<glm::vec4>& Tangents, const std::vector<Vertex>& Vertices)
+{
+	float MaxDot = 0.0f;
+	for (size_t v = 0; v < Vertices.size(); v++)
+	{
+		MaxDot = std::max(MaxDot, fabsf(glm::dot(glm::vec3(Tangents[v].x, Tangents[v].y, Tangents[v].z), Vertices[v].m_normal)));
+	}
+	return MaxDot;
+}
+
+const double NORMAL_TEST_MAX_DEGREES = 0.1; // a float unit normal alone puts acos ~0.03 deg off
+const float NORMAL_TEST_MAX_TANGENT_DOT = 1e-3f;
+
+// GenerateNormals serially and with 4 worker threads, and GenerateTangents, on a fixed
+// 128 x 128 height field against the reference; prints what fails, true if nothing did
+inline bool TestNormalGeneration()
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+	BuildNormalTestMesh(128, Vertices, Indices);
+	unsigned int VertexCount = (unsigned int)Vertices.size(), IndexCount = (unsigned int)Indices.size();
+	std::vector<double> Reference = ReferenceNormals(Vertices, Indices);
+
+	bool Passed = true;
+	JobSystem Jobs(4);
+	JobSystem* Systems[2] = { nullptr, &Jobs };
+	for (JobSystem* pJobs : Systems)
+	{
+		GenerateNormals(Indices.data(), IndexCount, Vertices.data(), VertexCount, pJobs);
+		double Deviation = MaxNormalDeviation(Reference, Vertices);
+		if (!(Deviation <= NORMAL_TEST_MAX_DEGREES))
+		{
+			std::cerr << "GenerateNormals (" << (pJobs != nullptr ? "4 threads" : "serial") << "): normals deviate by "
+				<< Deviation << " deg from the reference, at most " << NORMAL_TEST_MAX_DEGREES << " allowed\n";
+			Passed = false;
+		}
+	}
+
+	std::vector<glm::vec4> Tangents;
+	GenerateTangents(Indices.data(), IndexCount, Vertices.data(), VertexCount, Tangents, &Jobs);
+	float Dot = Tangents.size() == Vertices.size() ? MaxTangentDot(Tangents, Vertices) : 1.0f;
+	if (!(Dot <= NORMAL_TEST_MAX_TANGENT_DOT))
+	{
+		std::cerr << "GenerateTangents: max |dot(N, T)| " << Dot << ", at most " << NORMAL_TEST_MAX_TANGENT_DOT << " allowed\n";
+		Passed = false;
+	}
+	return Passed;
+}
+
+// Checks GenerateNormals against the reference on a Side x Side height field (largest
+// angle between the two, in degrees) and GenerateTangents for orthogonality, then times
+// GenerateNormals with 1, 2, 4, ... threads up to the number of cores.
+inline void BenchmarkNormalGeneration(unsigned int Side)
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+	BuildNormalTestMesh(Side, Vertices, Indices);
+	unsigned int VertexCount = (unsigned int)Vertices.size(), IndexCount = (unsigned int)Indices.size();
+	std::vector<double> Reference = ReferenceNormals(Vertices, Indices);
+
+	typedef std::chrono::high_resolution_clock Clock;
+	unsigned int Cores = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << "Normals of " << VertexCount << " vertices, " << IndexCount / 3 << " triangles\n";
+
+	double Single = 0.0;
+	for (unsigned int Threads = 1; Threads <= Cores; Threads = Threads * 2 > Cores && Threads < Cores ? Cores : Threads * 2)
+	{
+		// no pool for the serial run: JobSystem(0) would start a worker per core
+		std::unique_ptr<JobSystem> Jobs;
+		if (Threads > 1) Jobs.reset(new JobSystem(Threads - 1));
+		JobSystem* pJobs = Jobs.get();
+
+		double Best = 1e30;
+		for (int r = 0; r < 5; r++)
+		{
+			Clock::time_point Start = Clock::now();
+			GenerateNormals(Indices.data(), IndexCount, Vertices.data(), VertexCount, pJobs);
+			Best = std::min(Best, std::chrono::duration<double, std::milli>(Clock::now() - Start).count());
+		}
+		if (Threads == 1) Single = Best;
+
+		std::cout << "  " << Threads << " thread(s): " << Best << " ms (x" << Single / Best << "), max deviation "
+			<< MaxNormalDeviation(Reference, Vertices) << " deg\n";
+	}
+
+	std::vector<glm::vec4> Tangents;
+	JobSystem Jobs;
+	GenerateTangents(Indices.data(), IndexCount, Vertices.data(), VertexCount, Tangents, &Jobs);
+	std::cout << "  tangents: max |dot(N, T)| " << MaxTangentDot(Tangents, Vertices) << "\n";
+}
@@ -3,6 +3,7 @@
 #include <GL/glew.h> // extensions manager
 #include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
 #include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include "BatchTransform.h"
 
 struct m_persProj
 {
@@ -19,6 +20,9 @@ struct m_camera
 };
 
 
+// Keeps the world, view and projection matrices cached and rebuilds each of them
+// only after one of its inputs has changed: a static camera costs nothing per frame
+// and an object that moves only pays for its world matrix and one multiply.
 class Pipeline
 {
 protected:
@@ -26,9 +30,18 @@ protected:
 	glm::vec3 m_worldPos;
 	glm::vec3 m_rotateInfo;
 	glm::mat4 WorldTransformation;
+	glm::mat4 ViewTransformation;
+	glm::mat4 ProjTransformation;
+	glm::mat4 ViewProjTransformation;
 	glm::mat4 WVPTransformation;
 	m_camera camera;
 	m_persProj persproj;
+
+	bool worldDirty;
+	bool viewDirty;
+	bool projDirty;
+	bool viewProjDirty;
+	bool wvpDirty;
 public:
 
 	Pipeline()
@@ -37,110 +50,159 @@ public:
 		m_worldPos = glm::vec3(0.0f, 0.0f, 0.0f);
 		m_rotateInfo = glm::vec3(0.0f, 0.0f, 0.0f);
 		WorldTransformation = glm::mat4{ 1.0f };
+		ViewTransformation = glm::mat4{ 1.0f };
+		ProjTransformation = glm::mat4{ 1.0f };
+		ViewProjTransformation = glm::mat4{ 1.0f };
 		WVPTransformation = glm::mat4{ 1.0f };
+		camera = m_camera{ glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+		persproj = m_persProj{ 1.0f, 1.0f, 1.0f, 100.0f, 60.0f };
+
+		worldDirty = viewDirty = projDirty = viewProjDirty = wvpDirty = true;
 	}
 
 	void Scale(float ScaleX, float ScaleY, float ScaleZ)
 	{
+		if (m_scale.x == ScaleX && m_scale.y == ScaleY && m_scale.z == ScaleZ) return;
+
 		m_scale.x = ScaleX;
 		m_scale.y = ScaleY;
 		m_scale.z = ScaleZ;
+		worldDirty = wvpDirty = true;
 	}
 
 	void WorldPos(float x, float y, float z)
 	{
+		if (m_worldPos.x == x && m_worldPos.y == y && m_worldPos.z == z) return;
+
 		m_worldPos.x = x;
 		m_worldPos.y = y;
 		m_worldPos.z = z;
+		worldDirty = wvpDirty = true;
 	}
 
 	void Rotate(float RotateX, float RotateY, float RotateZ)
 	{
+		if (m_rotateInfo.x == RotateX && m_rotateInfo.y == RotateY && m_rotateInfo.z == RotateZ) return;
+
 		m_rotateInfo.x = RotateX;
 		m_rotateInfo.y = RotateY;
 		m_rotateInfo.z = RotateZ;
+		worldDirty = wvpDirty = true;
 	}
 
 	void SetPerspectiveProj(float FOV, float Width, float Height, float zNear, float zFar)
 	{
+		if (persproj.FOV == FOV && persproj.Width == Width && persproj.Height == Height &&
+			persproj.zNear == zNear && persproj.zFar == zFar) return;
+
 		persproj.FOV = FOV;
 		persproj.Width = Width;
 		persproj.Height = Height;
 		persproj.zNear = zNear;
 		persproj.zFar = zFar;
+		projDirty = viewProjDirty = wvpDirty = true;
 	}
 
-	void SetCamera(glm::vec3& Pos, glm::vec3& Target, glm::vec3& Up)
+	void SetCamera(const glm::vec3& Pos, const glm::vec3& Target, const glm::vec3& Up)
 	{
+		if (SameVec(camera.Pos, Pos) && SameVec(camera.Target, Target) && SameVec(camera.Up, Up)) return;
+
 		camera.Pos = Pos;
 		camera.Target = Target;
 		camera.Up = Up;
+		viewDirty = viewProjDirty = wvpDirty = true;
 	}
 
-	glm::mat4* GetWorldTrans()
+	const m_persProj& GetPerspectiveProj() const
 	{
-		glm::mat4 ScaleTrans, RotateTrans, TranslationTrans;
+		return persproj;
+	}
 
-		ScaleTrans = InitScaleTransform(m_scale.x, m_scale.y, m_scale.z);
-		RotateTrans = InitRotateTransform(m_rotateInfo.x, m_rotateInfo.y, m_rotateInfo.z);
-		TranslationTrans = InitTranslationTransform(m_worldPos.x, m_worldPos.y, m_worldPos.z);
-		
-		WVPTransformation = ScaleTrans * RotateTrans * TranslationTrans;
-		return &WVPTransformation;
-	};
+	const m_camera& GetCamera() const
+	{
+		return camera;
+	}
 
-	glm::mat4* GetWVPTrans()
+	// world space -> view space
+	const glm::mat4& GetViewTrans()
 	{
-		GetWorldTrans();
-		glm::mat4 PersProjTrans, CameraTranslationTrans, CameraRotateTrans;
+		if (viewDirty)
+		{
+			glm::mat4 CameraTranslationTrans, CameraRotateTrans;
 
-		PersProjTrans = InitPerspectiveProj(persproj.Width, persproj.Height, persproj.zNear, persproj.zFar, persproj.FOV);
-		CameraTranslationTrans = InitTranslationTransform(-camera.Pos.x, -camera.Pos.y, -camera.Pos.z);
-		CameraRotateTrans = InitCameraTransform(camera.Target, camera.Up);
+			CameraTranslationTrans = InitTranslationTransform(-camera.Pos.x, -camera.Pos.y, -camera.Pos.z);
+			CameraRotateTrans = InitCameraTransform(camera.Target, camera.Up);
 
-		WorldTransformation = WVPTransformation * CameraTranslationTrans * CameraRotateTrans * PersProjTrans;
-		return &WorldTransformation;
-	};
+			ViewTransformation = CameraTranslationTrans * CameraRotateTrans;
+			viewDirty = false;
+		}
+		return ViewTransformation;
+	}
 
-protected:
-	glm::mat4 InitScaleTransform(float scale_x, float scale_y, float scale_z)
+	const glm::mat4& GetProjTrans()
 	{
-		glm::mat4 m;
-
-		m[0][0] = scale_x;  m[0][1] = 0.0f;		m[0][2] = 0.0f;		 m[0][3] = 0.0f;
-		m[1][0] = 0.0f;		m[1][1] = scale_y;	m[1][2] = 0.0f;		 m[1][3] = 0.0f;
-		m[2][0] = 0.0f;		m[2][1] = 0.0f;		m[2][2] = scale_z;	 m[2][3] = 0.0f;
-		m[3][0] = 0.0f;		m[3][1] = 0.0f;		m[3][2] = 0.0f;		 m[3][3] = 1.0f;
-
-		return m;
+		if (projDirty)
+		{
+			ProjTransformation = InitPerspectiveProj(persproj.Width, persproj.Height, persproj.zNear, persproj.zFar, persproj.FOV);
+			projDirty = false;
+		}
+		return ProjTransformation;
 	}
 
-	glm::mat4 InitRotateTransform(float rotateInfo_x, float rotateInfo_y, float rotateInfo_z)
+	const glm::mat4& GetViewProjTrans()
 	{
-		glm::mat4 m_x, m_y, m_z, m;
-		float x = glm::radians(rotateInfo_x);
-		float y = glm::radians(rotateInfo_y);
-		float z = glm::radians(rotateInfo_z);
+		if (viewProjDirty)
+		{
+			ViewProjTransformation = GetViewTrans() * GetProjTrans();
+			viewProjDirty = false;
+		}
+		return ViewProjTransformation;
+	}
 
-		// X
-		m_x[0][0] = 1.0f;	m_x[0][1] = 0.0f;		m_x[0][2] = 0.0f;		m_x[0][3] = 0.0f;
-		m_x[1][0] = 0.0f;	m_x[1][1] = cosf(x);	m_x[1][2] = -sinf(x);	m_x[1][3] = 0.0f;
-		m_x[2][0] = 0.0f;	m_x[2][1] = sinf(x);	m_x[2][2] = cosf(x);	m_x[2][3] = 0.0f;
-		m_x[3][0] = 0.0f;	m_x[3][1] = 0.0f;		m_x[3][2] = 0.0f;		m_x[3][3] = 1.0f;
+	glm::mat4* GetWorldTrans()
+	{
+		if (worldDirty)
+		{
+			WorldTransformation = InitWorldTransform(m_scale, m_rotateInfo, m_worldPos);
+			worldDirty = false;
+		}
+		return &WorldTransformation;
+	};
 
-		// Y
-		m_y[0][0] = cosf(y);	m_y[0][1] = 0.0f;	m_y[0][2] = -sinf(y);	m_y[0][3] = 0.0f;
-		m_y[1][0] = 0.0f;		m_y[1][1] = 1.0f;	m_y[1][2] = 0.0f;		m_y[1][3] = 0.0f;
-		m_y[2][0] = sinf(y);	m_y[2][1] = 0.0f;	m_y[2][2] = cosf(y);	m_y[2][3] = 0.0f;
-		m_y[3][0] = 0.0f;		m_y[3][1] = 0.0f;	m_y[3][2] = 0.0f;		m_y[3][3] = 1.0f;
+	glm::mat4* GetWVPTrans()
+	{
+		if (wvpDirty)
+		{
+			WVPTransformation = *GetWorldTrans() * GetViewProjTrans();
+			wvpDirty = false;
+		}
+		return &WVPTransformation;
+	};
 
-		// Z
-		m_z[0][0] = cosf(z);	m_z[0][1] = -sinf(z);	m_z[0][2] = 0.0f;	m_z[0][3] = 0.0f;
-		m_z[1][0] = sinf(z);	m_z[1][1] = cosf(z);	m_z[1][2] = 0.0f;	m_z[1][3] = 0.0f;
-		m_z[2][0] = 0.0f;		m_z[2][1] = 0.0f;		m_z[2][2] = 1.0f;	m_z[2][3] = 0.0f;
-		m_z[3][0] = 0.0f;		m_z[3][1] = 0.0f;		m_z[3][2] = 0.0f;	m_z[3][3] = 1.0f;
+	// world and WVP matrices of Batch.Count objects seen through this pipeline's camera,
+	// the same values Scale/Rotate/WorldPos + GetWorldTrans/GetWVPTrans give one by one
+	void GetBatchTrans(const TransformBatch& Batch, glm::mat4* pWorldTrans, glm::mat4* pWVPTrans)
+	{
+		BatchTransform(Batch, GetViewProjTrans(), pWorldTrans, pWVPTrans);
+	}
 
-		m = m_x * m_y * m_z;
+protected:
+	// scale, then rotate around X, Y and Z (in this order), then translate, as one
+	// matrix; the rotation part is the product Rz * Ry * Rx expanded by hand
+	glm::mat4 InitWorldTransform(const glm::vec3& Scale, const glm::vec3& RotateInfo, const glm::vec3& Pos)
+	{
+		glm::mat4 m;
+		float x = glm::radians(RotateInfo.x);
+		float y = glm::radians(RotateInfo.y);
+		float z = glm::radians(RotateInfo.z);
+		float sx = sinf(x), cx = cosf(x);
+		float sy = sinf(y), cy = cosf(y);
+		float sz = sinf(z), cz = cosf(z);
+
+		m[0][0] = cz * cy * Scale.x;	m[0][1] = (-cz * sy * sx - sz * cx) * Scale.y;	m[0][2] = (-cz * sy * cx + sz * sx) * Scale.z;	m[0][3] = Pos.x;
+		m[1][0] = sz * cy * Scale.x;	m[1][1] = (-sz * sy * sx + cz * cx) * Scale.y;	m[1][2] = (-sz * sy * cx - cz * sx) * Scale.z;	m[1][3] = Pos.y;
+		m[2][0] = sy * Scale.x;			m[2][1] = cy * sx * Scale.y;					m[2][2] = cy * cx * Scale.z;					m[2][3] = Pos.z;
+		m[3][0] = 0.0f;					m[3][1] = 0.0f;									m[3][2] = 0.0f;									m[3][3] = 1.0f;
 
 		return m;
 	}
@@ -173,7 +235,7 @@ protected:
 		return m;
 	}
 
-	glm::mat4 InitCameraTransform(glm::vec3& Target, glm::vec3& Up)
+	glm::mat4 InitCameraTransform(const glm::vec3& Target, const glm::vec3& Up)
 	{
 		glm::mat4 m;
 
@@ -191,5 +253,10 @@ protected:
 
 		return m;
 	}
+
+	static bool SameVec(const glm::vec3& a, const glm::vec3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
 };
 
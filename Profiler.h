@@ -0,0 +1,471 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+
+// Frame profiler: named CPU scopes from any thread and GPU scopes on the GL thread.
+//  - a scope is an RAII object (PROFILE_SCOPE / PROFILE_GPU_SCOPE), recording costs
+//    two clock reads and a push into a per-thread buffer, GPU scopes add two
+//    GL_TIMESTAMP queries; with the profiler disabled a scope is a single branch
+//  - GPU queries live in a ring of PROFILER_GPU_LATENCY frames and are read when
+//    their slot comes around again, if the driver is not done yet the frame is
+//    dropped instead of waited for
+//  - every scope name keeps its last PROFILER_HISTORY samples for min/avg/p99
+//  - Capture records a number of frames and writes them as a Chrome trace
+//    (chrome://tracing or ui.perfetto.dev), the GPU as its own thread
+// Timestamp pairs are used instead of GL_TIME_ELAPSED queries because those
+// cannot nest, and passes contain draw scopes.
+const unsigned int PROFILER_GPU_LATENCY = 4; // frames between issuing and reading GPU queries
+const unsigned int PROFILER_HISTORY = 256; // samples per scope for the statistics
+
+// counted per frame, for the headless benchmark
+enum PROFILE_COUNTER
+{
+	PROFILE_DRAW_CALLS,
+	PROFILE_UNIFORM_CALLS, // only after Profiler::CountUniformCalls
+	PROFILE_SHADED_FRAGMENTS, // samples that passed the depth test in the lighting pass, a few frames late
+	PROFILE_STATE_CHANGES, // program, vertex array and texture binds issued through GLStateCache
+	PROFILE_REDUNDANT_STATE, // the ones it skipped
+	PROFILE_COUNTER_COUNT
+};
+
+class Profiler
+{
+public:
+	struct Stats
+	{
+		double Min, Average, P99; // milliseconds
+		unsigned int Samples;
+	};
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Event
+	{
+		const char* pName;
+		int64_t Start; // microseconds since the profiler was created
+		int64_t End;
+	};
+
+	// one per thread that records scopes; the owner appends, EndFrame takes the events
+	struct ThreadEvents
+	{
+		std::mutex Lock;
+		std::vector<Event> Events;
+		unsigned int Id;
+	};
+
+	struct GpuScope
+	{
+		const char* pName;
+		unsigned int Begin; // query indices in the frame
+		unsigned int End;
+	};
+
+	struct GpuFrame
+	{
+		std::vector<GLuint> Queries;
+		unsigned int Used;
+		std::vector<GpuScope> Scopes;
+		int64_t CpuStart; // CPU time of the first query, to place the GPU events in the trace
+		bool Capture;
+	};
+
+	struct History
+	{
+		std::vector<float> Samples;
+		unsigned int Next;
+	};
+
+	bool enabled;
+	Clock::time_point origin;
+	std::mutex threadsLock;
+	std::vector<ThreadEvents*> threads;
+	GpuFrame gpuFrames[PROFILER_GPU_LATENCY];
+	unsigned int frame;
+	bool gpuSupported;
+	unsigned int droppedGpuFrames;
+	std::map<std::string, History> cpuHistory;
+	std::map<std::string, History> gpuHistory;
+	unsigned long long counters[PROFILE_COUNTER_COUNT]; // of the frame being recorded
+	unsigned long long frameCounters[PROFILE_COUNTER_COUNT]; // of the last finished frame
+
+	unsigned int captureFrames; // frames still to record
+	std::string capturePath;
+	std::vector<std::pair<unsigned int, Event> > captured; // thread id, event; GPU events use GPU_THREAD
+	static const unsigned int GPU_THREAD = 0xFFFF;
+
+public:
+	Profiler()
+	{
+		enabled = true;
+		origin = Clock::now();
+		frame = 0;
+		gpuSupported = false;
+		droppedGpuFrames = 0;
+		captureFrames = 0;
+		for (unsigned int i = 0; i < PROFILE_COUNTER_COUNT; i++) counters[i] = frameCounters[i] = 0;
+		for (GpuFrame& f : gpuFrames)
+		{
+			f.Used = 0;
+			f.CpuStart = 0;
+			f.Capture = false;
+		}
+	}
+
+	// the queries are left to the context: the instance outlives the window
+	~Profiler()
+	{
+		for (ThreadEvents* t : threads) delete t;
+	}
+
+	// the one instance all scopes report to
+	static Profiler& Get()
+	{
+		static Profiler Instance;
+		return Instance;
+	}
+
+	void SetEnabled(bool Enabled)
+	{
+		enabled = Enabled;
+	}
+
+	bool IsEnabled() const
+	{
+		return enabled;
+	}
+
+	int64_t Now() const
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - origin).count();
+	}
+
+	void AddCpuEvent(const char* pName, int64_t Start, int64_t End)
+	{
+		ThreadEvents& t = GetThreadEvents();
+		std::lock_guard<std::mutex> Guard(t.Lock);
+		Event e = { pName, Start, End };
+		t.Events.push_back(e);
+	}
+
+	// GL thread only; returns the query index for EndGpu, or -1
+	int BeginGpu(const char* pName)
+	{
+		if (!gpuSupported) return -1;
+		GpuFrame& f = gpuFrames[frame % PROFILER_GPU_LATENCY];
+		GpuScope s = { pName, IssueQuery(f), 0 };
+		f.Scopes.push_back(s);
+		return (int)f.Scopes.size() - 1;
+	}
+
+	void EndGpu(int Scope)
+	{
+		if (Scope < 0) return;
+		GpuFrame& f = gpuFrames[frame % PROFILER_GPU_LATENCY];
+		if ((size_t)Scope < f.Scopes.size()) f.Scopes[Scope].End = IssueQuery(f);
+	}
+
+	// GL thread, at the start of a frame: reads the GPU queries that are due
+	void BeginFrame()
+	{
+		gpuSupported = (GLEW_VERSION_3_3 || GLEW_ARB_timer_query) != 0;
+		if (!enabled || !gpuSupported) return;
+
+		GpuFrame& f = gpuFrames[frame % PROFILER_GPU_LATENCY];
+		ResolveGpuFrame(f);
+		f.Used = 0;
+		f.Scopes.clear();
+		f.CpuStart = Now();
+		f.Capture = captureFrames > 0;
+	}
+
+	// GL thread, after the frame is submitted: moves the CPU events of all threads into the statistics
+	void EndFrame()
+	{
+		for (unsigned int i = 0; i < PROFILE_COUNTER_COUNT; i++)
+		{
+			frameCounters[i] = counters[i];
+			counters[i] = 0;
+		}
+		if (!enabled) return;
+
+		std::vector<std::pair<unsigned int, Event> > Events;
+		{
+			std::lock_guard<std::mutex> Guard(threadsLock);
+			for (ThreadEvents* t : threads)
+			{
+				std::lock_guard<std::mutex> ThreadGuard(t->Lock);
+				for (const Event& e : t->Events) Events.push_back(std::make_pair(t->Id, e));
+				t->Events.clear();
+			}
+		}
+
+		for (const auto& e : Events) AddSample(cpuHistory, e.second.pName, (e.second.End - e.second.Start) / 1000.0f);
+
+		if (captureFrames > 0)
+		{
+			captured.insert(captured.end(), Events.begin(), Events.end());
+			if (--captureFrames == 0) WriteCapture();
+		}
+		frame++;
+	}
+
+	// records the next Frames frames and writes them to Path as a Chrome trace
+	void Capture(unsigned int Frames, const std::string& Path)
+	{
+		captured.clear();
+		capturePath = Path;
+		captureFrames = Frames;
+	}
+
+	// GL thread only; counted whether or not the profiler is enabled
+	void Count(PROFILE_COUNTER Counter, unsigned int Amount = 1)
+	{
+		counters[Counter] += Amount;
+	}
+
+	unsigned long long GetFrameCounter(PROFILE_COUNTER Counter) const
+	{
+		return frameCounters[Counter];
+	}
+
+	// Routes the glUniform* entry points GLEW loaded through counting wrappers, so
+	// every technique is covered without touching its setters. After glewInit; the
+	// extra indirection is why it is only done for benchmark runs.
+	static void CountUniformCalls();
+
+	bool GetCpuStats(const std::string& Name, Stats& Result) const
+	{
+		return GetStats(cpuHistory, Name, Result);
+	}
+
+	bool GetGpuStats(const std::string& Name, Stats& Result) const
+	{
+		return GetStats(gpuHistory, Name, Result);
+	}
+
+	// min/avg/p99 of every scope in milliseconds
+	void Report(std::ostream& Out) const
+	{
+		const std::map<std::string, History>* Tables[2] = { &cpuHistory, &gpuHistory };
+		const char* Titles[2] = { "CPU", "GPU" };
+		for (int i = 0; i < 2; i++)
+		{
+			Out << Titles[i] << " scope                      min      avg      p99   (ms)\n";
+			for (const auto& h : *Tables[i])
+			{
+				Stats s;
+				if (!GetStats(*Tables[i], h.first, s)) continue;
+				char Line[160];
+				snprintf(Line, sizeof(Line), "  %-26s %8.3f %8.3f %8.3f\n", h.first.c_str(), s.Min, s.Average, s.P99);
+				Out << Line;
+			}
+		}
+		if (droppedGpuFrames > 0) Out << droppedGpuFrames << " GPU frames dropped (results not ready in time)\n";
+	}
+
+private:
+	ThreadEvents& GetThreadEvents()
+	{
+		thread_local ThreadEvents* pEvents = nullptr;
+		if (pEvents == nullptr)
+		{
+			std::lock_guard<std::mutex> Guard(threadsLock);
+			pEvents = new ThreadEvents;
+			pEvents->Id = (unsigned int)threads.size();
+			threads.push_back(pEvents);
+		}
+		return *pEvents;
+	}
+
+	unsigned int IssueQuery(GpuFrame& f)
+	{
+		if (f.Used == f.Queries.size())
+		{
+			size_t Old = f.Queries.size();
+			f.Queries.resize(std::max<size_t>(16, Old * 2));
+			glGenQueries((GLsizei)(f.Queries.size() - Old), &f.Queries[Old]);
+		}
+		glQueryCounter(f.Queries[f.Used], GL_TIMESTAMP);
+		return f.Used++;
+	}
+
+	void ResolveGpuFrame(GpuFrame& f)
+	{
+		if (f.Used == 0) return;
+
+		// the last query finishes last; if it is not there, nothing is read
+		GLint Available = 0;
+		glGetQueryObjectiv(f.Queries[f.Used - 1], GL_QUERY_RESULT_AVAILABLE, &Available);
+		if (!Available)
+		{
+			droppedGpuFrames++;
+			return;
+		}
+
+		std::vector<GLuint64> Times(f.Used);
+		for (unsigned int i = 0; i < f.Used; i++) glGetQueryObjectui64v(f.Queries[i], GL_QUERY_RESULT, &Times[i]);
+
+		GLuint64 First = Times[0];
+		for (const GpuScope& s : f.Scopes)
+		{
+			if (s.End <= s.Begin) continue;
+			AddSample(gpuHistory, s.pName, (float)((Times[s.End] - Times[s.Begin]) / 1.0e6));
+
+			if (f.Capture)
+			{
+				Event e = { s.pName, f.CpuStart + (int64_t)((Times[s.Begin] - First) / 1000), f.CpuStart + (int64_t)((Times[s.End] - First) / 1000) };
+				captured.push_back(std::make_pair(GPU_THREAD, e));
+			}
+		}
+	}
+
+	static void AddSample(std::map<std::string, History>& Table, const char* pName, float Milliseconds)
+	{
+		History& h = Table[pName];
+		if (h.Samples.size() < PROFILER_HISTORY)
+		{
+			h.Samples.push_back(Milliseconds);
+			h.Next = 0;
+		}
+		else
+		{
+			h.Samples[h.Next] = Milliseconds;
+			h.Next = (h.Next + 1) % PROFILER_HISTORY;
+		}
+	}
+
+	static bool GetStats(const std::map<std::string, History>& Table, const std::string& Name, Stats& Result)
+	{
+		auto Found = Table.find(Name);
+		if (Found == Table.end() || Found->second.Samples.empty()) return false;
+
+		std::vector<float> Sorted = Found->second.Samples;
+		std::sort(Sorted.begin(), Sorted.end());
+		double Sum = 0.0;
+		for (float v : Sorted) Sum += v;
+
+		Result.Min = Sorted.front();
+		Result.Average = Sum / Sorted.size();
+		Result.P99 = Sorted[std::min(Sorted.size() - 1, (size_t)(Sorted.size() * 0.99))];
+		Result.Samples = (unsigned int)Sorted.size();
+		return true;
+	}
+
+	void WriteCapture()
+	{
+		std::ofstream File(capturePath);
+		if (!File)
+		{
+			std::cerr << "Error writing the trace '" << capturePath << "'\n";
+			return;
+		}
+
+		// GPU events of the last frames arrive PROFILER_GPU_LATENCY frames late and are left out
+		File << "{\"traceEvents\":[\n";
+		File << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_THREAD << ",\"args\":{\"name\":\"GPU\"}}";
+		for (const auto& e : captured)
+		{
+			File << ",\n{\"name\":\"" << e.second.pName << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.first <<
+				",\"ts\":" << e.second.Start << ",\"dur\":" << (e.second.End - e.second.Start) << "}";
+		}
+		File << "\n]}\n";
+		std::cout << "Trace of " << captured.size() << " events written to " << capturePath << "\n";
+		captured.clear();
+	}
+};
+
+// CPU time from construction to destruction
+class ProfileScope
+{
+private:
+	const char* pName;
+	int64_t start;
+
+public:
+	ProfileScope(const char* Name)
+	{
+		pName = Profiler::Get().IsEnabled() ? Name : nullptr;
+		if (pName != nullptr) start = Profiler::Get().Now();
+	}
+
+	~ProfileScope()
+	{
+		if (pName != nullptr) Profiler::Get().AddCpuEvent(pName, start, Profiler::Get().Now());
+	}
+};
+
+// CPU and GPU time of the commands issued in between, GL thread only
+class GpuProfileScope
+{
+private:
+	ProfileScope cpu;
+	int scope;
+
+public:
+	GpuProfileScope(const char* Name) : cpu(Name)
+	{
+		scope = Profiler::Get().IsEnabled() ? Profiler::Get().BeginGpu(Name) : -1;
+	}
+
+	~GpuProfileScope()
+	{
+		Profiler::Get().EndGpu(scope);
+	}
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// Name must be a string literal (it is kept by pointer)
+#define PROFILE_SCOPE(Name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(Name)
+#define PROFILE_GPU_SCOPE(Name) GpuProfileScope PROFILE_CONCAT(profileScope, __LINE__)(Name)
+
+// glUniform* wrappers for Profiler::CountUniformCalls, each keeps the entry point it replaced
+#ifdef _WIN32
+#define PROFILER_GL_APIENTRY __stdcall // glew.h undefines APIENTRY again
+#else
+#define PROFILER_GL_APIENTRY
+#endif
+#define PROFILER_UNIFORM_HOOK(Type, Name, Params, Args) \
+	inline Type& ProfilerOriginal##Name() { static Type Original = nullptr; return Original; } \
+	inline void PROFILER_GL_APIENTRY ProfilerCounted##Name Params { Profiler::Get().Count(PROFILE_UNIFORM_CALLS); ProfilerOriginal##Name() Args; }
+
+PROFILER_UNIFORM_HOOK(PFNGLUNIFORM1FPROC, Uniform1f, (GLint l, GLfloat x), (l, x))
+PROFILER_UNIFORM_HOOK(PFNGLUNIFORM1IPROC, Uniform1i, (GLint l, GLint x), (l, x))
+PROFILER_UNIFORM_HOOK(PFNGLUNIFORM2FPROC, Uniform2f, (GLint l, GLfloat x, GLfloat y), (l, x, y))
+PROFILER_UNIFORM_HOOK(PFNGLUNIFORM3FPROC, Uniform3f, (GLint l, GLfloat x, GLfloat y, GLfloat z), (l, x, y, z))
+PROFILER_UNIFORM_HOOK(PFNGLUNIFORM3IPROC, Uniform3i, (GLint l, GLint x, GLint y, GLint z), (l, x, y, z))
+PROFILER_UNIFORM_HOOK(PFNGLUNIFORM4FPROC, Uniform4f, (GLint l, GLfloat x, GLfloat y, GLfloat z, GLfloat w), (l, x, y, z, w))
+PROFILER_UNIFORM_HOOK(PFNGLUNIFORM1IVPROC, Uniform1iv, (GLint l, GLsizei n, const GLint* v), (l, n, v))
+PROFILER_UNIFORM_HOOK(PFNGLUNIFORM1FVPROC, Uniform1fv, (GLint l, GLsizei n, const GLfloat* v), (l, n, v))
+PROFILER_UNIFORM_HOOK(PFNGLUNIFORM3FVPROC, Uniform3fv, (GLint l, GLsizei n, const GLfloat* v), (l, n, v))
+PROFILER_UNIFORM_HOOK(PFNGLUNIFORM4FVPROC, Uniform4fv, (GLint l, GLsizei n, const GLfloat* v), (l, n, v))
+PROFILER_UNIFORM_HOOK(PFNGLUNIFORMMATRIX4FVPROC, UniformMatrix4fv, (GLint l, GLsizei n, GLboolean t, const GLfloat* v), (l, n, t, v))
+
+inline void Profiler::CountUniformCalls()
+{
+	if (ProfilerOriginalUniform1f() != nullptr) return; // already hooked
+
+	ProfilerOriginalUniform1f() = __glewUniform1f; __glewUniform1f = ProfilerCountedUniform1f;
+	ProfilerOriginalUniform1i() = __glewUniform1i; __glewUniform1i = ProfilerCountedUniform1i;
+	ProfilerOriginalUniform2f() = __glewUniform2f; __glewUniform2f = ProfilerCountedUniform2f;
+	ProfilerOriginalUniform3f() = __glewUniform3f; __glewUniform3f = ProfilerCountedUniform3f;
+	ProfilerOriginalUniform3i() = __glewUniform3i; __glewUniform3i = ProfilerCountedUniform3i;
+	ProfilerOriginalUniform4f() = __glewUniform4f; __glewUniform4f = ProfilerCountedUniform4f;
+	ProfilerOriginalUniform1iv() = __glewUniform1iv; __glewUniform1iv = ProfilerCountedUniform1iv;
+	ProfilerOriginalUniform1fv() = __glewUniform1fv; __glewUniform1fv = ProfilerCountedUniform1fv;
+	ProfilerOriginalUniform3fv() = __glewUniform3fv; __glewUniform3fv = ProfilerCountedUniform3fv;
+	ProfilerOriginalUniform4fv() = __glewUniform4fv; __glewUniform4fv = ProfilerCountedUniform4fv;
+	ProfilerOriginalUniformMatrix4fv() = __glewUniformMatrix4fv; __glewUniformMatrix4fv = ProfilerCountedUniformMatrix4fv;
+}
@@ -0,0 +1,208 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Linked programs saved with glGetProgramBinary, one file per program in a directory.
+// The key hashes the final shader sources together with the GL vendor, renderer
+// and version strings, so a driver update or an edited shader simply misses. The
+// file also holds the locations of all active uniforms, a program loaded from it
+// needs no glGetUniformLocation string lookups. A binary the driver rejects is
+// recompiled by the caller and overwritten.
+const char PROGRAM_CACHE_MAGIC[4] = { 'P', 'R', 'G', 'B' };
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader
+{
+	char Magic[4];
+	uint32_t Version;
+	uint64_t Key;
+	uint32_t BinaryFormat;
+	uint32_t BinarySize;
+	uint32_t UniformCount;
+	uint32_t pad;
+};
+
+static_assert(sizeof(ProgramCacheHeader) == 32, "ProgramCacheHeader layout is part of the file format");
+
+struct UniformLocation
+{
+	std::string Name;
+	GLint Location;
+};
+
+class ProgramCache
+{
+private:
+	std::string directory;
+	std::string driver; // vendor, renderer and version, part of every key
+	bool supported;
+	unsigned int hits;
+	unsigned int misses;
+
+public:
+	// needs a current GL context; Directory is created if it does not exist
+	ProgramCache(const std::string& Directory)
+	{
+		directory = Directory;
+		hits = misses = 0;
+
+		GLint NumFormats = 0;
+		supported = (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) != 0;
+		if (supported) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &NumFormats);
+		supported = supported && NumFormats > 0;
+
+		const GLubyte* Strings[3] = { glGetString(GL_VENDOR), glGetString(GL_RENDERER), glGetString(GL_VERSION) };
+		for (const GLubyte* p : Strings)
+		{
+			if (p != nullptr) driver += (const char*)p;
+			driver += '\n';
+		}
+
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+
+	bool IsSupported() const
+	{
+		return supported;
+	}
+
+	uint64_t MakeKey(const std::string& VertexSource, const std::string& FragmentSource) const
+	{
+		uint64_t Hash = 14695981039346656037ull;
+		const std::string* Parts[3] = { &driver, &VertexSource, &FragmentSource };
+		for (const std::string* p : Parts)
+		{
+			for (unsigned char c : *p)
+			{
+				Hash ^= c;
+				Hash *= 1099511628211ull;
+			}
+			Hash ^= 0xFF; // separator, so moving text between the parts changes the key
+			Hash *= 1099511628211ull;
+		}
+		return Hash;
+	}
+
+	// links Program from the stored binary; false if there is none or the driver rejects it
+	bool Load(uint64_t Key, GLuint Program, std::vector<UniformLocation>& Uniforms)
+	{
+		if (!supported) return false;
+
+		std::ifstream File(GetFileName(Key), std::ios::binary);
+		ProgramCacheHeader Header;
+		if (!File || !File.read((char*)&Header, sizeof(Header)) || memcmp(Header.Magic, PROGRAM_CACHE_MAGIC, sizeof(Header.Magic)) != 0 ||
+			Header.Version != PROGRAM_CACHE_VERSION || Header.Key != Key)
+		{
+			misses++;
+			return false;
+		}
+
+		Uniforms.clear();
+		for (uint32_t i = 0; i < Header.UniformCount; i++)
+		{
+			uint32_t Length = 0;
+			UniformLocation Uniform;
+			if (!File.read((char*)&Length, sizeof(Length)) || Length > 4096) break;
+			Uniform.Name.resize(Length);
+			if (Length > 0) File.read(&Uniform.Name[0], Length);
+			File.read((char*)&Uniform.Location, sizeof(Uniform.Location));
+			Uniforms.push_back(Uniform);
+		}
+
+		std::vector<char> Binary(Header.BinarySize);
+		if (Uniforms.size() != Header.UniformCount || Header.BinarySize == 0 || !File.read(Binary.data(), Binary.size()))
+		{
+			misses++;
+			return false;
+		}
+
+		glProgramBinary(Program, Header.BinaryFormat, Binary.data(), (GLsizei)Binary.size());
+		GLint Success = 0;
+		glGetProgramiv(Program, GL_LINK_STATUS, &Success);
+		if (!Success)
+		{
+			misses++;
+			return false;
+		}
+
+		hits++;
+		return true;
+	}
+
+	// Program must be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	void Store(uint64_t Key, GLuint Program, const std::vector<UniformLocation>& Uniforms)
+	{
+		if (!supported) return;
+
+		GLint Size = 0;
+		glGetProgramiv(Program, GL_PROGRAM_BINARY_LENGTH, &Size);
+		if (Size <= 0) return;
+
+		std::vector<char> Binary(Size);
+		GLenum Format = 0;
+		GLsizei Written = 0;
+		glGetProgramBinary(Program, Size, &Written, &Format, Binary.data());
+		if (Written <= 0) return;
+
+		ProgramCacheHeader Header;
+		memcpy(Header.Magic, PROGRAM_CACHE_MAGIC, sizeof(Header.Magic));
+		Header.Version = PROGRAM_CACHE_VERSION;
+		Header.Key = Key;
+		Header.BinaryFormat = Format;
+		Header.BinarySize = (uint32_t)Written;
+		Header.UniformCount = (uint32_t)Uniforms.size();
+		Header.pad = 0;
+
+		std::ofstream File(GetFileName(Key), std::ios::binary | std::ios::trunc);
+		if (!File)
+		{
+			std::cerr << "Warning!Unable to write the program cache '" << GetFileName(Key) << "'\n";
+			return;
+		}
+		File.write((const char*)&Header, sizeof(Header));
+		for (const UniformLocation& Uniform : Uniforms)
+		{
+			uint32_t Length = (uint32_t)Uniform.Name.size();
+			File.write((const char*)&Length, sizeof(Length));
+			File.write(Uniform.Name.data(), Length);
+			File.write((const char*)&Uniform.Location, sizeof(Uniform.Location));
+		}
+		File.write(Binary.data(), Written);
+	}
+
+	unsigned int GetHits() const
+	{
+		return hits;
+	}
+
+	unsigned int GetMisses() const
+	{
+		return misses;
+	}
+
+private:
+	std::string GetFileName(uint64_t Key) const
+	{
+		char Name[32];
+		snprintf(Name, sizeof(Name), "%016llx.bin", (unsigned long long)Key);
+		return directory + "/" + Name;
+	}
+};
@@ -0,0 +1,122 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+// Passes that draw lists of objects, in the order a frame runs them
+enum RENDER_PASS
+{
+	RENDER_PASS_SHADOW,
+	RENDER_PASS_DEPTH,
+	RENDER_PASS_OPAQUE,
+	RENDER_PASS_COUNT
+};
+
+// Draws of a frame as 64-bit sort keys, each with the index of its data in the frame's
+// per draw arrays. The key holds the state a draw needs, from the most expensive change to
+// the cheapest, and its depth last, so sorted draws change state as rarely as possible and
+// go front to back within the same state:
+//   bits 63-60 pass | 59-52 technique | 51-40 texture | 39-32 mesh | 31-0 depth
+// Technique, texture and mesh are slots the caller numbers. Sort is an LSD radix sort,
+// a byte per pass; the histograms of all eight bytes come from one read of the keys,
+// and a byte that is the same in every key (the state fields mostly are) is skipped.
+class RenderQueue
+{
+private:
+	std::vector<uint64_t> keys;
+	std::vector<unsigned int> items;
+	std::vector<uint64_t> tempKeys;
+	std::vector<unsigned int> tempItems;
+	unsigned int histograms[8][256];
+
+public:
+	static uint64_t MakeKey(RENDER_PASS Pass, unsigned int Technique, unsigned int Texture, unsigned int Mesh, float Depth)
+	{
+		return ((uint64_t)(Pass & 0xf) << 60) | ((uint64_t)(Technique & 0xff) << 52) |
+			((uint64_t)(Texture & 0xfff) << 40) | ((uint64_t)(Mesh & 0xff) << 32) | DepthBits(Depth);
+	}
+
+	static RENDER_PASS GetPass(uint64_t Key) { return (RENDER_PASS)(Key >> 60); }
+	static unsigned int GetTechnique(uint64_t Key) { return (unsigned int)(Key >> 52) & 0xff; }
+	static unsigned int GetTexture(uint64_t Key) { return (unsigned int)(Key >> 40) & 0xfff; }
+	static unsigned int GetMesh(uint64_t Key) { return (unsigned int)(Key >> 32) & 0xff; }
+
+	void Clear()
+	{
+		keys.clear();
+		items.clear();
+	}
+
+	void Push(uint64_t Key, unsigned int Item)
+	{
+		keys.push_back(Key);
+		items.push_back(Item);
+	}
+
+	void Sort()
+	{
+		size_t Count = keys.size();
+		if (Count < 2) return;
+		tempKeys.resize(Count);
+		tempItems.resize(Count);
+
+		memset(histograms, 0, sizeof(histograms));
+		for (size_t i = 0; i < Count; i++)
+		{
+			uint64_t Key = keys[i];
+			for (int b = 0; b < 8; b++) histograms[b][(Key >> (b * 8)) & 0xff]++;
+		}
+
+		for (int b = 0; b < 8; b++)
+		{
+			unsigned int* pCounts = histograms[b];
+			if (pCounts[(keys[0] >> (b * 8)) & 0xff] == Count) continue; // the byte orders nothing
+
+			unsigned int Offset = 0;
+			for (int d = 0; d < 256; d++)
+			{
+				unsigned int n = pCounts[d];
+				pCounts[d] = Offset;
+				Offset += n;
+			}
+			for (size_t i = 0; i < Count; i++)
+			{
+				unsigned int Slot = pCounts[(keys[i] >> (b * 8)) & 0xff]++;
+				tempKeys[Slot] = keys[i];
+				tempItems[Slot] = items[i];
+			}
+			keys.swap(tempKeys);
+			items.swap(tempItems);
+		}
+	}
+
+	unsigned int GetCount() const
+	{
+		return (unsigned int)keys.size();
+	}
+
+	uint64_t GetKey(unsigned int i) const
+	{
+		return keys[i];
+	}
+
+	unsigned int GetItem(unsigned int i) const
+	{
+		return items[i];
+	}
+
+	const unsigned int* GetItems() const
+	{
+		return items.data();
+	}
+
+private:
+	// the float bits with the order of the floats: negative ones flipped, positive ones above them
+	static uint32_t DepthBits(float Depth)
+	{
+		uint32_t Bits;
+		memcpy(&Bits, &Depth, sizeof(Bits));
+		return (Bits & 0x80000000u) ? ~Bits : (Bits | 0x80000000u);
+	}
+};
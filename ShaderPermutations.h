@@ -0,0 +1,101 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <unordered_map>
+#include "LightingTechnique.h"
+
+// Compiled LightingTechnique variants by LightingPermutation. A variant is compiled
+// the first time it is asked for (or up front with Request), in the background when
+// the driver has KHR_parallel_shader_compile: Get returns nullptr until it is ready,
+// the caller keeps drawing with the generic technique meanwhile. Without the
+// extension the compile still runs while the frame is drawn and Update only blocks
+// once the driver is asked for the result.
+class LightingTechniqueRegistry
+{
+private:
+	struct Variant
+	{
+		LightingTechnique* pTechnique;
+		bool Ready;
+		bool Failed;
+	};
+
+	std::unordered_map<unsigned int, Variant> variants;
+	std::vector<unsigned int> compiling; // keys of variants that are not finished
+	unsigned int textureUnit;
+
+public:
+	// TextureUnit is set as the sampler of every finished variant
+	LightingTechniqueRegistry(unsigned int TextureUnit = 0)
+	{
+		textureUnit = TextureUnit;
+		if (GLEW_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // as many as the driver likes
+		else if (GLEW_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	}
+
+	~LightingTechniqueRegistry()
+	{
+		for (auto& v : variants) delete v.second.pTechnique;
+	}
+
+	// starts compiling the variant if it is not known yet
+	void Request(const LightingPermutation& Permutation)
+	{
+		unsigned int Key = Permutation.GetKey();
+		if (variants.count(Key) != 0) return;
+
+		Variant v;
+		v.pTechnique = new LightingTechnique(Permutation);
+		v.Ready = false;
+		v.Failed = !v.pTechnique->BeginInit();
+		variants[Key] = v;
+		if (!v.Failed) compiling.push_back(Key);
+	}
+
+	// the variant if it is compiled, otherwise requests it and returns nullptr
+	LightingTechnique* Get(const LightingPermutation& Permutation)
+	{
+		auto Found = variants.find(Permutation.GetKey());
+		if (Found == variants.end())
+		{
+			Request(Permutation);
+			return nullptr;
+		}
+		return Found->second.Ready ? Found->second.pTechnique : nullptr;
+	}
+
+	// once per frame: finishes the variants the driver is done with
+	void Update()
+	{
+		for (size_t i = 0; i < compiling.size();)
+		{
+			Variant& v = variants[compiling[i]];
+			if (!v.pTechnique->IsCompiled())
+			{
+				i++;
+				continue;
+			}
+
+			if (v.pTechnique->FinishInit())
+			{
+				v.pTechnique->Enable();
+				v.pTechnique->SetTextureUnit(textureUnit);
+				v.Ready = true;
+			}
+			else
+			{
+				v.Failed = true; // the generic technique stays in use
+			}
+			compiling[i] = compiling.back();
+			compiling.pop_back();
+		}
+	}
+
+	unsigned int GetPendingCount() const
+	{
+		return (unsigned int)compiling.size();
+	}
+};
@@ -0,0 +1,397 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include "LightingTechnique.h"
+#include "ShadowMapping.h"
+#include "Instancing.h"
+#include "Frustum.h"
+#include "GLStateCache.h"
+
+const GLsizei SHADOW_ATLAS_SIZE = 4096;
+const GLsizei SHADOW_ATLAS_MIN_TILE = 128;
+const GLsizei SHADOW_ATLAS_MAX_POINT_TILE = 512; // per cube face
+const GLsizei SHADOW_ATLAS_MAX_SPOT_TILE = 1024;
+const float SHADOW_ATLAS_NEAR = 0.05f;
+const float SHADOW_ATLAS_MAX_RANGE = 25.0f; // slices end here even for lights that reach further
+const float SHADOW_ATLAS_MAX_SPOT_FOV = 150.0f; // wider cones are lit without shadows at the edges
+const unsigned int SHADOW_ATLAS_SLOTS = MAX_SHADOW_POINT_SLICES + MAX_SPOT_LIGHTS;
+const uint64_t SHADOW_CASTERS_ANIMATED = 0; // caster signature that never matches, the slice is drawn every frame
+
+// Square power of two tiles of the atlas, split and merged like a buddy allocator:
+// a free tile of size S is split into four of S/2, four free siblings merge back.
+class ShadowAtlasAllocator
+{
+private:
+	struct Tile
+	{
+		GLint X, Y;
+	};
+	std::vector<Tile> freeTiles[8]; // per level, level L holds tiles of SHADOW_ATLAS_SIZE >> L
+
+public:
+	ShadowAtlasAllocator()
+	{
+		Tile Root = { 0, 0 };
+		freeTiles[0].push_back(Root);
+	}
+
+	static int GetLevel(GLsizei Size)
+	{
+		int Level = 0;
+		while ((SHADOW_ATLAS_SIZE >> Level) > Size && (SHADOW_ATLAS_SIZE >> (Level + 1)) >= SHADOW_ATLAS_MIN_TILE) Level++;
+		return Level;
+	}
+
+	// a tile of exactly Size texels (a power of two between SHADOW_ATLAS_MIN_TILE and SHADOW_ATLAS_SIZE)
+	bool Allocate(GLsizei Size, GLint& X, GLint& Y)
+	{
+		int Level = GetLevel(Size);
+		int From = Level;
+		while (From >= 0 && freeTiles[From].empty()) From--;
+		if (From < 0) return false;
+
+		Tile t = freeTiles[From].back();
+		freeTiles[From].pop_back();
+		for (; From < Level; From++)
+		{
+			GLint Half = (SHADOW_ATLAS_SIZE >> From) / 2;
+			Tile Siblings[3] = { { t.X + Half, t.Y }, { t.X, t.Y + Half }, { t.X + Half, t.Y + Half } };
+			freeTiles[From + 1].insert(freeTiles[From + 1].end(), Siblings, Siblings + 3);
+		}
+		X = t.X;
+		Y = t.Y;
+		return true;
+	}
+
+	void Free(GLint X, GLint Y, GLsizei Size)
+	{
+		for (int Level = GetLevel(Size); ; Level--)
+		{
+			if (Level == 0)
+			{
+				freeTiles[0].push_back(Tile{ X, Y });
+				return;
+			}
+
+			// the other three quarters of the parent, all free - take them out and free the parent
+			GLint Parent = SHADOW_ATLAS_SIZE >> (Level - 1);
+			GLint PX = X - X % Parent, PY = Y - Y % Parent;
+			std::vector<Tile>& List = freeTiles[Level];
+			size_t Found[3];
+			int Count = 0;
+			for (size_t i = 0; i < List.size() && Count < 3; i++)
+			{
+				bool InParent = List[i].X - List[i].X % Parent == PX && List[i].Y - List[i].Y % Parent == PY;
+				if (InParent && !(List[i].X == X && List[i].Y == Y)) Found[Count++] = i;
+			}
+			if (Count < 3)
+			{
+				List.push_back(Tile{ X, Y });
+				return;
+			}
+			for (int i = 2; i >= 0; i--) List.erase(List.begin() + Found[i]);
+			X = PX;
+			Y = PY;
+		}
+	}
+};
+
+// a slice drawn this frame: Count casters from ShadowAtlasFrame::Casters starting at First
+struct ShadowAtlasSlice
+{
+	glm::mat4 ViewProj;
+	GLint X, Y;
+	GLsizei Size;
+	unsigned int First;
+	unsigned int Count;
+};
+
+// what the jobs of a frame prepare for the atlas: the slices to redraw and, for the lighting
+// shader, world -> atlas (u, v, depth) matrices with the tile rectangles (zero - no shadow)
+struct ShadowAtlasFrame
+{
+	std::vector<ShadowAtlasSlice> Slices;
+	std::vector<glm::mat4> Casters; // world matrices of the casters of all Slices
+	glm::mat4 PointMatrices[MAX_SHADOW_POINT_SLICES]; // six per light: +X, -X, +Y, -Y, +Z, -Z
+	glm::vec4 PointRects[MAX_SHADOW_POINT_SLICES];
+	glm::mat4 SpotMatrices[MAX_SPOT_LIGHTS];
+	glm::vec4 SpotRects[MAX_SPOT_LIGHTS];
+
+	void Clear()
+	{
+		Slices.clear();
+		Casters.clear();
+		for (glm::vec4& r : PointRects) r = glm::vec4(0.0f);
+		for (glm::vec4& r : SpotRects) r = glm::vec4(0.0f);
+	}
+};
+
+// Shadows of point and spot lights in one depth texture: a perspective tile per spot light
+// and six 90 degree tiles per point light, each sized by how much of the screen the light's
+// range covers. A tile keeps its contents while its matrix and its casters stay the same,
+// so a static light over static objects is drawn once and then costs nothing.
+class ShadowAtlas
+{
+private:
+	struct Slot
+	{
+		GLint X, Y;
+		GLsizei Size; // 0 - no tile
+		glm::mat4 ViewProj;
+		uint64_t Casters; // signature of the casters drawn into the tile
+		bool Valid;
+	};
+
+	ShadowMapTechnique technique;
+	InstanceBuffer instances;
+	GLuint fbo;
+	GLuint texture;
+	ShadowAtlasAllocator allocator;
+	Slot slots[SHADOW_ATLAS_SLOTS];
+	std::vector<unsigned int> casterList;
+
+public:
+	ShadowAtlas()
+	{
+		fbo = 0;
+		texture = 0;
+		for (Slot& s : slots)
+		{
+			s.X = s.Y = 0;
+			s.Size = 0;
+			s.Casters = SHADOW_CASTERS_ANIMATED;
+			s.Valid = false;
+		}
+	}
+
+	~ShadowAtlas()
+	{
+		if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+		if (texture != 0) GLStateCache::Get().DeleteTextures(1, &texture);
+	}
+
+	bool Init()
+	{
+		if (!technique.Init() || !instances.Init()) return false;
+
+		glGenTextures(1, &texture);
+		GLStateCache::Get().BindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		GLStateCache::Get().BindTexture(GL_TEXTURE_2D, 0);
+
+		GLint Framebuffer = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &Framebuffer);
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		GLenum Status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
+
+		if (Status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cerr << "Shadow atlas framebuffer error, status: 0x" << std::hex << Status << std::dec << "\n";
+			return false;
+		}
+		return true;
+	}
+
+	// Decides which tiles to redraw for a camera (CameraViewProj, EyePos, TanHalfFOV of its
+	// vertical field of view) and fills Out. Touches no GL state, meant for a frame job.
+	//  Cull(ViewProj, std::vector<unsigned int>& Objects) -> uint64_t: the casters inside a
+	//   light frustum and their signature, SHADOW_CASTERS_ANIMATED if any of them moves by itself
+	//  Transform(const std::vector<unsigned int>& Objects, std::vector<glm::mat4>& World):
+	//   appends their world matrices, called only for tiles that are redrawn
+	template <class C, class T> void Prepare(const glm::mat4& CameraViewProj, const glm::vec3& EyePos, float TanHalfFOV,
+		unsigned int NumPointLights, const PointLight* pPointLights, unsigned int NumSpotLights, const SpotLight* pSpotLights,
+		C Cull, T Transform, ShadowAtlasFrame& Out)
+	{
+		static const glm::vec3 Faces[6] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+
+		Out.Clear();
+		Frustum Camera;
+		Camera.FromViewProj(CameraViewProj);
+
+		for (unsigned int i = 0; i < (unsigned int)MAX_POINT_LIGHTS; i++)
+		{
+			GLsizei Size = 0;
+			float Range = 0.0f;
+			if (i < NumPointLights)
+			{
+				Range = std::min(CalcPointLightRadius(pPointLights[i]), SHADOW_ATLAS_MAX_RANGE);
+				Size = GetTileSize(Camera, EyePos, TanHalfFOV, pPointLights[i].Position, Range, SHADOW_ATLAS_MAX_POINT_TILE);
+			}
+			for (unsigned int f = 0; f < 6; f++)
+			{
+				unsigned int s = i * 6 + f;
+				glm::mat4 ViewProj(0.0f); // no tile
+				if (Size > 0) ViewProj = LookAtPerspective(pPointLights[i].Position, Faces[f], 90.0f, Range);
+				UpdateSlot(s, Size, ViewProj, Cull, Transform, Out, Out.PointMatrices[s], Out.PointRects[s]);
+			}
+		}
+
+		for (unsigned int i = 0; i < (unsigned int)MAX_SPOT_LIGHTS; i++)
+		{
+			GLsizei Size = 0;
+			glm::mat4 ViewProj(0.0f);
+			if (i < NumSpotLights)
+			{
+				float Range = std::min(CalcPointLightRadius(pSpotLights[i]), SHADOW_ATLAS_MAX_RANGE);
+				Size = GetTileSize(Camera, EyePos, TanHalfFOV, pSpotLights[i].Position, Range, SHADOW_ATLAS_MAX_SPOT_TILE);
+				float FOV = std::min(2.0f * pSpotLights[i].Cutoff, SHADOW_ATLAS_MAX_SPOT_FOV);
+				if (Size > 0) ViewProj = LookAtPerspective(pSpotLights[i].Position, pSpotLights[i].Direction, FOV, Range);
+			}
+			unsigned int s = MAX_SHADOW_POINT_SLICES + i;
+			UpdateSlot(s, Size, ViewProj, Cull, Transform, Out, Out.SpotMatrices[i], Out.SpotRects[i]);
+		}
+	}
+
+	// redraws the tiles of Frame; DrawCasters(Count) issues one instanced draw, the mesh VAO
+	// must be bound because the instance attributes are set up in it
+	template <class T> void Render(const ShadowAtlasFrame& Frame, T DrawCasters)
+	{
+		if (Frame.Slices.empty()) return;
+
+		GLint Viewport[4], Framebuffer = 0;
+		glGetIntegerv(GL_VIEWPORT, Viewport);
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &Framebuffer);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glEnable(GL_SCISSOR_TEST); // the clear of a tile leaves the others alone
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(2.0f, 4.0f);
+		technique.Enable();
+		instances.Upload(Frame.Casters.data(), (unsigned int)Frame.Casters.size());
+
+		for (const ShadowAtlasSlice& Slice : Frame.Slices)
+		{
+			glViewport(Slice.X, Slice.Y, Slice.Size, Slice.Size);
+			glScissor(Slice.X, Slice.Y, Slice.Size, Slice.Size);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			if (Slice.Count == 0) continue;
+
+			instances.Bind(Slice.First);
+			technique.SetLightViewProj(&Slice.ViewProj);
+			DrawCasters(Slice.Count);
+		}
+		instances.Unbind();
+
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glDisable(GL_SCISSOR_TEST);
+		glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
+		glViewport(Viewport[0], Viewport[1], Viewport[2], Viewport[3]);
+	}
+
+	void Bind(GLuint TextureUnit)
+	{
+		GLStateCache::Get().BindTexture(GL_TEXTURE0 + TextureUnit, GL_TEXTURE_2D, texture);
+		GLStateCache::Get().ActiveTexture(GL_TEXTURE0);
+	}
+
+private:
+	// the largest tile the light's range covers on screen, 0 if it is not seen at all
+	static GLsizei GetTileSize(const Frustum& Camera, const glm::vec3& EyePos, float TanHalfFOV, const glm::vec3& Position, float Range, GLsizei MaxSize)
+	{
+		if (Range <= 0.0f || !Camera.SphereVisible(Position, Range)) return 0;
+
+		float Distance = glm::distance(EyePos, Position);
+		float Coverage = Distance <= Range ? 1.0f : std::min(1.0f, Range / (Distance * TanHalfFOV));
+		GLsizei Size = SHADOW_ATLAS_MIN_TILE;
+		while (Size < MaxSize && Size < Coverage * MaxSize) Size *= 2;
+		return Size;
+	}
+
+	template <class C, class T> void UpdateSlot(unsigned int s, GLsizei Size, const glm::mat4& ViewProj, C& Cull, T& Transform,
+		ShadowAtlasFrame& Out, glm::mat4& AtlasMatrix, glm::vec4& Rect)
+	{
+		Slot& Tile = slots[s];
+		if (Tile.Size != Size)
+		{
+			if (Tile.Size != 0) allocator.Free(Tile.X, Tile.Y, Tile.Size);
+			Tile.Size = 0;
+			Tile.Valid = false;
+			// a full atlas gives smaller tiles
+			for (GLsizei Try = Size; Try >= SHADOW_ATLAS_MIN_TILE && Tile.Size == 0; Try /= 2)
+			{
+				if (allocator.Allocate(Try, Tile.X, Tile.Y)) Tile.Size = Try;
+			}
+		}
+		if (Tile.Size == 0) return;
+
+		uint64_t Casters = Cull(ViewProj, casterList);
+		bool Redraw = !Tile.Valid || Casters == SHADOW_CASTERS_ANIMATED || Casters != Tile.Casters ||
+			memcmp(&ViewProj, &Tile.ViewProj, sizeof(glm::mat4)) != 0;
+		if (Redraw)
+		{
+			ShadowAtlasSlice Slice = { ViewProj, Tile.X, Tile.Y, Tile.Size, (unsigned int)Out.Casters.size(), (unsigned int)casterList.size() };
+			Transform(casterList, Out.Casters);
+			Out.Slices.push_back(Slice);
+			Tile.ViewProj = ViewProj;
+			Tile.Casters = Casters;
+			Tile.Valid = true;
+		}
+
+		// clip space -> atlas: the tile takes the [-1, 1] square, depth goes to [0, 1];
+		// the rectangle is half a texel inside the tile so filtering never reads a neighbour
+		float Scale = 0.5f * Tile.Size / SHADOW_ATLAS_SIZE;
+		glm::mat4 ToTile(0.0f);
+		ToTile[0][0] = Scale;	ToTile[0][3] = (Tile.X + 0.5f * Tile.Size) / SHADOW_ATLAS_SIZE;
+		ToTile[1][1] = Scale;	ToTile[1][3] = (Tile.Y + 0.5f * Tile.Size) / SHADOW_ATLAS_SIZE;
+		ToTile[2][2] = 0.5f;	ToTile[2][3] = 0.5f;
+		ToTile[3][3] = 1.0f;
+		AtlasMatrix = Concatenate(ToTile, ViewProj);
+		Rect = glm::vec4(Tile.X + 0.5f, Tile.Y + 0.5f, Tile.X + Tile.Size - 0.5f, Tile.Y + Tile.Size - 0.5f) / (float)SHADOW_ATLAS_SIZE;
+	}
+
+	// perspective projection times the view from Position along Direction, rows like the Pipeline matrices
+	static glm::mat4 LookAtPerspective(const glm::vec3& Position, const glm::vec3& Direction, float FOV, float Range)
+	{
+		glm::vec3 N = glm::normalize(Direction);
+		glm::vec3 Up = fabsf(N.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		glm::vec3 U = glm::normalize(glm::cross(Up, N));
+		glm::vec3 V = glm::cross(N, U);
+
+		glm::mat4 View(0.0f);
+		View[0][0] = U.x;	View[0][1] = U.y;	View[0][2] = U.z;	View[0][3] = -glm::dot(U, Position);
+		View[1][0] = V.x;	View[1][1] = V.y;	View[1][2] = V.z;	View[1][3] = -glm::dot(V, Position);
+		View[2][0] = N.x;	View[2][1] = N.y;	View[2][2] = N.z;	View[2][3] = -glm::dot(N, Position);
+		View[3][3] = 1.0f;
+
+		float n = SHADOW_ATLAS_NEAR, f = Range;
+		float Focal = 1.0f / tanf(glm::radians(FOV / 2.0f));
+		glm::mat4 Proj(0.0f);
+		Proj[0][0] = Focal;
+		Proj[1][1] = Focal;
+		Proj[2][2] = (f + n) / (f - n);	Proj[2][3] = 2.0f * f * n / (n - f);
+		Proj[3][2] = 1.0f;
+		return Concatenate(Proj, View);
+	}
+
+	// a * b of row-major matrices: b is applied first
+	static glm::mat4 Concatenate(const glm::mat4& a, const glm::mat4& b)
+	{
+		glm::mat4 r;
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				r[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j] + a[i][3] * b[3][j];
+			}
+		}
+		return r;
+	}
+};
@@ -0,0 +1,332 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+#include "Technique.h"
+#include "Pipeline.h"
+#include "LightingTechnique.h"
+#include "Instancing.h"
+#include "GLStateCache.h"
+
+// depth only: the instanced vertex shader without texture coordinates, normals and outputs;
+// the mesh VAO of the main pass is bound when it draws, with the casters' own instances
+static const char* shadowVertex = R"(
+	#version 330 core
+
+	layout (location = 0) in vec3 Position;
+	layout (location = 3) in mat4 InstanceWorld;
+
+	uniform mat4 gLightViewProj;
+
+	void main()
+	{
+		gl_Position = gLightViewProj * (vec4(Position, 1.0) * InstanceWorld);
+	})";
+
+static const char* shadowFragment = R"(
+	#version 330 core
+
+	void main()
+	{
+	})";
+
+class ShadowMapTechnique : public Technique
+{
+private:
+	GLuint gLightViewProjLocation;
+
+public:
+	ShadowMapTechnique()
+	{
+		gLightViewProjLocation = 0;
+	}
+
+	virtual bool Init() override
+	{
+		if (!Technique::Init()) return false;
+		if (!createShaders(shadowVertex, shadowFragment)) return false;
+
+		gLightViewProjLocation = GetUniformLocation("gLightViewProj");
+		return true;
+	}
+
+	void SetLightViewProj(const glm::mat4* value)
+	{
+		glUniformMatrix4fv(gLightViewProjLocation, 1, GL_TRUE, (const GLfloat*)value);
+	}
+};
+
+enum SHADOW_QUALITY
+{
+	SHADOW_QUALITY_OFF,
+	SHADOW_QUALITY_LOW,
+	SHADOW_QUALITY_MEDIUM,
+	SHADOW_QUALITY_HIGH,
+	SHADOW_QUALITY_COUNT
+};
+
+// what a quality level costs: one depth pass per cascade, Resolution^2 texels each,
+// (2 * PcfRadius + 1)^2 filtered taps per lit pixel
+struct ShadowPreset
+{
+	unsigned int Cascades;
+	GLsizei Resolution;
+	int PcfRadius;
+	float Distance; // shadows end here even if the camera sees further
+};
+
+inline const ShadowPreset& GetShadowPreset(SHADOW_QUALITY Quality)
+{
+	static const ShadowPreset Presets[SHADOW_QUALITY_COUNT] =
+	{
+		{ 0, 0, 0, 0.0f },
+		{ 2, 1024, 0, 30.0f },
+		{ 3, 2048, 1, 50.0f },
+		{ MAX_SHADOW_CASCADES, 2048, 2, 80.0f },
+	};
+	return Presets[Quality];
+}
+
+// light space matrices of one frame, cascade i covers view depths [Splits[i], Splits[i + 1]]
+// and draws CasterCount[i] casters from Casters starting at First[i]
+struct ShadowCascades
+{
+	unsigned int Count;
+	glm::mat4 ViewProj[MAX_SHADOW_CASCADES];
+	float Splits[MAX_SHADOW_CASCADES + 1];
+	std::vector<glm::mat4> Casters; // world matrices of the casters of every cascade
+	unsigned int First[MAX_SHADOW_CASCADES];
+	unsigned int CasterCount[MAX_SHADOW_CASCADES];
+
+	ShadowCascades()
+	{
+		Count = 0;
+		for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++) First[i] = CasterCount[i] = 0;
+	}
+};
+
+// Cascaded shadow map of the directional light. The camera frustum up to the preset's
+// Distance is cut into slices (log/linear split), each slice gets an orthographic
+// projection along the light that encloses its bounding sphere, and all of them are
+// layers of one depth texture array sampled with hardware comparison.
+// The sphere keeps the projection size constant while the camera turns and its origin
+// moves in whole texels, so shadow edges do not shimmer.
+class CascadedShadowMap
+{
+private:
+	ShadowMapTechnique technique;
+	InstanceBuffer instances;
+	GLuint fbo;
+	GLuint texture; // GL_TEXTURE_2D_ARRAY, one layer per cascade
+	SHADOW_QUALITY quality;
+	ShadowPreset preset;
+
+public:
+	CascadedShadowMap()
+	{
+		fbo = 0;
+		texture = 0;
+		quality = SHADOW_QUALITY_OFF;
+		preset = GetShadowPreset(quality);
+	}
+
+	~CascadedShadowMap()
+	{
+		if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+		if (texture != 0) GLStateCache::Get().DeleteTextures(1, &texture);
+	}
+
+	bool Init(SHADOW_QUALITY Quality)
+	{
+		if (!technique.Init() || !instances.Init()) return false;
+		glGenFramebuffers(1, &fbo);
+		return SetQuality(Quality);
+	}
+
+	// reallocates the texture array when the cascade count or resolution changes
+	bool SetQuality(SHADOW_QUALITY Quality)
+	{
+		const ShadowPreset& Preset = GetShadowPreset(Quality);
+		bool Realloc = Preset.Cascades != preset.Cascades || Preset.Resolution != preset.Resolution;
+		quality = Quality;
+		preset = Preset;
+		if (!Realloc) return true;
+
+		if (texture != 0) GLStateCache::Get().DeleteTextures(1, &texture);
+		texture = 0;
+		if (preset.Cascades == 0) return true;
+
+		glGenTextures(1, &texture);
+		GLStateCache::Get().BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, preset.Resolution, preset.Resolution, preset.Cascades, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		// LINEAR with a comparison mode gives a bilinear 2x2 PCF in every tap
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		GLStateCache::Get().BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		GLint Framebuffer = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &Framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		GLenum Status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
+
+		if (Status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cerr << "Shadow map framebuffer error, status: 0x" << std::hex << Status << std::dec << "\n";
+			return false;
+		}
+		return true;
+	}
+
+	SHADOW_QUALITY GetQuality() const
+	{
+		return quality;
+	}
+
+	int GetPcfRadius() const
+	{
+		return preset.PcfRadius;
+	}
+
+	// Cascades for the camera of CameraViewProj (Proj - its projection parameters) and a light
+	// shining along LightDirection. SceneMin/SceneMax bound every caster: the near plane of each
+	// cascade is pulled back to them, so objects between the light and the slice still cast;
+	// those are mostly outside the camera's view, so the casters of a cascade are the objects
+	// inside its ViewProj, not the visible ones. Fills neither Casters nor their ranges.
+	// Touches no GL state, can run in a job.
+	void Fit(const glm::mat4& CameraViewProj, const m_persProj& Proj, const glm::vec3& LightDirection,
+		const glm::vec3& SceneMin, const glm::vec3& SceneMax, ShadowCascades& Out) const
+	{
+		Out.Count = preset.Cascades;
+		if (Out.Count == 0) return;
+
+		// frustum corners: NDC z -1 is the near plane, +1 the far plane
+		glm::mat4 InvViewProj = glm::inverse(CameraViewProj);
+		glm::vec3 Near[4], Far[4];
+		for (int i = 0; i < 4; i++)
+		{
+			float x = (i & 1) ? 1.0f : -1.0f, y = (i & 2) ? 1.0f : -1.0f;
+			Near[i] = Unproject(InvViewProj, glm::vec4(x, y, -1.0f, 1.0f));
+			Far[i] = Unproject(InvViewProj, glm::vec4(x, y, 1.0f, 1.0f));
+		}
+
+		// the practical split scheme: logarithmic splits blended with uniform ones
+		const float Lambda = 0.75f;
+		float n = Proj.zNear, f = std::min(Proj.zFar, preset.Distance);
+		for (unsigned int i = 0; i <= Out.Count; i++)
+		{
+			float t = (float)i / Out.Count;
+			Out.Splits[i] = Lambda * n * powf(f / n, t) + (1.0f - Lambda) * (n + (f - n) * t);
+		}
+
+		glm::vec3 N = glm::normalize(LightDirection);
+		glm::vec3 Up = fabsf(N.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		glm::vec3 U = glm::normalize(glm::cross(Up, N));
+		glm::vec3 V = glm::cross(N, U);
+
+		float SceneNear = FLT_MAX;
+		if (SceneMin.x <= SceneMax.x)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				glm::vec3 Corner((i & 1) ? SceneMax.x : SceneMin.x, (i & 2) ? SceneMax.y : SceneMin.y, (i & 4) ? SceneMax.z : SceneMin.z);
+				SceneNear = std::min(SceneNear, glm::dot(N, Corner));
+			}
+		}
+
+		for (unsigned int c = 0; c < Out.Count; c++)
+		{
+			// the view depth varies linearly along every edge of the frustum
+			float t0 = (Out.Splits[c] - Proj.zNear) / (Proj.zFar - Proj.zNear);
+			float t1 = (Out.Splits[c + 1] - Proj.zNear) / (Proj.zFar - Proj.zNear);
+			glm::vec3 Corners[8];
+			glm::vec3 Center(0.0f);
+			for (int i = 0; i < 4; i++)
+			{
+				Corners[i] = glm::mix(Near[i], Far[i], t0);
+				Corners[i + 4] = glm::mix(Near[i], Far[i], t1);
+				Center += Corners[i] + Corners[i + 4];
+			}
+			Center /= 8.0f;
+
+			float Radius = 0.0f;
+			for (int i = 0; i < 8; i++) Radius = std::max(Radius, glm::distance(Corners[i], Center));
+			Radius = ceilf(Radius * 16.0f) / 16.0f;
+
+			float Texel = 2.0f * Radius / preset.Resolution;
+			float cx = floorf(glm::dot(U, Center) / Texel) * Texel;
+			float cy = floorf(glm::dot(V, Center) / Texel) * Texel;
+			float cz = glm::dot(N, Center);
+			float zNear = std::min(SceneNear, cz - Radius), zFar = cz + Radius;
+			float sz = 2.0f / (zFar - zNear);
+
+			// rows of (ortho projection) x (light view), built directly
+			glm::mat4& m = Out.ViewProj[c];
+			m[0][0] = U.x / Radius;	m[0][1] = U.y / Radius;	m[0][2] = U.z / Radius;	m[0][3] = -cx / Radius;
+			m[1][0] = V.x / Radius;	m[1][1] = V.y / Radius;	m[1][2] = V.z / Radius;	m[1][3] = -cy / Radius;
+			m[2][0] = N.x * sz;		m[2][1] = N.y * sz;		m[2][2] = N.z * sz;		m[2][3] = -zNear * sz - 1.0f;
+			m[3][0] = 0.0f;			m[3][1] = 0.0f;			m[3][2] = 0.0f;			m[3][3] = 1.0f;
+		}
+	}
+
+	// one depth pass per cascade; DrawCasters(Count) issues one instanced draw, the mesh VAO
+	// must be bound because the instance attributes are set up in it
+	template <class T> void Render(const ShadowCascades& Cascades, T DrawCasters)
+	{
+		if (texture == 0) return;
+
+		GLint Viewport[4], Framebuffer = 0;
+		glGetIntegerv(GL_VIEWPORT, Viewport);
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &Framebuffer);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glViewport(0, 0, preset.Resolution, preset.Resolution);
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(2.0f, 4.0f); // slope scaled bias against shadow acne
+		technique.Enable();
+		instances.Upload(Cascades.Casters.data(), (unsigned int)Cascades.Casters.size());
+
+		unsigned int Count = std::min(Cascades.Count, preset.Cascades);
+		for (unsigned int i = 0; i < Count; i++)
+		{
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, i);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			if (Cascades.CasterCount[i] == 0) continue;
+
+			instances.Bind(Cascades.First[i]);
+			technique.SetLightViewProj(&Cascades.ViewProj[i]);
+			DrawCasters(Cascades.CasterCount[i]);
+		}
+		instances.Unbind();
+
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
+		glViewport(Viewport[0], Viewport[1], Viewport[2], Viewport[3]);
+	}
+
+	void Bind(GLuint TextureUnit)
+	{
+		GLStateCache::Get().BindTexture(GL_TEXTURE0 + TextureUnit, GL_TEXTURE_2D_ARRAY, texture);
+		GLStateCache::Get().ActiveTexture(GL_TEXTURE0);
+	}
+
+private:
+	// the rows of the matrix times the column v, then the perspective divide
+	static glm::vec3 Unproject(const glm::mat4& m, const glm::vec4& v)
+	{
+		glm::vec4 r(glm::dot(m[0], v), glm::dot(m[1], v), glm::dot(m[2], v), glm::dot(m[3], v));
+		return glm::vec3(r.x, r.y, r.z) / r.w;
+	}
+};
@@ -4,18 +4,85 @@
 #include <glm/glm.hpp>	//#include "math_3d.h" - vector
 #include <Magick++.h>
 #include "Main.h"
+#include "MeshConverter.h"
+#include "HeadlessBackend.h"
+#include "FrameBenchmark.h"
+#include "BvhTest.h"
 
 
+// lr3 --convert model.obj|model.ply model.mesh [compact] - converts a mesh and exits
+// lr3 --mesh model.mesh                                 - draws the mesh instead of the pyramid
+// lr3 --fps 30 --no-vsync                               - frame rate limit and no waiting for vertical sync
+// lr3 --benchmark [frames] [--out result.json] [--baseline old.json] [--tolerance percent]
+//                                                       - renders without a window and prints the
+//                                                         frame times as JSON, exits with 2 on a regression
+// lr3 --test                                            - checks of the CPU code against references, exits with 1 on a failure
 int main(int argc, char** argv)
 {
+	if (argc >= 4 && strcmp(argv[1], "--convert") == 0)
+	{
+		VERTEX_LAYOUT Layout = argc >= 5 && strcmp(argv[4], "compact") == 0 ? VERTEX_LAYOUT_COMPACT : VERTEX_LAYOUT_FULL;
+		return ConvertMesh(argv[2], argv[3], Layout) ? 0 : 1;
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "--test") == 0)
+	{
+		bool Passed = TestNormalGeneration();
+		Passed = TestBoundingVolumeHierarchy() && Passed;
+		std::cout << (Passed ? "All tests passed\n" : "Tests failed\n");
+		return Passed ? 0 : 1;
+	}
+
+	const char* pMeshFile = nullptr;
+	bool Benchmark = false;
+	unsigned int Frames = 600;
+	const char* pOutFile = nullptr;
+	const char* pBaselineFile = nullptr;
+	double Tolerance = 10.0;
+	FrameSchedulerSettings Schedule;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) pMeshFile = argv[++i];
+		else if (strcmp(argv[i], "--benchmark") == 0)
+		{
+			Benchmark = true;
+			if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) Frames = (unsigned int)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) pOutFile = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) pBaselineFile = argv[++i];
+		else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) Tolerance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) Schedule.TargetFPS = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--no-vsync") == 0) Schedule.VSync = false;
+	}
+
+	if (Benchmark)
+	{
+		if (!HeadlessBackendInit(argc, argv, WINDOW_WIDTH, WINDOW_HEIGHT)) return 1;
+		InitRenderState();
+		Magick::InitializeMagick(nullptr);
+
+		Main* MainProgram = new Main(pMeshFile);
+		if (!MainProgram->Init()) return 1;
+		MainProgram->SetOutputFramebuffer(HeadlessBackendGetFramebuffer());
+
+		FrameBenchmarkResult Result = RunFrameBenchmark(*MainProgram, Frames, DefaultFrameBenchmarkScript(Frames));
+		delete MainProgram;
+		HeadlessBackendShutdown();
+
+		std::string Json = FrameBenchmarkToJson(Result);
+		std::cout << Json;
+		if (pOutFile != nullptr) std::ofstream(pOutFile) << Json;
+		return pBaselineFile == nullptr || CheckFrameBenchmark(Result, pBaselineFile, Tolerance) ? 0 : 2;
+	}
+
 	GLUTBackendInit(argc, argv);
 	GLUTBackendCreateWindow(1980, 1250, "OpenGL tutors");
 	Magick::InitializeMagick(nullptr);
 
-	Main* MainProgram = new Main();
+	Main* MainProgram = new Main(pMeshFile);
 	if (!MainProgram->Init()) return 1;
 
-	MainProgram->Run();
+	MainProgram->Run(Schedule);
 
 	delete MainProgram;
 
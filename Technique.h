@@ -4,6 +4,15 @@
 #include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
 #include <glm/glm.hpp>	//#include "math_3d.h" - vector
 #include <list>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ProgramCache.h"
+#include "GLStateCache.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 class Technique
 {
@@ -11,6 +20,18 @@ private:
     GLuint ShaderProgram;
     GLint success;
     GLchar InfoLog[1024];
+    std::string defines; // inserted after the #version line of every shader
+    std::unordered_map<std::string, GLint> uniformLocations; // every active uniform, filled at link time
+    GLuint pendingShaders[2]; // compiled and linked by beginShaders, checked by finishShaders
+    uint64_t programKey; // program cache key of the pending link, 0 without a cache
+    bool linkPending;
+
+    // shared by all techniques, see SetProgramCache
+    static ProgramCache*& programCache()
+    {
+        static ProgramCache* pCache = nullptr;
+        return pCache;
+    }
 
 public:
     Technique() 
@@ -18,6 +39,9 @@ public:
         ShaderProgram = 0;
         InfoLog[1024] = { 0 };
         success = 0;
+        pendingShaders[0] = pendingShaders[1] = 0;
+        programKey = 0;
+        linkPending = false;
     }
 
     ~Technique() 
@@ -25,7 +49,7 @@ public:
 
         if (ShaderProgram != 0) 
         {
-            glDeleteProgram(ShaderProgram);
+            GLStateCache::Get().DeleteProgram(ShaderProgram);
             ShaderProgram = 0;
         }
     }
@@ -43,11 +67,20 @@ public:
 
     void Enable() 
     {
-        glUseProgram(ShaderProgram);
+        GLStateCache::Get().UseProgram(ShaderProgram);
+    }
+
+    // programs compiled or loaded from now on go through the cache, nullptr turns it off
+    static void SetProgramCache(ProgramCache* pCache)
+    {
+        programCache() = pCache;
     }
 
     GLint GetUniformLocation(const char* pUniformName)
     {
+        auto Found = uniformLocations.find(pUniformName);
+        if (Found != uniformLocations.end()) return Found->second;
+
         GLint Location = glGetUniformLocation(ShaderProgram, pUniformName);
 
         if (Location == 0xFFFFFFFF)
@@ -56,14 +89,62 @@ public:
         return Location;
     }
 
+    // attaches the named uniform block of the program to a buffer binding point
+    bool BindUniformBlock(const char* pBlockName, GLuint BindingPoint)
+    {
+        GLuint Index = glGetUniformBlockIndex(ShaderProgram, pBlockName);
+
+        if (Index == GL_INVALID_INDEX)
+        {
+            std::cerr << "Warning!Unable to get the index of uniform block ' " << pBlockName << "'\n";
+            return 0;
+        }
+
+        glUniformBlockBinding(ShaderProgram, Index, BindingPoint);
+        return 1;
+    }
+
 protected:
+    // must be called before the shaders are compiled
+    void AddDefine(const char* pName, int Value = 1)
+    {
+        defines += "#define ";
+        defines += pName;
+        defines += " " + std::to_string(Value) + "\n";
+    }
+
     bool addshader(const char* ShaderText, GLenum ShaderType)
+    {
+        return addshader(&ShaderText, 1, ShaderType);
+    }
+
+    // compiles a shader whose source is split into several parts, concatenated in the given order
+    bool addshader(const char* const* ShaderTexts, GLsizei Count, GLenum ShaderType)
+    {
+        return addshader(buildSource(ShaderTexts, Count), ShaderType);
+    }
+
+    // the parts joined, with the defines right after the #version line, which has to stay first
+    std::string buildSource(const char* const* ShaderTexts, GLsizei Count)
+    {
+        std::string Source;
+        for (GLsizei i = 0; i < Count; i++) Source += ShaderTexts[i];
+
+        if (!defines.empty())
+        {
+            size_t Version = Source.find("#version");
+            size_t LineEnd = Version == std::string::npos ? std::string::npos : Source.find('\n', Version);
+            Source.insert(LineEnd == std::string::npos ? 0 : LineEnd + 1, defines);
+        }
+        return Source;
+    }
+
+    bool addshader(const std::string& Source, GLenum ShaderType)
     {
         GLuint shader = glCreateShader(ShaderType);
 
-        const GLchar* ShaderSource[1];
-        ShaderSource[0] = ShaderText;
-        glShaderSource(shader, 1, ShaderSource, nullptr);
+        const char* pSource = Source.c_str();
+        glShaderSource(shader, 1, &pSource, nullptr);
         glCompileShader(shader);
 
         // Checking for vertex shader compilation errors
@@ -77,20 +158,128 @@ protected:
 
     bool createShaders(const char* ShaderText_v, const char* ShaderText_f)
     {
-        addshader(ShaderText_v, GL_VERTEX_SHADER);
-        addshader(ShaderText_f, GL_FRAGMENT_SHADER);
+        return createShaders(&ShaderText_v, 1, &ShaderText_f, 1);
+    }
 
-        // Checking for shader binding errors
+    bool createShaders(const char* const* ShaderTexts_v, GLsizei Count_v, const char* const* ShaderTexts_f, GLsizei Count_f)
+    {
+        return beginShaders(ShaderTexts_v, Count_v, ShaderTexts_f, Count_f) && finishShaders();
+    }
+
+    // Issues compiling and linking without asking for the result, so a driver with
+    // KHR_parallel_shader_compile works on it in the background until finishShaders
+    // (isLinkComplete tells when that will not block). A program from the cache is done at once.
+    bool beginShaders(const char* const* ShaderTexts_v, GLsizei Count_v, const char* const* ShaderTexts_f, GLsizei Count_f)
+    {
+        std::string Source_v = buildSource(ShaderTexts_v, Count_v);
+        std::string Source_f = buildSource(ShaderTexts_f, Count_f);
+
+        // a stored binary replaces compiling and linking
+        ProgramCache* pCache = programCache();
+        programKey = 0;
+        if (pCache != nullptr && pCache->IsSupported())
+        {
+            programKey = pCache->MakeKey(Source_v, Source_f);
+            std::vector<UniformLocation> Uniforms;
+            if (pCache->Load(programKey, ShaderProgram, Uniforms))
+            {
+                uniformLocations.clear();
+                for (const UniformLocation& Uniform : Uniforms) uniformLocations[Uniform.Name] = Uniform.Location;
+                linkPending = false;
+                return 1;
+            }
+            glProgramParameteri(ShaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+
+        const std::string* Sources[2] = { &Source_v, &Source_f };
+        GLenum Types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+        for (int i = 0; i < 2; i++)
+        {
+            pendingShaders[i] = glCreateShader(Types[i]);
+            const char* pSource = Sources[i]->c_str();
+            glShaderSource(pendingShaders[i], 1, &pSource, nullptr);
+            glCompileShader(pendingShaders[i]);
+            glAttachShader(ShaderProgram, pendingShaders[i]);
+        }
         glLinkProgram(ShaderProgram);
+        linkPending = true;
+        return 1;
+    }
+
+    bool isLinkComplete()
+    {
+        if (!linkPending || !(GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile)) return true;
+
+        GLint Done = 0;
+        glGetProgramiv(ShaderProgram, GL_COMPLETION_STATUS_KHR, &Done);
+        return Done != 0;
+    }
+
+    // checks the results of beginShaders, blocks if the driver is not done yet
+    bool finishShaders()
+    {
+        if (!linkPending) return 1;
+        linkPending = false;
+
+        GLenum Types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+        for (int i = 0; i < 2; i++)
+        {
+            glGetShaderiv(pendingShaders[i], GL_COMPILE_STATUS, &success);
+            if (!checkerror(pendingShaders[i], success, Types[i])) return 0;
+        }
+
+        // Checking for shader binding errors
         glGetProgramiv(ShaderProgram, GL_LINK_STATUS, &success);
         if (!checkerror(ShaderProgram, success, -1)) return 0;
 
         glValidateProgram(ShaderProgram);
         if (!checkerror(ShaderProgram, success, -2)) return 0;
 
+        std::vector<UniformLocation> Uniforms = collectUniforms();
+        uniformLocations.clear();
+        for (const UniformLocation& Uniform : Uniforms) uniformLocations[Uniform.Name] = Uniform.Location;
+        if (programKey != 0) programCache()->Store(programKey, ShaderProgram, Uniforms);
+
         return 1;
     }
 
+    // locations of all active uniforms outside of blocks; arrays are listed under
+    // their plain name and every element
+    std::vector<UniformLocation> collectUniforms()
+    {
+        std::vector<UniformLocation> Uniforms;
+        GLint Count = 0, MaxLength = 0;
+        glGetProgramiv(ShaderProgram, GL_ACTIVE_UNIFORMS, &Count);
+        glGetProgramiv(ShaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &MaxLength);
+
+        std::vector<GLchar> Name(MaxLength + 1);
+        for (GLint i = 0; i < Count; i++)
+        {
+            GLsizei Length = 0;
+            GLint Size = 0;
+            GLenum Type = 0;
+            glGetActiveUniform(ShaderProgram, (GLuint)i, (GLsizei)Name.size(), &Length, &Size, &Type, Name.data());
+
+            UniformLocation Uniform;
+            Uniform.Name.assign(Name.data(), Length);
+            Uniform.Location = glGetUniformLocation(ShaderProgram, Uniform.Name.c_str());
+            if (Uniform.Location < 0) continue; // member of a uniform block
+            Uniforms.push_back(Uniform);
+
+            size_t Bracket = Uniform.Name.size() > 3 ? Uniform.Name.size() - 3 : std::string::npos;
+            if (Bracket == std::string::npos || Uniform.Name.compare(Bracket, 3, "[0]") != 0) continue;
+
+            std::string Base = Uniform.Name.substr(0, Bracket);
+            Uniforms.push_back(UniformLocation{ Base, Uniform.Location });
+            for (GLint Element = 1; Element < Size; Element++)
+            {
+                std::string ElementName = Base + "[" + std::to_string(Element) + "]";
+                Uniforms.push_back(UniformLocation{ ElementName, glGetUniformLocation(ShaderProgram, ElementName.c_str()) });
+            }
+        }
+        return Uniforms;
+    }
+
     bool checkerror(GLuint program, GLint success, GLenum ShaderType)
     {
         if (!success)
@@ -4,6 +4,29 @@
 #include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
 #include <glm/glm.hpp>	//#include "math_3d.h" - vector
 #include <Magick++.h>
+#include <memory>
+#include <cstdint>
+#include "CompressedTexture.h"
+#include "GLStateCache.h"
+
+class Texture;
+
+// one decoded image: Pixels for ordinary images, Compressed for .dds/.ktx files;
+// for asynchronous loads the decoding thread fills it and the GL thread uploads it
+struct TextureRequest
+{
+    std::string FileName;
+    Texture* pTarget; // only touched on the GL thread, nullptr once the texture is destroyed
+    Magick::Blob Pixels; // RGBA
+    CompressedImage Compressed; // Format != 0 if the file was block compressed
+    GLsizei Width;
+    GLsizei Height;
+    bool Failed;
+    bool HashContents; // the decoding thread hashes the file as well
+    uint64_t Hash; // of the file contents, 0 if it could not be read
+
+    TextureRequest() : pTarget(nullptr), Width(0), Height(0), Failed(false), HashContents(false), Hash(0) { }
+};
 
 class Texture
 {
@@ -11,45 +34,154 @@ private:
     std::string m_fileName;
     GLenum m_textureTarget;
     GLuint m_textureObj;
-    Magick::Image* m_pImage;
-    Magick::Blob m_blob;
+    bool m_ready; // false while the placeholder is in the texture object
+    size_t m_memorySize; // bytes of all levels in video memory
+    std::shared_ptr<TextureRequest> m_request; // the pending asynchronous load
+    uint64_t m_contentHash; // of the file, valid once m_contentHashed
+    bool m_contentHashed;
 public:
     Texture(GLenum TextureTarget, const std::string& FileName)
     {
         m_textureTarget = TextureTarget; //   GL_TEXTURE_2D
         m_fileName = FileName;
-        m_pImage = nullptr;
+        m_textureObj = 0;
+        m_ready = false;
+        m_memorySize = 0;
+        m_contentHash = 0;
+        m_contentHashed = false;
+    }
+
+    ~Texture()
+    {
+        if (m_request) m_request->pTarget = nullptr; // the streamer drops the decoded image
+        if (m_textureObj != 0) GLStateCache::Get().DeleteTextures(1, &m_textureObj);
     }
 
     bool Load() // load the file and prepare the memory to load the file to OpenGL
     {
+        TextureRequest Image;
+        Image.FileName = m_fileName;
+        if (!Decode(Image)) return false;
+
+        CreateObject();
+        if (Image.Compressed.Format != 0) SetCompressedImage(Image.Compressed, Image.Compressed.Data.data());
+        else SetImage(Image.Width, Image.Height, Image.Pixels.data());
+        // the decoded copy goes out of scope here, only the GL copy remains
+        return true;
+    }
+
+    // creates the texture object with a 1x1 placeholder and leaves the decoding to a
+    // TextureStreamer, the placeholder is sampled until the streamer uploads the image
+    void BeginAsyncLoad(std::shared_ptr<TextureRequest>& Request)
+    {
+        CreateObject();
+        const GLubyte Grey[4] = { 128, 128, 128, 255 };
+        SetImage(1, 1, Grey);
+        m_ready = false;
+
+        Request = std::make_shared<TextureRequest>();
+        Request->FileName = m_fileName;
+        Request->pTarget = this;
+        m_request = Request;
+    }
+
+    // pPixels is RGBA, or an offset into the bound GL_PIXEL_UNPACK_BUFFER
+    void SetImage(GLsizei Width, GLsizei Height, const GLvoid* pPixels)
+    {
+        GLStateCache::Get().BindTexture(m_textureTarget, m_textureObj);
+        // upload the main part of texture obj
+        //                                             |               |
+        glTexImage2D(m_textureTarget, 0, GL_RGBA, Width, Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pPixels);
+        // the rest of the mip chain is generated from level 0
+        glTexParameteri(m_textureTarget, GL_TEXTURE_MAX_LEVEL, 1000);
+        glGenerateMipmap(m_textureTarget);
+        m_memorySize = (size_t)Width * Height * 4 * 4 / 3; // the chain adds a third
+        m_ready = true;
+        m_request.reset();
+    }
+
+    // all levels of the file; pData is Image.Data, or nullptr when Image.Data is in
+    // the bound GL_PIXEL_UNPACK_BUFFER
+    void SetCompressedImage(const CompressedImage& Image, const unsigned char* pData)
+    {
+        GLStateCache::Get().BindTexture(m_textureTarget, m_textureObj);
+        for (size_t i = 0; i < Image.Levels.size(); i++)
+        {
+            const CompressedImage::Level& Level = Image.Levels[i];
+            const GLvoid* pLevel = pData != nullptr ? (const GLvoid*)(pData + Level.Offset) : (const GLvoid*)Level.Offset;
+            glCompressedTexImage2D(m_textureTarget, (GLint)i, Image.Format, Level.Width, Level.Height, 0, (GLsizei)Level.Size, pLevel);
+        }
+        // a file with a short chain is still complete
+        glTexParameteri(m_textureTarget, GL_TEXTURE_MAX_LEVEL, (GLint)Image.Levels.size() - 1);
+        m_memorySize = 0;
+        for (size_t i = 0; i < Image.Levels.size(); i++) m_memorySize += Image.Levels[i].Size;
+        m_ready = true;
+        m_request.reset();
+    }
+
+    bool IsReady() const
+    {
+        return m_ready;
+    }
+
+    size_t GetMemorySize() const
+    {
+        return m_memorySize;
+    }
+
+    const std::string& GetFileName() const
+    {
+        return m_fileName;
+    }
+
+    // set by the streamer for a load that asked for the hash, whether or not the decoding worked
+    void SetContentHash(uint64_t Hash)
+    {
+        m_contentHash = Hash;
+        m_contentHashed = true;
+    }
+
+    bool IsContentHashed() const
+    {
+        return m_contentHashed;
+    }
+
+    // 0 if the file could not be read
+    uint64_t GetContentHash() const
+    {
+        return m_contentHash;
+    }
+
+    // reads Request.FileName into Pixels or Compressed, safe to call from any thread
+    static bool Decode(TextureRequest& Request)
+    {
+        if (IsCompressedTextureFile(Request.FileName))
+        {
+            if (!LoadCompressedImage(Request.FileName, Request.Compressed)) return false;
+            if (!IsCompressedFormatSupported(Request.Compressed.Format))
+            {
+                std::cout << "Error loading texture '" << Request.FileName << "': the compressed format is not supported by the driver" << std::endl;
+                Request.Compressed = CompressedImage();
+                return false;
+            }
+            return true;
+        }
+
         try 
         {
             // upload the texture to the private memory
-            m_pImage = new Magick::Image(m_fileName);
+            Magick::Image Image(Request.FileName);
             // upload the image to the obj BLOB
-            m_pImage->write(&m_blob, "RGBA");
+            Image.write(&Request.Pixels, "RGBA");
             // BLOB stores encoded image so other apps could use it
+            Request.Width = (GLsizei)Image.columns();
+            Request.Height = (GLsizei)Image.rows();
         }
         catch (Magick::Error& Error) 
         {
-            std::cout << "Error loading texture '" << m_fileName << "': " << Error.what() << std::endl;
+            std::cout << "Error loading texture '" << Request.FileName << "': " << Error.what() << std::endl;
             return false;
         }
-
-        // generate the objs textures and upload them to the pointer to array of GLuint
-        glGenTextures(1, &m_textureObj); // = glGenBuffers()
-        glBindTexture(m_textureTarget, m_textureObj);
-        // upload the main part of texture obj
-        //                                             |               |
-        glTexImage2D(m_textureTarget, 0, GL_RGBA, m_pImage->columns(), m_pImage->rows(), 0, GL_RGBA, GL_UNSIGNED_BYTE, m_blob.data());
-        // condition of sampler of the texture
-        //         
-        glTexParameteri(m_textureTarget, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(m_textureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // GL_NEAREST-,      
-        // GL_LINEAR-  ,    
-
         return true;
     }
 
@@ -57,8 +189,28 @@ public:
     // (make texture to be available in fragment shader)
     void Bind(GLenum TextureUnit) // gets module of texture GL_TEXTURE0, GL_TEXTURE1
     {
-        glActiveTexture(TextureUnit);
-        glBindTexture(m_textureTarget, m_textureObj);
+        GLStateCache::Get().BindTexture(TextureUnit, m_textureTarget, m_textureObj);
     }
-};
 
+private:
+    void CreateObject()
+    {
+        if (m_textureObj != 0) return;
+
+        // generate the objs textures and upload them to the pointer to array of GLuint
+        glGenTextures(1, &m_textureObj); // = glGenBuffers()
+        GLStateCache::Get().BindTexture(m_textureTarget, m_textureObj);
+        // condition of sampler of the texture
+        //         
+        glTexParameteri(m_textureTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(m_textureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        //    mip-,      
+        // GL_LINEAR-  ,    
+        if (GLEW_EXT_texture_filter_anisotropic)
+        {
+            GLfloat MaxAnisotropy = 1.0f;
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &MaxAnisotropy);
+            glTexParameterf(m_textureTarget, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(MaxAnisotropy, 8.0f));
+        }
+    }
+};
\ No newline at end of file
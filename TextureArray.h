@@ -0,0 +1,119 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <Magick++.h>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <unordered_map>
+#include "JobSystem.h"
+#include "GLStateCache.h"
+
+// Many images in one GL_TEXTURE_2D_ARRAY, one layer each, so that objects with
+// different textures need no bind between them and can share an instanced draw.
+// All layers have the same size; images are scaled to it while loading, which
+// keeps the texture coordinates of the meshes unchanged (an atlas would need
+// them remapped and mip levels would bleed across the packed images).
+class TextureArray
+{
+private:
+	GLuint textureObj;
+	GLsizei width;
+	GLsizei height;
+	unsigned int layerCount;
+	std::unordered_map<std::string, unsigned int> layers; // file name -> layer
+
+public:
+	TextureArray()
+	{
+		textureObj = 0;
+		width = height = 0;
+		layerCount = 0;
+	}
+
+	~TextureArray()
+	{
+		if (textureObj != 0) GLStateCache::Get().DeleteTextures(1, &textureObj);
+	}
+
+	// decodes FileNames on the job system (or the calling thread without one) into
+	// Width x Height layers in the given order; a file that fails stays mid grey
+	bool Load(const std::vector<std::string>& FileNames, GLsizei Width, GLsizei Height, JobSystem* pJobs = nullptr)
+	{
+		if (FileNames.empty() || Width <= 0 || Height <= 0) return false;
+		width = Width;
+		height = Height;
+		layerCount = (unsigned int)FileNames.size();
+
+		size_t LayerSize = (size_t)Width * Height * 4;
+		std::vector<unsigned char> Pixels(LayerSize * FileNames.size(), 128);
+
+		auto Decode = [&](unsigned int First, unsigned int Last)
+		{
+			for (unsigned int i = First; i < Last; i++)
+			{
+				try
+				{
+					Magick::Image Image(FileNames[i]);
+					Magick::Geometry Size((size_t)Width, (size_t)Height);
+					Size.aspect(true); // exactly the layer size
+					Image.resize(Size);
+					Magick::Blob Blob;
+					Image.write(&Blob, "RGBA");
+					if (Blob.length() >= LayerSize) memcpy(&Pixels[LayerSize * i], Blob.data(), LayerSize);
+				}
+				catch (Magick::Error& Error)
+				{
+					std::cerr << "Error loading texture '" << FileNames[i] << "': " << Error.what() << "\n";
+				}
+			}
+		};
+
+		if (pJobs != nullptr)
+		{
+			JobCounter Done;
+			pJobs->ParallelFor(Done, (unsigned int)FileNames.size(), 1, Decode);
+			pJobs->Wait(Done);
+		}
+		else
+		{
+			Decode(0, (unsigned int)FileNames.size());
+		}
+
+		layers.clear();
+		for (unsigned int i = 0; i < FileNames.size(); i++)
+		{
+			layers[FileNames[i]] = i;
+		}
+
+		while (glGetError() != GL_NO_ERROR) {} // earlier errors are not the upload's
+		if (textureObj == 0) glGenTextures(1, &textureObj);
+		GLStateCache::Get().BindTexture(GL_TEXTURE_2D_ARRAY, textureObj);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, Width, Height, (GLsizei)FileNames.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, Pixels.data());
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		GLStateCache::Get().BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		return glGetError() == GL_NO_ERROR;
+	}
+
+	// layer of a loaded file, -1 if it is not in the array
+	int GetLayer(const std::string& FileName) const
+	{
+		auto Found = layers.find(FileName);
+		return Found != layers.end() ? (int)Found->second : -1;
+	}
+
+	unsigned int GetLayerCount() const
+	{
+		return layerCount;
+	}
+
+	void Bind(GLenum TextureUnit) const
+	{
+		GLStateCache::Get().BindTexture(TextureUnit, GL_TEXTURE_2D_ARRAY, textureObj);
+	}
+};
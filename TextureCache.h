@@ -0,0 +1,280 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <string>
+#include <vector>
+#include <list>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include "Texture.h"
+#include "TextureStreaming.h"
+
+const size_t TEXTURE_CACHE_BUDGET = 512 << 20; // bytes of video memory
+
+class TextureCache;
+
+// one texture known to the cache; pTexture is nullptr while it is evicted
+struct TextureCacheEntry
+{
+	std::string FileName; // the path it is loaded from
+	std::vector<std::string> Paths; // every path that resolved to it
+	uint64_t Hash; // of the file contents, 0 if the file could not be read or is not hashed yet
+	bool Hashing; // the streamer has not hashed the file yet
+	TextureCacheEntry* pSame; // the entry it turned out to duplicate, its handles bind that one
+	Texture* pTexture;
+	unsigned int RefCount;
+	unsigned long long LastUsed; // frame of the last Bind
+	std::list<TextureCacheEntry*>::iterator LruPosition; // valid while resident
+};
+
+// Reference counted handle to a cached texture. Binding it marks the texture as
+// used in this frame and reloads it if it was evicted. The cache must outlive its handles.
+class TextureHandle
+{
+private:
+	TextureCache* pCache;
+	TextureCacheEntry* pEntry;
+
+public:
+	TextureHandle() : pCache(nullptr), pEntry(nullptr) { }
+	TextureHandle(TextureCache* Cache, TextureCacheEntry* Entry);
+	TextureHandle(const TextureHandle& Other);
+	TextureHandle& operator=(const TextureHandle& Other);
+	~TextureHandle();
+
+	bool IsValid() const
+	{
+		return pEntry != nullptr;
+	}
+
+	void Bind(GLenum TextureUnit) const;
+};
+
+// Hands out one texture per distinct file. Requests are matched by path, and copies of
+// an asset under other names are found by a hash of the file contents: the decoding job
+// of the streamer computes it, and when it arrives in Update an entry with the same hash
+// takes over the paths of the new one, whose handles keep working and bind the older
+// texture from then on. Acquire itself never reads the file. Textures stay cached after
+// their last handle is gone; once the resident textures exceed the budget, the least
+// recently bound ones are evicted (never one bound in the last frame) and reloaded when
+// a handle binds them again. Textures without handles are forgotten when evicted.
+class TextureCache
+{
+private:
+	TextureStreamer& streamer;
+	size_t budget;
+	unsigned long long frame;
+	std::unordered_map<std::string, TextureCacheEntry*> byPath;
+	std::unordered_map<uint64_t, TextureCacheEntry*> byHash;
+	std::list<TextureCacheEntry*> lru; // resident entries, most recently bound first
+	std::vector<TextureCacheEntry*> hashing; // entries waiting for the hash of their file
+
+public:
+	TextureCache(TextureStreamer& Streamer, size_t Budget = TEXTURE_CACHE_BUDGET) : streamer(Streamer)
+	{
+		budget = Budget;
+		frame = 0;
+	}
+
+	~TextureCache()
+	{
+		for (TextureCacheEntry* pEntry : lru) delete pEntry->pTexture;
+		std::vector<TextureCacheEntry*> Entries;
+		for (auto& Path : byPath) Entries.push_back(Path.second);
+		std::sort(Entries.begin(), Entries.end());
+		Entries.erase(std::unique(Entries.begin(), Entries.end()), Entries.end());
+		for (TextureCacheEntry* pEntry : Entries) delete pEntry;
+	}
+
+	// the texture shows its placeholder until the streamer has uploaded it
+	TextureHandle Acquire(const std::string& FileName)
+	{
+		auto Found = byPath.find(FileName);
+		if (Found != byPath.end()) return TextureHandle(this, Found->second);
+
+		TextureCacheEntry* pEntry = new TextureCacheEntry;
+		pEntry->FileName = FileName;
+		pEntry->Paths.push_back(FileName);
+		pEntry->Hash = 0;
+		pEntry->Hashing = true;
+		pEntry->pSame = nullptr;
+		pEntry->pTexture = nullptr;
+		pEntry->RefCount = 0;
+		pEntry->LastUsed = frame;
+		byPath[FileName] = pEntry;
+		hashing.push_back(pEntry);
+
+		MakeResident(*pEntry);
+		return TextureHandle(this, pEntry);
+	}
+
+	// once per frame on the GL thread before drawing: uploads finished textures, merges
+	// the ones found to be copies and enforces the budget
+	void Update()
+	{
+		streamer.Update();
+		MergeHashed();
+		Trim();
+		frame++;
+	}
+
+	void SetBudget(size_t Budget)
+	{
+		budget = Budget;
+	}
+
+	// bytes of the resident textures
+	size_t GetMemorySize() const
+	{
+		size_t Size = 0;
+		for (TextureCacheEntry* pEntry : lru) Size += pEntry->pTexture->GetMemorySize();
+		return Size;
+	}
+
+	unsigned int GetResidentCount() const
+	{
+		return (unsigned int)lru.size();
+	}
+
+	// handle side, see TextureHandle
+	void AddRef(TextureCacheEntry& Entry)
+	{
+		Entry.RefCount++;
+	}
+
+	void Release(TextureCacheEntry& Entry)
+	{
+		Entry.RefCount--;
+		if (Entry.RefCount != 0) return;
+
+		TextureCacheEntry* pSame = Entry.pSame;
+		if (pSame != nullptr)
+		{
+			// its paths are the other entry's now, only the reference it held is left
+			delete &Entry;
+			Release(*pSame);
+		}
+		else if (Entry.pTexture == nullptr) Forget(&Entry);
+	}
+
+	void Bind(TextureCacheEntry& Handle, GLenum TextureUnit)
+	{
+		TextureCacheEntry& Entry = Handle.pSame != nullptr ? *Handle.pSame : Handle;
+		if (Entry.pTexture == nullptr) MakeResident(Entry);
+		else if (Entry.LastUsed != frame) lru.splice(lru.begin(), lru, Entry.LruPosition);
+		Entry.LastUsed = frame;
+		Entry.pTexture->Bind(TextureUnit);
+	}
+
+private:
+	void MakeResident(TextureCacheEntry& Entry)
+	{
+		Entry.pTexture = new Texture(GL_TEXTURE_2D, Entry.FileName);
+		streamer.Load(*Entry.pTexture, Entry.Hashing);
+		lru.push_front(&Entry);
+		Entry.LruPosition = lru.begin();
+	}
+
+	// Entries whose hash arrived: a copy of a known file gives its paths to the entry that has
+	// it and drops its own texture; its handles, if any, hold on to that entry through pSame
+	void MergeHashed()
+	{
+		size_t Kept = 0;
+		for (size_t i = 0; i < hashing.size(); i++)
+		{
+			TextureCacheEntry* pEntry = hashing[i];
+			// evicted before the hash came, the next load asks for it again
+			if (pEntry->pTexture == nullptr || !pEntry->pTexture->IsContentHashed())
+			{
+				hashing[Kept++] = pEntry;
+				continue;
+			}
+
+			pEntry->Hashing = false;
+			pEntry->Hash = pEntry->pTexture->GetContentHash();
+			if (pEntry->Hash == 0) continue;
+
+			auto Same = byHash.find(pEntry->Hash);
+			if (Same == byHash.end())
+			{
+				byHash[pEntry->Hash] = pEntry;
+				continue;
+			}
+
+			TextureCacheEntry* pSame = Same->second;
+			for (const std::string& Path : pEntry->Paths)
+			{
+				pSame->Paths.push_back(Path);
+				byPath[Path] = pSame;
+			}
+			lru.erase(pEntry->LruPosition);
+			delete pEntry->pTexture;
+			pEntry->pTexture = nullptr;
+
+			if (pEntry->RefCount == 0) delete pEntry;
+			else
+			{
+				pEntry->pSame = pSame;
+				AddRef(*pSame);
+			}
+		}
+		hashing.resize(Kept);
+	}
+
+	void Trim()
+	{
+		size_t Size = GetMemorySize();
+		while (Size > budget && !lru.empty())
+		{
+			TextureCacheEntry* pEntry = lru.back();
+			if (pEntry->LastUsed == frame) break; // everything left was bound in the last frame
+
+			Size -= pEntry->pTexture->GetMemorySize();
+			lru.pop_back();
+			delete pEntry->pTexture;
+			pEntry->pTexture = nullptr;
+
+			if (pEntry->RefCount == 0) Forget(pEntry);
+		}
+	}
+
+	void Forget(TextureCacheEntry* pEntry)
+	{
+		for (const std::string& Path : pEntry->Paths) byPath.erase(Path);
+		if (pEntry->Hash != 0) byHash.erase(pEntry->Hash);
+		if (pEntry->Hashing) hashing.erase(std::find(hashing.begin(), hashing.end(), pEntry));
+		delete pEntry;
+	}
+};
+
+inline TextureHandle::TextureHandle(TextureCache* Cache, TextureCacheEntry* Entry) : pCache(Cache), pEntry(Entry)
+{
+	pCache->AddRef(*pEntry);
+}
+
+inline TextureHandle::TextureHandle(const TextureHandle& Other) : pCache(Other.pCache), pEntry(Other.pEntry)
+{
+	if (pEntry != nullptr) pCache->AddRef(*pEntry);
+}
+
+inline TextureHandle& TextureHandle::operator=(const TextureHandle& Other)
+{
+	if (Other.pEntry != nullptr) Other.pCache->AddRef(*Other.pEntry);
+	if (pEntry != nullptr) pCache->Release(*pEntry);
+	pCache = Other.pCache;
+	pEntry = Other.pEntry;
+	return *this;
+}
+
+inline TextureHandle::~TextureHandle()
+{
+	if (pEntry != nullptr) pCache->Release(*pEntry);
+}
+
+inline void TextureHandle::Bind(GLenum TextureUnit) const
+{
+	if (pEntry != nullptr) pCache->Bind(*pEntry, TextureUnit);
+}
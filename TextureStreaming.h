@@ -0,0 +1,180 @@
+#pragma once
+#include <iostream>
+#include <GL/glew.h> // extensions manager
+#include <GL/freeglut.h> //GLUT - OpenGL Utility Library - API for managing the window system, as well as event handling, input/output control
+#include <glm/glm.hpp>	//#include "math_3d.h" - vector
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include "Texture.h"
+#include "JobSystem.h"
+
+const size_t TEXTURE_UPLOAD_BUDGET = 16 << 20; // bytes copied into pixel buffers per Update
+
+// Asynchronous texture loading:
+//  1. Load gives the texture a 1x1 placeholder and queues the decoding on a pool of
+//     its own (a long decode must never end up on the GLUT thread inside a frame Wait);
+//     a hash of the file contents, if asked for, is computed there too
+//  2. Update, on the GL thread once per frame, copies finished images into a pixel
+//     unpack buffer and specifies the texture from it, so glTexImage2D returns at once
+//     and the transfer runs on the driver's side; the decoded copy is freed right after
+// The buffer is orphaned before every image, an upload never waits for the previous one.
+class TextureStreamer
+{
+private:
+	JobCounter decoding; // never waited on, the decoded queue is the completion signal
+	GLuint PBO;
+	std::mutex lock;
+	std::deque<std::shared_ptr<TextureRequest> > decoded; // guarded by lock
+	unsigned int pending; // requests not uploaded yet, GL thread only
+	JobSystem pool; // last, so the workers are joined before the queue goes away
+
+public:
+	// NumThreads decoding threads, 0 picks half the cores
+	TextureStreamer(unsigned int NumThreads = 0) : pool(PoolSize(NumThreads))
+	{
+		PBO = 0;
+		pending = 0;
+	}
+
+	~TextureStreamer()
+	{
+		if (PBO != 0) glDeleteBuffers(1, &PBO);
+	}
+
+	// the texture is usable right away and shows the placeholder until Update uploads the image;
+	// with HashContents Update also gives it the hash of the file (Texture::IsContentHashed)
+	void Load(Texture& Target, bool HashContents = false)
+	{
+		std::shared_ptr<TextureRequest> Request;
+		Target.BeginAsyncLoad(Request);
+		Request->HashContents = HashContents;
+		pending++;
+
+		pool.Run(decoding, [this, Request]()
+		{
+			if (Request->HashContents) Request->Hash = HashFile(Request->FileName);
+			Request->Failed = !Texture::Decode(*Request);
+			std::lock_guard<std::mutex> Guard(lock);
+			decoded.push_back(Request);
+		});
+	}
+
+	// uploads finished images until ByteBudget is spent (at least one image per call)
+	void Update(size_t ByteBudget = TEXTURE_UPLOAD_BUDGET)
+	{
+		std::deque<std::shared_ptr<TextureRequest> > Ready;
+		{
+			std::lock_guard<std::mutex> Guard(lock);
+			Ready.swap(decoded);
+		}
+
+		// the hashes of all of them, also of the ones the budget leaves for later
+		for (const std::shared_ptr<TextureRequest>& Request : Ready)
+		{
+			if (Request->HashContents && Request->pTarget != nullptr) Request->pTarget->SetContentHash(Request->Hash);
+		}
+
+		size_t Spent = 0;
+		while (!Ready.empty())
+		{
+			std::shared_ptr<TextureRequest> Request = Ready.front();
+			size_t Size = GetUploadSize(*Request);
+			if (Spent > 0 && Spent + Size > ByteBudget) break;
+			Ready.pop_front();
+			pending--;
+
+			if (Request->pTarget == nullptr) continue; // the texture was destroyed meanwhile
+			if (Request->Failed || Size == 0) continue; // keeps the placeholder
+
+			Upload(*Request);
+			Spent += Size;
+		}
+
+		if (!Ready.empty())
+		{
+			std::lock_guard<std::mutex> Guard(lock);
+			decoded.insert(decoded.begin(), Ready.begin(), Ready.end());
+		}
+	}
+
+	// textures still showing their placeholder (decoding or waiting for Update)
+	unsigned int GetPendingCount() const
+	{
+		return pending;
+	}
+
+private:
+	static unsigned int PoolSize(unsigned int NumThreads)
+	{
+		if (NumThreads == 0) NumThreads = std::thread::hardware_concurrency() / 2;
+		return std::max(1u, NumThreads);
+	}
+
+	// 64-bit FNV-1a of the file contents, 0 if it cannot be read
+	static uint64_t HashFile(const std::string& FileName)
+	{
+		std::ifstream File(FileName, std::ios::binary);
+		if (!File) return 0;
+
+		uint64_t Hash = 14695981039346656037ull;
+		char Buffer[65536];
+		while (File)
+		{
+			File.read(Buffer, sizeof(Buffer));
+			std::streamsize Count = File.gcount();
+			for (std::streamsize i = 0; i < Count; i++)
+			{
+				Hash ^= (unsigned char)Buffer[i];
+				Hash *= 1099511628211ull;
+			}
+		}
+		return Hash != 0 ? Hash : 1;
+	}
+
+	// bytes that go through the pixel buffer, 0 if the decoded image is unusable
+	static size_t GetUploadSize(const TextureRequest& Request)
+	{
+		if (Request.Compressed.Format != 0) return Request.Compressed.Data.size();
+		size_t Size = (size_t)Request.Width * Request.Height * 4;
+		return Request.Pixels.length() >= Size ? Size : 0;
+	}
+
+	void Upload(TextureRequest& Request)
+	{
+		bool Compressed = Request.Compressed.Format != 0;
+		size_t Size = GetUploadSize(Request);
+		if (PBO == 0) glGenBuffers(1, &PBO);
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+		// orphan: the driver hands out fresh storage while earlier transfers still read the old one
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)Size, nullptr, GL_STREAM_DRAW);
+
+		void* pDest = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)Size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (pDest != nullptr)
+		{
+			memcpy(pDest, Compressed ? (const void*)Request.Compressed.Data.data() : Request.Pixels.data(), Size);
+			if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+			{
+				// the level offsets of a compressed file are offsets into the buffer now
+				if (Compressed) Request.pTarget->SetCompressedImage(Request.Compressed, nullptr);
+				else Request.pTarget->SetImage(Request.Width, Request.Height, 0);
+			}
+		}
+		else
+		{
+			std::cerr << "Error mapping the pixel buffer for '" << Request.FileName << "'\n";
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		// the CPU copy is not needed any more
+		Request.Pixels = Magick::Blob();
+		Request.Compressed = CompressedImage();
+	}
+};